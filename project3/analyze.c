@@ -7,11 +7,24 @@
 /* modified by Yejin Lee                            */
 /****************************************************/
 
+#include <stdarg.h>
 #include "globals.h"
 #include "symtab.h"
 #include "analyze.h"
 #include "util.h"
 
+/* Procedure semanticError prints an error message
+ * to the listing and sets Error, so that no code
+ * is generated for the program
+ */
+static void semanticError( char * format, ... )
+{ va_list args;
+  Error = TRUE;
+  va_start(args, format);
+  vfprintf(listing, format, args);
+  va_end(args);
+}
+
 /* Procedure traverse is a generic recursive 
  * syntax tree traversal routine:
  * it applies preProc in preorder and postProc 
@@ -220,7 +233,7 @@ static void enterScopes(TreeNode * t)
       /* check if the function is defined before */
       int* funcDclrLines = checkPredefined(t->name, "Function", t->lineno);
       if (funcDclrLines[0] > 0){
-        fprintf(listing, "Error: Symbol \"%s\" is redefined at line %d (already defined at line",t->name, t->lineno);
+        semanticError("Error: Symbol \"%s\" is redefined at line %d (already defined at line",t->name, t->lineno);
         for (int i = 1; i <= funcDclrLines[0]; i++)
           fprintf(listing, " %d", funcDclrLines[i]);
         fprintf(listing, ")\n");
@@ -258,7 +271,7 @@ static void checkNode(TreeNode * t)
         assignType(&t, variableTypeName); 
       } else {
         /* no declaration */
-        fprintf(listing, "Error: undeclared variable \"%s\" is used at line %d\n", t->name, t->lineno);
+        semanticError("Error: undeclared variable \"%s\" is used at line %d\n", t->name, t->lineno);
         /* implicit declaration */    
         addNode(t->name, "Variable", "undetermined", t->lineno);
       }
@@ -267,7 +280,7 @@ static void checkNode(TreeNode * t)
       if(t->isArray){
         /* variable is not defined as an array type */
         if(strcmp(variableTypeName, "int[]"))
-          fprintf(listing, "Error: Invalid array indexing at line %d (name : \"%s\"). indexing can only allowed for int[] variables\n", t->lineno, t->name);
+          semanticError("Error: Invalid array indexing at line %d (name : \"%s\"). indexing can only allowed for int[] variables\n", t->lineno, t->name);
         
         /* array index */
         if (t->child[0] != NULL) {
@@ -275,7 +288,7 @@ static void checkNode(TreeNode * t)
           if (t->child[0]->type == Int)
             assignType(&t, "int"); 
           /* array index should be int value */
-          else fprintf(listing, "Error: Invalid array indexing at line %d (name : \"%s\"). indicies should be integer\n", t->lineno, t->name);
+          else semanticError("Error: Invalid array indexing at line %d (name : \"%s\"). indicies should be integer\n", t->lineno, t->name);
         }
       }
       break;
@@ -283,7 +296,7 @@ static void checkNode(TreeNode * t)
       /* check if the variable is defined before */
       int* varDclrLines = checkPredefined(t->name, "Variable", t->lineno);
       if (varDclrLines[0] > 0){
-        fprintf(listing, "Error: Symbol \"%s\" is redefined at line %d (already defined at line",t->name, t->lineno);
+        semanticError("Error: Symbol \"%s\" is redefined at line %d (already defined at line",t->name, t->lineno);
         for (int i = 1; i <= varDclrLines[0]; i++)
           fprintf(listing, " %d", varDclrLines[i]);
         fprintf(listing, ")\n");
@@ -291,11 +304,11 @@ static void checkNode(TreeNode * t)
 
       /* cannot declare a void-type variable */
       if(t->type == Void)
-        fprintf(listing, "Error: The void-type variable is declared at line %d (name : \"%s\")\n", t->lineno, t->name);      
+        semanticError("Error: The void-type variable is declared at line %d (name : \"%s\")\n", t->lineno, t->name);      
      
       /* array indexing check */
       if((t->isArray) && (t->child[0]->type != Int)) 
-        fprintf(listing, "Error: Invalid array indexing at line %d (name : \"%s\"). indicies should be integer\n", t->lineno, t->name);     
+        semanticError("Error: Invalid array indexing at line %d (name : \"%s\"). indicies should be integer\n", t->lineno, t->name);     
       break;
     case Call:
       /* find type from the symbol table */
@@ -305,7 +318,7 @@ static void checkNode(TreeNode * t)
       if(functionTypeName != NULL){
         if (!strcmp(functionTypeName, "undetermined")){
           /* params are also undetermined type */
-          fprintf(listing, "Error: Invalid function call at line %d (name : \"%s\")\n", t->lineno, t->name);
+          semanticError("Error: Invalid function call at line %d (name : \"%s\")\n", t->lineno, t->name);
           break;
         } else {
           /* good */
@@ -313,11 +326,11 @@ static void checkNode(TreeNode * t)
         }  
       } else {
         /* no declaration */
-        fprintf(listing, "Error: undeclared function \"%s\" is called at line %d\n", t->name, t->lineno);
+        semanticError("Error: undeclared function \"%s\" is called at line %d\n", t->name, t->lineno);
         /* implicit declaration */
         addNode(t->name, "Function", "undetermined", t->lineno); 
         /* undetermined param type, return type */
-        fprintf(listing, "Error: Invalid function call at line %d (name : \"%s\")\n", t->lineno, t->name);
+        semanticError("Error: Invalid function call at line %d (name : \"%s\")\n", t->lineno, t->name);
         assignType(&t, "undetermined");
         break;
       }
@@ -329,7 +342,7 @@ static void checkNode(TreeNode * t)
         TreeNode* args = t->child[0];
         while(args != NULL){
           if (checkParam(t->name, i, getTypeName(args)) == -1){
-            fprintf(listing, "Error: Invalid function call at line %d (name : \"%s\")\n", args->lineno, t->name);
+            semanticError("Error: Invalid function call at line %d (name : \"%s\")\n", args->lineno, t->name);
             break;
           }
           args = args->sibling;
@@ -338,7 +351,7 @@ static void checkNode(TreeNode * t)
       } else { 
         /* should be void param */
         if(checkVoidParam(t->name) == -1)
-          fprintf(listing, "Error: Invalid function call at line %d (name : \"%s\")\n", t->lineno, t->name);
+          semanticError("Error: Invalid function call at line %d (name : \"%s\")\n", t->lineno, t->name);
       }
       break;  
     case OpExpr:
@@ -346,7 +359,7 @@ static void checkNode(TreeNode * t)
       if ((t->child[0]->type == Int) && (!t->child[0]->isArray) && (t->child[1]->type == Int) && (!t->child[1]->isArray))
         assignType(&t, "int");
       else {
-        fprintf(listing, "Error: invalid operation at line %d\n", t->lineno);
+        semanticError("Error: invalid operation at line %d\n", t->lineno);
         assignType(&t, "undetermined");
       }
       break;
@@ -357,7 +370,7 @@ static void checkNode(TreeNode * t)
       }
       else {
         assignType(&t, "undetermined");
-        fprintf(listing, "Error: invalid assignment at line %d\n", t->lineno);
+        semanticError("Error: invalid assignment at line %d\n", t->lineno);
       }
       break;
     case IfStmt:
@@ -365,7 +378,7 @@ static void checkNode(TreeNode * t)
     case WhileStmt:
       /* only allowed to use int value for condition */
       if(t->child[0]->type != Int) // condition
-        fprintf(listing, "Error: invalid condition at line %d\n", t->lineno);
+        semanticError("Error: invalid condition at line %d\n", t->lineno);
       break;
     case ReturnStmt:
       intFunctionLineno = -1; // return is stated
@@ -380,11 +393,11 @@ static void checkNode(TreeNode * t)
       if (t->child[0] == NULL){ 
         /* return void */
         if(strcmp(functionReturnType, "void" ))
-          fprintf(listing, "Error: Invalid return at line %d\n", t->lineno);
+          semanticError("Error: Invalid return at line %d\n", t->lineno);
       }
       else {
         if(strcmp(getTypeName(t->child[0]), functionReturnType))
-          fprintf(listing, "Error: Invalid return at line %d\n", t->lineno);
+          semanticError("Error: Invalid return at line %d\n", t->lineno);
       }
       break;
     case CmpdStmt:
@@ -392,7 +405,7 @@ static void checkNode(TreeNode * t)
         popScope();
       else // function's cmpd
         if (intFunctionLineno != -1) 
-          fprintf(listing, "Error: missing return statement at line %d\n", intFunctionLineno);
+          semanticError("Error: missing return statement at line %d\n", intFunctionLineno);
     default:
       break;
       
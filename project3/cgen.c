@@ -1,186 +1,703 @@
 /****************************************************/
 /* File: cgen.c                                     */
 /* The code generator implementation                */
-/* for the TINY compiler                            */
+/* for the C-Minus compiler                         */
 /* (generates code for the TM machine)              */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
 
 #include "globals.h"
-#include "symtab.h"
 #include "code.h"
 #include "cgen.h"
 
+/* Run-time organization
+ *
+ * Global variables are allocated from location 0
+ * up and addressed relative to gp. Every call of
+ * a function pushes a frame below the frame of
+ * its caller; fp points to the top word of it:
+ *
+ *       0(fp)   fp of the caller
+ *      -1(fp)   return address
+ *    -2-i(fp)   parameter i
+ *               local variables
+ *    ...(mp)    temporaries, below the frame
+ *
+ * An array parameter holds the address of
+ * element 0 of the array passed. The result of
+ * a function is returned in ac. The offsets of
+ * the frame words are defined in code.h
+ */
+
 /* tmpOffset is the memory offset for temps
    It is decremented each time a temp is
    stored, and incremeted when loaded again
 */
 static int tmpOffset = 0;
 
-/* prototype for internal recursive code generator */
+/* Expressions are evaluated into the registers
+ * 0 to NREGS-1: ac, ac1 and the two that nothing
+ * else uses, as 4 to 7 are fp, gp, mp and pc.
+ * The side of an operator that needs more
+ * registers goes first, and a value goes to the
+ * temps only when the other side needs all the
+ * registers left, or has a call, which clobbers
+ * them
+ */
+#define NREGS 4
+
+/* the register need of a subtree with a call */
+#define CALLNEED (NREGS+1)
+
+/* frameSize is the number of words in the
+ * frame of the function being generated, and
+ * localOffset the offset of the next local
+ * variable from fp
+ */
+static int frameSize = 0;
+static int localOffset = 0;
+
+/* globalOffset is the location of the next
+ * global variable
+ */
+static int globalOffset = 0;
+
+/* the variables in scope, innermost last */
+#define MAXVARS 1024
+
+typedef struct
+   { char * name;
+     int isGlobal;  /* addressed from gp, else from fp */
+     int offset;
+     int isArray;   /* offset locates element 0 */
+     int isRef;     /* array parameter: holds the address */
+   } VarRec;
+
+static VarRec varTab[MAXVARS];
+static int nVars = 0;
+
+/* the functions generated so far, and the calls
+ * to be backpatched with their entry locations
+ */
+typedef struct FunRec
+   { char * name;
+     int entry;
+     struct FunRec * next;
+   } FunRec;
+
+typedef struct PatchRec
+   { char * name;
+     int loc;
+     struct PatchRec * next;
+   } PatchRec;
+
+static FunRec * funList = NULL;
+static PatchRec * patchList = NULL;
+
+/* prototypes for internal recursive code generators */
 static void cGen (TreeNode * tree);
+static void genExp (TreeNode * tree);
+static void genInto (TreeNode * tree, int r);
+static int regNeed (TreeNode * tree);
+
+/* Procedure addVar enters a variable into the
+ * innermost scope
+ */
+static void addVar( char * name, int isGlobal, int offset,
+                    int isArray, int isRef )
+{ if (nVars == MAXVARS)
+  { fprintf(listing,"Too many variables in scope at %s\n",name);
+    Error = TRUE;
+    return;
+  }
+  varTab[nVars].name = name;
+  varTab[nVars].isGlobal = isGlobal;
+  varTab[nVars].offset = offset;
+  varTab[nVars].isArray = isArray;
+  varTab[nVars].isRef = isRef;
+  nVars++;
+} /* addVar */
+
+/* Function lookupVar returns the innermost
+ * variable called name
+ */
+static VarRec * lookupVar( char * name )
+{ int i;
+  for (i = nVars-1; i >= 0; i--)
+    if (strcmp(varTab[i].name,name) == 0) return &varTab[i];
+  fprintf(listing,"BUG: no storage for %s\n",name);
+  Error = TRUE;
+  return &varTab[0];
+} /* lookupVar */
+
+/* Function varSize returns the number of words of
+ * a variable declaration
+ */
+static int varSize( TreeNode * t )
+{ if (t->isArray && (t->child[0] != NULL)) return t->child[0]->val;
+  return 1;
+} /* varSize */
+
+/* Function localSize returns the number of words
+ * of the local variables of a statement: those
+ * declared in it and in the largest of its
+ * nested compound statements
+ */
+static int localSize( TreeNode * t )
+{ TreeNode * p;
+  int size = 0, inner = 0, i, n;
+  if (t == NULL) return 0;
+  switch (t->exprKind)
+  { case CmpdStmt :
+      for (p = t->child[0]; p != NULL; p = p->sibling)
+        size += varSize(p);
+      for (p = t->child[1]; p != NULL; p = p->sibling)
+      { n = localSize(p);
+        if (n > inner) inner = n;
+      }
+      break;
+    case IfStmt :
+    case IfElseStmt :
+    case WhileStmt :
+      for (i = 1; i < MAXCHILDREN; i++)
+      { n = localSize(t->child[i]);
+        if (n > inner) inner = n;
+      }
+      break;
+    default :
+      break;
+  }
+  return size + inner;
+} /* localSize */
+
+/* Function stmtLine returns the source line a
+ * statement is attributed to: that of its
+ * condition or value where it has one
+ */
+static int stmtLine( TreeNode * t )
+{ switch (t->exprKind)
+  { case IfStmt :
+    case IfElseStmt :
+    case WhileStmt :
+    case ReturnStmt :
+      if (t->child[0] != NULL) return t->child[0]->lineno;
+      break;
+    default :
+      break;
+  }
+  return t->lineno;
+} /* stmtLine */
+
+/* Procedure genBase loads register r with the
+ * address of element 0 of array v
+ */
+static void genBase( VarRec * v, int r )
+{ if (v->isRef)
+    emitRM("LD",r,v->offset,fp,"load array address");
+  else
+    emitRM("LDA",r,v->offset,v->isGlobal ? gp : fp,"load array address");
+} /* genBase */
+
+/* Procedure genAddress computes the address of
+ * the array element of the indexed variable
+ * tree into register r, below NREGS-1
+ */
+static void genAddress( TreeNode * tree, int r )
+{ genInto(tree->child[0],r);
+  genBase(lookupVar(tree->name),r+1);
+  emitRO("ADD",r,r+1,r,"compute element address");
+} /* genAddress */
+
+/* Procedure genReturn generates the return from
+ * the current function, with the result in ac
+ */
+static void genReturn( void )
+{ emitRM("LD",ac1,ofsRetAddr,fp,"return: load return address");
+  emitRM("LD",fp,ofsOldFp,fp,"return: pop frame");
+  emitReturn();
+  emitRM("LDA",pc,0,ac1,"return: jump to caller");
+} /* genReturn */
+
+/* Procedure genCall generates code at a call
+ * other than of input, with the result in ac
+ */
+static void genCall( TreeNode * tree )
+{ TreeNode * p;
+  FunRec * f;
+  PatchRec * patch;
+  int frame, nargs;
+  if (strcmp(tree->name,"output") == 0)
+  { genExp(tree->child[0]);
+    emitRO("OUT",ac,0,0,"output ac");
+    return;
+  }
+  if (TraceCode) emitComment("-> Call") ;
+  nargs = 0;
+  for (p = tree->child[0]; p != NULL; p = p->sibling) nargs++;
+  /* the frame of the callee starts at the next temp */
+  frame = tmpOffset;
+  tmpOffset -= 2 + nargs;
+  nargs = 0;
+  for (p = tree->child[0]; p != NULL; p = p->sibling)
+  { genExp(p);
+    emitRM("ST",ac,frame+ofsParams-nargs,mp,"call: store argument");
+    nargs++;
+  }
+  emitRM("ST",fp,frame+ofsOldFp,mp,"call: store fp");
+  emitRM("LDA",fp,frame,mp,"call: push frame");
+  emitRM("LDA",ac,2,pc,"call: compute return address");
+  emitRM("ST",ac,ofsRetAddr,fp,"call: store return address");
+  for (f = funList; f != NULL; f = f->next)
+    if (strcmp(f->name,tree->name) == 0) break;
+  emitCall(emitSkip(0));
+  if (f != NULL)
+    emitRM_Abs("LDA",pc,f->entry,"call: jump to function");
+  else
+  { patch = (PatchRec *) malloc(sizeof(PatchRec));
+    patch->name = tree->name;
+    patch->loc = emitSkip(1);
+    patch->next = patchList;
+    patchList = patch;
+  }
+  emitRM("LDA",mp,-frameSize,fp,"call: restore mp");
+  tmpOffset = frame;
+  if (TraceCode) emitComment("<- Call") ;
+} /* genCall */
+
+/* Procedure genCompound generates code at a
+ * compound statement
+ */
+static void genCompound( TreeNode * tree )
+{ TreeNode * p;
+  int savedVars = nVars;
+  int savedOffset = localOffset;
+  for (p = tree->child[0]; p != NULL; p = p->sibling)
+  { localOffset -= varSize(p);
+    addVar(p->name,FALSE,localOffset+1,p->isArray,FALSE);
+    if (p->isArray) emitArray(p->name,FALSE,localOffset+1,varSize(p));
+  }
+  cGen(tree->child[1]);
+  nVars = savedVars;
+  localOffset = savedOffset;
+} /* genCompound */
+
+/* Function isCompare returns nonzero if op is a
+ * relational operator
+ */
+static int isCompare( TokenType op )
+{ return (op == LESSTHAN) || (op == LESSEQUAL) || (op == GREATTHAN)
+         || (op == GREATEQUAL) || (op == EQ) || (op == NEQ);
+} /* isCompare */
+
+/* Function hasEffect returns nonzero if the
+ * expression tree calls or assigns
+ */
+static int hasEffect( TreeNode * tree )
+{ switch (tree->exprKind)
+  { case Var :
+      return (tree->child[0] != NULL) && hasEffect(tree->child[0]);
+    case OpExpr :
+      return hasEffect(tree->child[0]) || hasEffect(tree->child[1]);
+    case Const :
+      return FALSE;
+    default :
+      return TRUE;
+  }
+} /* hasEffect */
+
+/* Function canFault returns nonzero if the
+ * expression tree, without effects, divides or
+ * loads an array element
+ */
+static int canFault( TreeNode * tree )
+{ switch (tree->exprKind)
+  { case Var :
+      return tree->child[0] != NULL;
+    case OpExpr :
+      return (tree->op == DIV) || canFault(tree->child[0])
+             || canFault(tree->child[1]);
+    default :
+      return FALSE;
+  }
+} /* canFault */
+
+/* Function mayReorder returns nonzero if the
+ * operands left and right may be evaluated in
+ * either order: neither has an effect, and they
+ * cannot both fault
+ */
+static int mayReorder( TreeNode * left, TreeNode * right )
+{ return ! hasEffect(left) && ! hasEffect(right)
+         && (! canFault(left) || ! canFault(right));
+} /* mayReorder */
+
+/* Function pairNeed returns the register need of
+ * two values evaluated in turn, the first held
+ * while the second is evaluated
+ */
+static int pairNeed( int first, int second )
+{ int need = (first > second) ? first : second+1;
+  return (need > CALLNEED) ? CALLNEED : need;
+} /* pairNeed */
+
+/* Function addressNeed returns the register need
+ * of the address of the indexed variable tree
+ */
+static int addressNeed( TreeNode * tree )
+{ int need = regNeed(tree->child[0]);
+  return (need < 2) ? 2 : need;
+} /* addressNeed */
+
+/* Function valueFirst returns nonzero if the
+ * value of the assignment to the array element
+ * may be evaluated before the address, leaving
+ * it in the register of the assignment
+ */
+static int valueFirst( TreeNode * tree )
+{ return mayReorder(tree->child[0]->child[0],tree->child[1]);
+} /* valueFirst */
+
+/* Function regNeed returns the number of
+ * registers the code of the expression tree
+ * uses, CALLNEED if it calls a function
+ */
+static int regNeed( TreeNode * tree )
+{ int a, b;
+  switch (tree->exprKind)
+  { case Var :
+      return (tree->child[0] == NULL) ? 1 : addressNeed(tree);
+    case AssignExpr :
+      if (tree->child[0]->child[0] == NULL) return regNeed(tree->child[1]);
+      a = addressNeed(tree->child[0]);
+      b = regNeed(tree->child[1]);
+      return valueFirst(tree) ? pairNeed(b,a) : pairNeed(a,b);
+    case Call :
+      if (strcmp(tree->name,"input") == 0) return 1;
+      if (strcmp(tree->name,"output") == 0) return regNeed(tree->child[0]);
+      return CALLNEED;
+    case OpExpr :
+      a = regNeed(tree->child[0]);
+      b = regNeed(tree->child[1]);
+      if ((b > a) && mayReorder(tree->child[0],tree->child[1]))
+        return pairNeed(b,a);
+      return pairNeed(a,b);
+    default :
+      return 1;
+  }
+} /* regNeed */
+
+/* Procedure genOperands generates code for the
+ * operands of the operator node tree into
+ * register r, below NREGS-1, and the one above
+ * it, the one that needs more registers first,
+ * and returns the registers of the left and
+ * right operands in *left and *right
+ */
+static void genOperands( TreeNode * tree, int r, int * left, int * right )
+{ TreeNode * first = tree->child[0];
+  TreeNode * second = tree->child[1];
+  int swapped = FALSE, a, b;
+  if ((regNeed(second) > regNeed(first)) && mayReorder(first,second))
+  { first = tree->child[1];
+    second = tree->child[0];
+    swapped = TRUE;
+  }
+  genInto(first,r);
+  if (regNeed(second) < NREGS-r)
+  { genInto(second,r+1);
+    a = r;
+    b = r+1;
+  }
+  else
+  { /* the registers above r do not suffice */
+    emitRM("ST",r,tmpOffset--,mp,"op: spill operand");
+    genInto(second,r);
+    emitRM("LD",r+1,++tmpOffset,mp,"op: reload operand");
+    a = r+1;
+    b = r;
+  }
+  *left = swapped ? b : a;
+  *right = swapped ? a : b;
+} /* genOperands */
+
+/* Function genCondition generates code for the
+ * condition tree of an if or while and returns
+ * the jump on ac that is taken if it is false.
+ * A compare leaves the difference of its
+ * operands in ac to be jumped on by its sign,
+ * without making it 0 or 1 first
+ */
+static char * genCondition( TreeNode * tree )
+{ int left, right;
+  if ((tree->exprKind != OpExpr) || ! isCompare(tree->op))
+  { genExp(tree);
+    return "JEQ";
+  }
+  if (TraceCode) emitComment("-> Op") ;
+  genOperands(tree,ac,&left,&right);
+  emitRO("SUB",ac,left,right,"op compare") ;
+  if (TraceCode)  emitComment("<- Op") ;
+  switch (tree->op) {
+    case LESSTHAN : return "JGE";
+    case LESSEQUAL : return "JGT";
+    case GREATTHAN : return "JLE";
+    case GREATEQUAL : return "JLT";
+    case EQ : return "JNE";
+    default : return "JEQ";
+  }
+} /* genCondition */
 
 /* Procedure genStmt generates code at a statement node */
 static void genStmt( TreeNode * tree)
 { TreeNode * p1, * p2, * p3;
   int savedLoc1,savedLoc2,currentLoc;
-  int loc;
-  switch (tree->kind.stmt) {
+  char * jumpIfFalse;
+  if (tree->exprKind != CmpdStmt) emitLine(stmtLine(tree));
+  switch (tree->exprKind) {
 
-      case IfK :
+      case IfStmt :
+      case IfElseStmt :
          if (TraceCode) emitComment("-> if") ;
          p1 = tree->child[0] ;
          p2 = tree->child[1] ;
          p3 = tree->child[2] ;
          /* generate code for test expression */
-         cGen(p1);
+         jumpIfFalse = genCondition(p1);
          savedLoc1 = emitSkip(1) ;
          emitComment("if: jump to else belongs here");
          /* recurse on then part */
          cGen(p2);
-         savedLoc2 = emitSkip(1) ;
-         emitComment("if: jump to end belongs here");
+         if (tree->exprKind == IfElseStmt)
+         { savedLoc2 = emitSkip(1) ;
+           emitComment("if: jump to end belongs here");
+         }
          currentLoc = emitSkip(0) ;
          emitBackup(savedLoc1) ;
-         emitRM_Abs("JEQ",ac,currentLoc,"if: jmp to else");
-         emitRestore() ;
-         /* recurse on else part */
-         cGen(p3);
-         currentLoc = emitSkip(0) ;
-         emitBackup(savedLoc2) ;
-         emitRM_Abs("LDA",pc,currentLoc,"jmp to end") ;
+         emitRM_Abs(jumpIfFalse,ac,currentLoc,"if: jmp to else");
          emitRestore() ;
+         if (tree->exprKind == IfElseStmt)
+         { /* recurse on else part */
+           cGen(p3);
+           currentLoc = emitSkip(0) ;
+           emitBackup(savedLoc2) ;
+           emitRM_Abs("LDA",pc,currentLoc,"jmp to end") ;
+           emitRestore() ;
+         }
          if (TraceCode)  emitComment("<- if") ;
-         break; /* if_k */
+         break; /* if */
 
-      case RepeatK:
-         if (TraceCode) emitComment("-> repeat") ;
+      case WhileStmt :
+         if (TraceCode) emitComment("-> while") ;
          p1 = tree->child[0] ;
          p2 = tree->child[1] ;
          savedLoc1 = emitSkip(0);
-         emitComment("repeat: jump after body comes back here");
-         /* generate code for body */
-         cGen(p1);
+         emitComment("while: jump after body comes back here");
          /* generate code for test */
+         jumpIfFalse = genCondition(p1);
+         savedLoc2 = emitSkip(1) ;
+         emitComment("while: jump to end belongs here");
+         /* generate code for body */
          cGen(p2);
-         emitRM_Abs("JEQ",ac,savedLoc1,"repeat: jmp back to body");
-         if (TraceCode)  emitComment("<- repeat") ;
-         break; /* repeat */
-
-      case AssignK:
-         if (TraceCode) emitComment("-> assign") ;
-         /* generate code for rhs */
-         cGen(tree->child[0]);
-         /* now store value */
-         loc = st_lookup(tree->attr.name);
-         emitRM("ST",ac,loc,gp,"assign: store value");
-         if (TraceCode)  emitComment("<- assign") ;
-         break; /* assign_k */
-
-      case ReadK:
-         emitRO("IN",ac,0,0,"read integer value");
-         loc = st_lookup(tree->attr.name);
-         emitRM("ST",ac,loc,gp,"read: store value");
-         break;
-      case WriteK:
-         /* generate code for expression to write */
-         cGen(tree->child[0]);
-         /* now output it */
-         emitRO("OUT",ac,0,0,"write ac");
+         emitLine(stmtLine(tree));
+         emitRM_Abs("LDA",pc,savedLoc1,"while: jmp back to test");
+         currentLoc = emitSkip(0) ;
+         emitBackup(savedLoc2) ;
+         emitRM_Abs(jumpIfFalse,ac,currentLoc,"while: jmp to end");
+         emitRestore() ;
+         if (TraceCode)  emitComment("<- while") ;
+         break; /* while */
+
+      case ReturnStmt :
+         if (TraceCode) emitComment("-> return") ;
+         if (tree->child[0] != NULL) genExp(tree->child[0]);
+         genReturn();
+         if (TraceCode)  emitComment("<- return") ;
+         break; /* return */
+
+      case CmpdStmt :
+         genCompound(tree);
          break;
+
       default:
+         /* expression statement */
+         genExp(tree);
          break;
     }
 } /* genStmt */
 
-/* Procedure genExp generates code at an expression node */
+/* Procedure genExp generates code at an expression
+ * node, with the value in ac
+ */
 static void genExp( TreeNode * tree)
-{ int loc;
+{ genInto(tree,ac);
+} /* genExp */
+
+/* Procedure genInto generates code at an expression
+ * node, with the value in register r, using the
+ * registers above it
+ */
+static void genInto( TreeNode * tree, int r)
+{ VarRec * v;
   TreeNode * p1, * p2;
-  switch (tree->kind.exp) {
+  int left, right;
+  switch (tree->exprKind) {
 
-    case ConstK :
+    case Const :
       if (TraceCode) emitComment("-> Const") ;
       /* gen code to load integer constant using LDC */
-      emitRM("LDC",ac,tree->attr.val,0,"load const");
+      emitRM("LDC",r,tree->val,0,"load const");
       if (TraceCode)  emitComment("<- Const") ;
-      break; /* ConstK */
-    
-    case IdK :
-      if (TraceCode) emitComment("-> Id") ;
-      loc = st_lookup(tree->attr.name);
-      emitRM("LD",ac,loc,gp,"load id value");
-      if (TraceCode)  emitComment("<- Id") ;
-      break; /* IdK */
-
-    case OpK :
+      break; /* Const */
+
+    case Var :
+      if (TraceCode) emitComment("-> Var") ;
+      v = lookupVar(tree->name);
+      if (tree->child[0] != NULL)
+      { genAddress(tree,r);
+        emitRM("LD",r,0,r,"load element value");
+      }
+      else if (v->isArray)
+        genBase(v,r);
+      else
+        emitRM("LD",r,v->offset,v->isGlobal ? gp : fp,"load id value");
+      if (TraceCode)  emitComment("<- Var") ;
+      break; /* Var */
+
+    case AssignExpr :
+      if (TraceCode) emitComment("-> assign") ;
+      p1 = tree->child[0];
+      p2 = tree->child[1];
+      if (p1->child[0] == NULL)
+      { v = lookupVar(p1->name);
+        genInto(p2,r);
+        emitRM("ST",r,v->offset,v->isGlobal ? gp : fp,
+               "assign: store value");
+      }
+      else if (valueFirst(tree) && (addressNeed(p1) < NREGS-r))
+      { genInto(p2,r);
+        genAddress(p1,r+1);
+        emitRM("ST",r,0,r+1,"assign: store value");
+      }
+      else
+      { genAddress(p1,r);
+        if (regNeed(p2) < NREGS-r)
+        { genInto(p2,r+1);
+          emitRM("ST",r+1,0,r,"assign: store value");
+          emitRM("LDA",r,0,r+1,"assign: move value");
+        }
+        else
+        { emitRM("ST",r,tmpOffset--,mp,"assign: spill address");
+          genInto(p2,r);
+          emitRM("LD",r+1,++tmpOffset,mp,"assign: reload address");
+          emitRM("ST",r,0,r+1,"assign: store value");
+        }
+      }
+      if (TraceCode)  emitComment("<- assign") ;
+      break; /* AssignExpr */
+
+    case Call :
+      if (strcmp(tree->name,"input") == 0)
+        emitRO("IN",r,0,0,"input integer value");
+      else
+      { /* a call needs all the registers: r is ac */
+        genCall(tree);
+        if (r != ac) emitRM("LDA",r,0,ac,"call: move result");
+      }
+      break; /* Call */
+
+    case OpExpr :
          if (TraceCode) emitComment("-> Op") ;
-         p1 = tree->child[0];
-         p2 = tree->child[1];
-         /* gen code for ac = left arg */
-         cGen(p1);
-         /* gen code to push left operand */
-         emitRM("ST",ac,tmpOffset--,mp,"op: push left");
-         /* gen code for ac = right operand */
-         cGen(p2);
-         /* now load left operand */
-         emitRM("LD",ac1,++tmpOffset,mp,"op: load left");
-         switch (tree->attr.op) {
+         genOperands(tree,r,&left,&right);
+         switch (tree->op) {
             case PLUS :
-               emitRO("ADD",ac,ac1,ac,"op +");
+               emitRO("ADD",r,left,right,"op +");
                break;
             case MINUS :
-               emitRO("SUB",ac,ac1,ac,"op -");
-               break;
-            case TIMES :
-               emitRO("MUL",ac,ac1,ac,"op *");
+               emitRO("SUB",r,left,right,"op -");
                break;
-            case OVER :
-               emitRO("DIV",ac,ac1,ac,"op /");
+            case MUL :
+               emitRO("MUL",r,left,right,"op *");
                break;
-            case LT :
-               emitRO("SUB",ac,ac1,ac,"op <") ;
-               emitRM("JLT",ac,2,pc,"br if true") ;
-               emitRM("LDC",ac,0,ac,"false case") ;
-               emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
+            case DIV :
+               emitRO("DIV",r,left,right,"op /");
                break;
+            case LESSTHAN :
+            case LESSEQUAL :
+            case GREATTHAN :
+            case GREATEQUAL :
             case EQ :
-               emitRO("SUB",ac,ac1,ac,"op ==") ;
-               emitRM("JEQ",ac,2,pc,"br if true");
-               emitRM("LDC",ac,0,ac,"false case") ;
+            case NEQ :
+               emitRO("SUB",r,left,right,"op compare") ;
+               switch (tree->op) {
+                  case LESSTHAN :
+                     emitRM("JLT",r,2,pc,"br if true") ; break;
+                  case LESSEQUAL :
+                     emitRM("JLE",r,2,pc,"br if true") ; break;
+                  case GREATTHAN :
+                     emitRM("JGT",r,2,pc,"br if true") ; break;
+                  case GREATEQUAL :
+                     emitRM("JGE",r,2,pc,"br if true") ; break;
+                  case EQ :
+                     emitRM("JEQ",r,2,pc,"br if true") ; break;
+                  default :
+                     emitRM("JNE",r,2,pc,"br if true") ; break;
+               }
+               emitRM("LDC",r,0,r,"false case") ;
                emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
+               emitRM("LDC",r,1,r,"true case") ;
                break;
             default:
                emitComment("BUG: Unknown operator");
                break;
          } /* case op */
          if (TraceCode)  emitComment("<- Op") ;
-         break; /* OpK */
+         break; /* OpExpr */
 
     default:
       break;
   }
-} /* genExp */
+} /* genInto */
+
+/* Procedure genFunction generates the code of a
+ * function declaration
+ */
+static void genFunction( TreeNode * tree )
+{ TreeNode * p;
+  FunRec * f;
+  int nparams = 0;
+  f = (FunRec *) malloc(sizeof(FunRec));
+  f->name = tree->name;
+  f->entry = emitSkip(0);
+  f->next = funList;
+  funList = f;
+  emitFunction(tree->name);
+  if (TraceCode) emitComment("-> function") ;
+  for (p = tree->child[0]; p != NULL; p = p->sibling)
+    if (p->exprKind == Param)
+    { addVar(p->name,FALSE,ofsParams-nparams,p->isArray,p->isArray);
+      nparams++;
+    }
+  frameSize = 2 + nparams + localSize(tree->child[1]);
+  localOffset = ofsParams - nparams;
+  tmpOffset = 0;
+  emitLine(tree->lineno);
+  emitRM("LDA",mp,-frameSize,fp,"entry: point mp below frame");
+  genCompound(tree->child[1]);
+  /* return at the closing brace */
+  emitLine(tree->child[1]->lineno);
+  genReturn();
+  nVars -= nparams;
+  if (TraceCode)  emitComment("<- function") ;
+} /* genFunction */
 
 /* Procedure cGen recursively generates code by
  * tree traversal
  */
 static void cGen( TreeNode * tree)
-{ if (tree != NULL)
-  { switch (tree->nodekind) {
-      case StmtK:
-        genStmt(tree);
-        break;
-      case ExpK:
-        genExp(tree);
-        break;
-      default:
-        break;
-    }
-    cGen(tree->sibling);
+{ while (tree != NULL)
+  { genStmt(tree);
+    tree = tree->sibling;
   }
 }
 
@@ -193,20 +710,58 @@ static void cGen( TreeNode * tree)
  * of the code file, and is used to print the
  * file name as a comment in the code file
  */
-void codeGen(TreeNode * syntaxTree, char * codefile)
+void codeGen(TreeNode * syntaxTree, char * codefile, char * srcfile)
 {  char * s = malloc(strlen(codefile)+7);
+   TreeNode * t;
+   FunRec * f;
+   PatchRec * patch;
+   int mainLoc;
    strcpy(s,"File: ");
    strcat(s,codefile);
-   emitComment("TINY Compilation to TM Code");
+   emitComment("C-Minus Compilation to TM Code");
    emitComment(s);
+   emitFile(srcfile);
+   /* allocate the global variables */
+   for (t = syntaxTree; t != NULL; t = t->sibling)
+     if (t->exprKind == VarDe)
+     { addVar(t->name,TRUE,globalOffset,t->isArray,FALSE);
+       if (t->isArray) emitArray(t->name,TRUE,globalOffset,varSize(t));
+       globalOffset += varSize(t);
+     }
    /* generate standard prelude */
    emitComment("Standard prelude:");
+   emitLine(0);
    emitRM("LD",mp,0,ac,"load maxaddress from location 0");
    emitRM("ST",ac,0,ac,"clear location 0");
+   emitRM("LDA",fp,0,mp,"frame of main at top of memory");
    emitComment("End of standard prelude.");
-   /* generate code for TINY program */
-   cGen(syntaxTree);
-   /* finish */
+   /* call main; its entry is backpatched */
+   emitRM("ST",fp,ofsOldFp,mp,"call: store fp");
+   emitRM("LDA",ac,2,pc,"call: compute return address");
+   emitRM("ST",ac,ofsRetAddr,fp,"call: store return address");
+   mainLoc = emitSkip(1);
+   emitCall(mainLoc);
    emitComment("End of execution.");
    emitRO("HALT",0,0,0,"");
+   /* generate code for C-Minus program */
+   for (t = syntaxTree; t != NULL; t = t->sibling)
+     if (t->exprKind == FunDe) genFunction(t);
+   /* backpatch the calls of functions declared later */
+   for (f = funList; f != NULL; f = f->next)
+     if (strcmp(f->name,"main") == 0) break;
+   if (f == NULL)
+   { fprintf(listing,"Error: no function main\n");
+     Error = TRUE;
+     return;
+   }
+   emitBackup(mainLoc);
+   emitRM_Abs("LDA",pc,f->entry,"call: jump to main");
+   for (patch = patchList; patch != NULL; patch = patch->next)
+   { for (f = funList; f != NULL; f = f->next)
+       if (strcmp(f->name,patch->name) == 0) break;
+     if (f == NULL) continue;
+     emitBackup(patch->loc);
+     emitRM_Abs("LDA",pc,f->entry,"call: jump to function");
+   }
+   emitRestore();
 }
@@ -1,6 +1,7 @@
 /****************************************************/
 /* File: cgen.h                                     */
-/* The code generator interface to the TINY compiler*/
+/* The code generator interface to the C-Minus      */
+/* compiler                                         */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
@@ -12,8 +13,10 @@
  * file by traversal of the syntax tree. The
  * second parameter (codefile) is the file name
  * of the code file, and is used to print the
- * file name as a comment in the code file
+ * file name as a comment in the code file; the
+ * third (srcfile) is the name of the source file,
+ * recorded for the TM profiler
  */
-void codeGen(TreeNode * syntaxTree, char * codefile);
+void codeGen(TreeNode * syntaxTree, char * codefile, char * srcfile);
 
 #endif
@@ -17,11 +17,38 @@ static int emitLoc = 0 ;
    emitBackup, and emitRestore */
 static int highEmitLoc = 0;
 
+/* the program the instructions are also stored
+ * into (cminus --run), NULL if none
+ */
+static PROGRAM * emitProg = NULL;
+
+/* Procedure emitProgram makes the instructions
+ * emitted from now on be stored into prog too
+ */
+void emitProgram( PROGRAM * prog )
+{ emitProg = prog;
+} /* emitProgram */
+
+/* Procedure storeInstruction stores op r,s,t at
+ * loc of the program being emitted into
+ */
+static void storeInstruction( char * op, int loc, int r, int s, int t )
+{ int k;
+  if (emitProg == NULL) return;
+  for (k = 0; k < opRALim; k++)
+    if (strcmp(opCodeTab[k],op) == 0) break;
+  if ( ! setInstruction(emitProg,loc,k,r,s,t) )
+  { fprintf(listing,"Cannot store %s %d,%d,%d at location %d\n",
+            op,r,s,t,loc);
+    Error = TRUE;
+  }
+} /* storeInstruction */
+
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
  */
 void emitComment( char * c )
-{ if (TraceCode) fprintf(code,"* %s\n",c);}
+{ if (TraceCode && (code != NULL)) fprintf(code,"* %s\n",c);}
 
 /* Procedure emitRO emits a register-only
  * TM instruction
@@ -32,9 +59,13 @@ void emitComment( char * c )
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRO( char *op, int r, int s, int t, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d,%d ",emitLoc++,op,r,s,t);
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
+{ storeInstruction(op,emitLoc,r,s,t);
+  if (code != NULL)
+  { fprintf(code,"%3d:  %5s  %d,%d,%d ",emitLoc,op,r,s,t);
+    if (TraceCode) fprintf(code,"\t%s",c) ;
+    fprintf(code,"\n") ;
+  }
+  ++emitLoc ;
   if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
 } /* emitRO */
 
@@ -47,9 +78,13 @@ void emitRO( char *op, int r, int s, int t, char *c)
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRM( char * op, int r, int d, int s, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",emitLoc++,op,r,d,s);
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
+{ storeInstruction(op,emitLoc,r,d,s);
+  if (code != NULL)
+  { fprintf(code,"%3d:  %5s  %d,%d(%d) ",emitLoc,op,r,d,s);
+    if (TraceCode) fprintf(code,"\t%s",c) ;
+    fprintf(code,"\n") ;
+  }
+  ++emitLoc ;
   if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
 } /* emitRM */
 
@@ -88,10 +123,63 @@ void emitRestore(void)
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRM_Abs( char *op, int r, int a, char * c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",
-               emitLoc,op,r,a-(emitLoc+1),pc);
+{ storeInstruction(op,emitLoc,r,a-(emitLoc+1),pc);
+  if (code != NULL)
+  { fprintf(code,"%3d:  %5s  %d,%d(%d) ",
+                 emitLoc,op,r,a-(emitLoc+1),pc);
+    if (TraceCode) fprintf(code,"\t%s",c) ;
+    fprintf(code,"\n") ;
+  }
   ++emitLoc ;
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
   if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
 } /* emitRM_Abs */
+
+/* Procedure emitFile records the name of the
+ * source file the code is generated from
+ */
+void emitFile( char * name )
+{ if (code != NULL) fprintf(code,"*@file %s\n",name);
+} /* emitFile */
+
+/* Procedure emitFunction records that the code of
+ * function name starts at the current location
+ */
+void emitFunction( char * name )
+{ if (code != NULL) fprintf(code,"*@func %d %s\n",emitLoc,name);
+} /* emitFunction */
+
+/* Procedure emitLine records that the code emitted
+ * from the current location on belongs to source
+ * line lineno
+ */
+void emitLine( int lineno )
+{ static int lastLine = -1;
+  if ( (lineno == lastLine) || (code == NULL) ) return;
+  fprintf(code,"*@line %d %d\n",emitLoc,lineno);
+  lastLine = lineno;
+} /* emitLine */
+
+/* Procedure emitCall records that the instruction
+ * at loc jumps to a function
+ */
+void emitCall( int loc )
+{ if (code != NULL) fprintf(code,"*@call %d\n",loc);
+} /* emitCall */
+
+/* Procedure emitReturn records that the instruction
+ * at the current location returns from a function
+ */
+void emitReturn( void )
+{ if (code != NULL) fprintf(code,"*@ret %d\n",emitLoc);
+} /* emitReturn */
+
+/* Procedure emitArray records an array of size
+ * words whose element 0 is at offset from gp
+ * (isGlobal) or from fp in the function whose
+ * code is being emitted
+ */
+void emitArray( char * name, int isGlobal, int offset, int size )
+{ if (code != NULL)
+    fprintf(code,"*@array %c %d %d %s\n",isGlobal ? 'g' : 'l',
+            offset,size,name);
+} /* emitArray */
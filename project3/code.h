@@ -9,6 +9,8 @@
 #ifndef _CODE_H_
 #define _CODE_H_
 
+#include "libtm.h"
+
 /* pc = program counter  */
 #define  pc 7
 
@@ -23,12 +25,25 @@
  */
 #define gp 5
 
+/* fp = "frame pointer" points
+ * to the frame of the function
+ * being executed
+ */
+#define fp 4
+
 /* accumulator */
 #define  ac 0
 
 /* 2nd accumulator */
 #define  ac1 1
 
+/* the words of a frame, relative to fp (see
+ * the run-time organization in cgen.c)
+ */
+#define   ofsOldFp    0
+#define   ofsRetAddr  (-1)
+#define   ofsParams   (-2)
+
 /* code emitting utilities */
 
 /* Procedure emitComment prints a comment line 
@@ -83,4 +98,51 @@ void emitRestore(void);
  */
 void emitRM_Abs( char *op, int r, int a, char * c);
 
+/* The following procedures emit comments of the
+ * form "*@kind args" that the TM reads to relate
+ * code locations to the source program. They are
+ * written whether or not TraceCode is TRUE
+ */
+
+/* Procedure emitFile records the name of the
+ * source file the code is generated from
+ */
+void emitFile( char * name );
+
+/* Procedure emitFunction records that the code of
+ * function name starts at the current location
+ */
+void emitFunction( char * name );
+
+/* Procedure emitLine records that the code emitted
+ * from the current location on belongs to source
+ * line lineno
+ */
+void emitLine( int lineno );
+
+/* Procedure emitCall records that the instruction
+ * at loc jumps to a function
+ */
+void emitCall( int loc );
+
+/* Procedure emitReturn records that the instruction
+ * at the current location returns from a function
+ */
+void emitReturn( void );
+
+/* Procedure emitArray records an array of size
+ * words whose element 0 is at offset from gp
+ * (isGlobal) or from fp in the function whose
+ * code is being emitted
+ */
+void emitArray( char * name, int isGlobal, int offset, int size );
+
+/* Procedure emitProgram makes the instructions
+ * emitted from now on be stored into prog as
+ * well as written to the code file, which may
+ * then be NULL (cminus --run); prog is a
+ * PROGRAM of libtm.h
+ */
+void emitProgram( PROGRAM * prog );
+
 #endif
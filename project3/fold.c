@@ -0,0 +1,206 @@
+/****************************************************/
+/* File: fold.c                                     */
+/* Constant folding on the syntax tree of the       */
+/* C-Minus compiler                                 */
+/* (evaluates constant operations at compile time)  */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "fold.h"
+
+/* the number of operators folded into constants
+ * and of identities reduced, for TraceOpt
+ */
+static int nFolded;
+static int nSimplified;
+
+/* Procedure freeTree frees the nodes of the
+ * operand t; the names are shared with the
+ * declarations and are kept
+ */
+static void freeTree( TreeNode * t )
+{ int i;
+  if (t == NULL) return;
+  for (i = 0; i < MAXCHILDREN; i++) freeTree(t->child[i]);
+  freeTree(t->sibling);
+  free(t);
+} /* freeTree */
+
+/* Function isConst returns nonzero if t is the
+ * constant v
+ */
+static int isConst( TreeNode * t, int v )
+{ return (t->exprKind == Const) && (t->val == v);
+} /* isConst */
+
+/* Function isPure returns nonzero if evaluating t
+ * has no effect and cannot fault: it only reads
+ * scalar variables, without calls, assignments,
+ * array elements or divisions
+ */
+static int isPure( TreeNode * t )
+{ switch (t->exprKind)
+  { case Const :
+      return TRUE;
+    case Var :
+      return t->child[0] == NULL;
+    case OpExpr :
+      return (t->op != DIV) && isPure(t->child[0]) && isPure(t->child[1]);
+    default :
+      return FALSE;
+  }
+} /* isPure */
+
+/* Function sameTree returns nonzero if the pure
+ * trees a and b compute the same value
+ */
+static int sameTree( TreeNode * a, TreeNode * b )
+{ if (a->exprKind != b->exprKind) return FALSE;
+  switch (a->exprKind)
+  { case Const :
+      return a->val == b->val;
+    case Var :
+      return strcmp(a->name,b->name) == 0;
+    case OpExpr :
+      return (a->op == b->op) && sameTree(a->child[0],b->child[0])
+             && sameTree(a->child[1],b->child[1]);
+    default :
+      return FALSE;
+  }
+} /* sameTree */
+
+/* Procedure makeConst turns the operator node t
+ * into the constant v
+ */
+static void makeConst( TreeNode * t, int v )
+{ freeTree(t->child[0]);
+  freeTree(t->child[1]);
+  t->child[0] = t->child[1] = NULL;
+  t->exprKind = Const;
+  t->val = v;
+  t->type = Int;
+  t->isArray = FALSE;
+} /* makeConst */
+
+/* Procedure replaceBy replaces the operator node
+ * t by its operand x, freeing the other operand
+ */
+static void replaceBy( TreeNode * t, TreeNode * x )
+{ TreeNode * sibling = t->sibling;
+  TreeNode * other = (t->child[0] == x) ? t->child[1] : t->child[0];
+  freeTree(other);
+  *t = *x;
+  t->sibling = sibling;
+  free(x);
+} /* replaceBy */
+
+/* Function compare returns the value of a compare
+ * of a and b as the TM code computes it, by the
+ * sign of the difference a-b
+ */
+static int compare( TokenType op, int a, int b )
+{ int d = (int) ((unsigned) a - (unsigned) b);
+  switch (op)
+  { case LESSTHAN : return d < 0;
+    case LESSEQUAL : return d <= 0;
+    case GREATTHAN : return d > 0;
+    case GREATEQUAL : return d >= 0;
+    case EQ : return d == 0;
+    default : return d != 0;
+  }
+} /* compare */
+
+/* Procedure foldOp folds the operator node t,
+ * whose operands are already folded
+ */
+static void foldOp( TreeNode * t )
+{ TreeNode * p1 = t->child[0];
+  TreeNode * p2 = t->child[1];
+  int a, b;
+  if ((p1->exprKind == Const) && (p2->exprKind == Const))
+  { a = p1->val;
+    b = p2->val;
+    switch (t->op)
+    { case PLUS :
+        makeConst(t,(int) ((unsigned) a + (unsigned) b));
+        break;
+      case MINUS :
+        makeConst(t,(int) ((unsigned) a - (unsigned) b));
+        break;
+      case MUL :
+        makeConst(t,(int) ((unsigned) a * (unsigned) b));
+        break;
+      case DIV :
+        if (b == 0)
+        { fprintf(listing,"Warning: division by zero at line %d\n",
+                  t->lineno);
+          return;
+        }
+        /* the TM faults on the overflow as well */
+        if ((a == INT_MIN) && (b == -1)) return;
+        makeConst(t,a / b);
+        break;
+      default :
+        makeConst(t,compare(t->op,a,b));
+        break;
+    }
+    nFolded++;
+    return;
+  }
+  switch (t->op)
+  { case PLUS :
+      if (isConst(p2,0)) replaceBy(t,p1);
+      else if (isConst(p1,0)) replaceBy(t,p2);
+      else return;
+      break;
+    case MINUS :
+      if (isConst(p2,0)) replaceBy(t,p1);
+      else if (isPure(p1) && isPure(p2) && sameTree(p1,p2)) makeConst(t,0);
+      else return;
+      break;
+    case MUL :
+      if (isConst(p2,1)) replaceBy(t,p1);
+      else if (isConst(p1,1)) replaceBy(t,p2);
+      else if ((isConst(p2,0) && isPure(p1)) || (isConst(p1,0) && isPure(p2)))
+        makeConst(t,0);
+      else return;
+      break;
+    case DIV :
+      if (isConst(p2,0))
+        fprintf(listing,"Warning: division by zero at line %d\n",t->lineno);
+      if (isConst(p2,1)) replaceBy(t,p1);
+      else return;
+      break;
+    default :
+      /* x op x compares 0 with 0 */
+      if (isPure(p1) && isPure(p2) && sameTree(p1,p2))
+        makeConst(t,compare(t->op,0,0));
+      else return;
+      break;
+  }
+  nSimplified++;
+} /* foldOp */
+
+/* Procedure fold folds the operators of the tree
+ * t in postorder
+ */
+static void fold( TreeNode * t )
+{ int i;
+  while (t != NULL)
+  { for (i = 0; i < MAXCHILDREN; i++) fold(t->child[i]);
+    if (t->exprKind == OpExpr) foldOp(t);
+    t = t->sibling;
+  }
+} /* fold */
+
+/* Procedure foldConstants simplifies the operator
+ * nodes of the analyzed syntax tree
+ */
+void foldConstants( TreeNode * syntaxTree )
+{ nFolded = nSimplified = 0;
+  fold(syntaxTree);
+  if (TraceOpt)
+    fprintf(listing,"Folding constants: %d operators folded, "
+            "%d simplified\n",nFolded,nSimplified);
+} /* foldConstants */
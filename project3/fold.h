@@ -0,0 +1,22 @@
+/****************************************************/
+/* File: fold.h                                     */
+/* Constant folding on the syntax tree of the       */
+/* C-Minus compiler                                 */
+/* (evaluates constant operations at compile time)  */
+/****************************************************/
+
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+/* Procedure foldConstants simplifies the operator
+ * nodes of the analyzed syntax tree: operators on
+ * constants become constants, with the results
+ * the TM code would compute, and the identities
+ * x+0, x-0, x*1, x/1 and, where x has no side
+ * effects, x*0, x-x and x op x for a compare are
+ * reduced. A division by the constant 0 is left
+ * for run time and reported as a warning
+ */
+void foldConstants( TreeNode * syntaxTree );
+
+#endif
@@ -127,6 +127,12 @@ extern int TraceAnalyze;
  */
 extern int TraceCode;
 
+/* TraceOpt = TRUE causes the constant folder and
+ * the IR optimizer to report the work of their
+ * passes to the listing
+ */
+extern int TraceOpt;
+
 /* Error = TRUE prevents further passes if an error occurs */
 extern int Error; 
 #endif
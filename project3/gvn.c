@@ -0,0 +1,221 @@
+/****************************************************/
+/* File: gvn.c                                      */
+/* Global value numbering on the SSA form of the IR */
+/* (finds and removes redundant computations)       */
+/****************************************************/
+
+#include "globals.h"
+#include "ir.h"
+#include "ssa.h"
+#include "gvn.h"
+
+/* The blocks are visited in a preorder walk of the
+ * dominator tree, with a scoped table of the
+ * values computed by the dominators of the block.
+ * A load is keyed with the state of the memory
+ * it reads, a generation number that every store
+ * and call renews; a block continues the state
+ * of its immediate dominator only if that is its
+ * only predecessor, and starts a new one if
+ * other paths, with unknown stores, reach it
+ */
+
+/* the size of the hash table */
+#define SIZE 211
+
+typedef struct ValueRec
+   { IROP op;
+     int a, b, k;
+     int gen;                  /* memory state of a load */
+     int reg;                  /* the register holding it */
+     struct ValueRec * next;   /* in the bucket */
+   } ValueRec;
+
+static ValueRec * table[SIZE];
+
+/* the entries of the table, in the order they
+ * were made, to remove them leaving a block
+ */
+static ValueRec ** scope;
+static int scopeTop;
+static int scopeSize;
+
+/* repl[r] is the register whose value register r
+ * recomputes, 0 if none
+ */
+static int * repl;
+
+/* the memory state at the end of each block, and
+ * the last generation given
+ */
+static int * endGen;
+static int lastGen;
+
+static int removed;
+
+/* Function hash returns the bucket of a value */
+static int hash( IROP op, int a, int b, int k, int gen )
+{ unsigned h = (unsigned) op;
+  h = h * 31 + (unsigned) a;
+  h = h * 31 + (unsigned) b;
+  h = h * 31 + (unsigned) k;
+  h = h * 31 + (unsigned) gen;
+  return h % SIZE;
+} /* hash */
+
+/* Function lookupValue returns the register that
+ * holds the value, 0 if none
+ */
+static int lookupValue( IROP op, int a, int b, int k, int gen )
+{ ValueRec * v;
+  for (v = table[hash(op,a,b,k,gen)]; v != NULL; v = v->next)
+    if ((v->op == op) && (v->a == a) && (v->b == b) && (v->k == k)
+        && (v->gen == gen))
+      return v->reg;
+  return 0;
+} /* lookupValue */
+
+/* Procedure insertValue records that register reg
+ * holds the value
+ */
+static void insertValue( IROP op, int a, int b, int k, int gen, int reg )
+{ int h = hash(op,a,b,k,gen);
+  ValueRec * v = (ValueRec *) malloc(sizeof(ValueRec));
+  v->op = op;
+  v->a = a;
+  v->b = b;
+  v->k = k;
+  v->gen = gen;
+  v->reg = reg;
+  v->next = table[h];
+  table[h] = v;
+  if (scopeTop == scopeSize)
+  { scopeSize = 2*scopeSize + 64;
+    scope = (ValueRec **) realloc(scope,scopeSize*sizeof(ValueRec *));
+  }
+  scope[scopeTop++] = v;
+} /* insertValue */
+
+/* Procedure popValues removes the entries made
+ * after the first mark of them; each is at the
+ * head of its bucket then
+ */
+static void popValues( int mark )
+{ ValueRec * v;
+  while (scopeTop > mark)
+  { v = scope[--scopeTop];
+    table[hash(v->op,v->a,v->b,v->k,v->gen)] = v->next;
+    free(v);
+  }
+} /* popValues */
+
+/* Function isCommutative returns nonzero if the
+ * operands of op can be swapped
+ */
+static int isCommutative( IROP op )
+{ return (op == irADD) || (op == irMUL) || (op == irEQ) || (op == irNE);
+} /* isCommutative */
+
+/* Procedure numberBlock numbers the values of b
+ * and of the blocks it dominates
+ */
+static void numberBlock( BLOCK * b )
+{ int mark = scopeTop, gen, a, c, r, j;
+  IRINST * i, * next;
+  BLOCK * d;
+  if ((b->npred == 1) && (b->pred[0] == b->idom)) gen = endGen[b->idom->id];
+  else gen = ++lastGen;
+  for (i = b->first; i != NULL; i = next)
+  { next = i->next;
+    /* the operands of a PHI may come later */
+    if (i->op != irPHI)
+      for (j = 0; j < irNumUses(i); j++)
+        if (repl[*irUse(i,j)] != 0) *irUse(i,j) = repl[*irUse(i,j)];
+    a = i->a;
+    c = i->b;
+    switch (i->op)
+    { case irCONST :
+      case irADDRL :
+      case irADDRG :
+        r = lookupValue(i->op,0,0,i->k,0);
+        break;
+      case irADD :
+      case irSUB :
+      case irMUL :
+      case irDIV :
+      case irLT :
+      case irLE :
+      case irGT :
+      case irGE :
+      case irEQ :
+      case irNE :
+        if (isCommutative(i->op) && (a > c))
+        { a = i->b;
+          c = i->a;
+        }
+        r = lookupValue(i->op,a,c,0,0);
+        break;
+      case irLOADL :
+      case irLOADG :
+        r = lookupValue(i->op,0,0,i->k,gen);
+        break;
+      case irLOAD :
+        r = lookupValue(i->op,a,0,0,gen);
+        break;
+      case irSTOREL :
+      case irSTOREG :
+        gen = ++lastGen;
+        insertValue((i->op == irSTOREL) ? irLOADL : irLOADG,0,0,i->k,gen,a);
+        continue;
+      case irSTORE :
+        gen = ++lastGen;
+        insertValue(irLOAD,a,0,0,gen,c);
+        continue;
+      case irCALL :
+        gen = ++lastGen;
+        continue;
+      default :
+        continue;
+    }
+    if (r != 0)
+    { repl[i->dst] = r;
+      irRemove(i);
+      irFreeInst(i);
+      removed++;
+    }
+    else if ((i->op == irCONST) || (i->op == irADDRL) || (i->op == irADDRG))
+      insertValue(i->op,0,0,i->k,0,i->dst);
+    else if ((i->op == irLOADL) || (i->op == irLOADG))
+      insertValue(i->op,0,0,i->k,gen,i->dst);
+    else if (i->op == irLOAD)
+      insertValue(i->op,a,0,0,gen,i->dst);
+    else
+      insertValue(i->op,a,c,0,0,i->dst);
+  }
+  endGen[b->id] = gen;
+  for (d = b->child; d != NULL; d = d->sibling) numberBlock(d);
+  popValues(mark);
+} /* numberBlock */
+
+/* Function numberValues removes the instructions
+ * of f that recompute a value
+ */
+int numberValues( IRFUNC * f )
+{ BLOCK * b;
+  IRINST * i;
+  int j;
+  findDominators(f);
+  repl = (int *) calloc(f->nregs+1,sizeof(int));
+  endGen = (int *) calloc(f->nblocks+1,sizeof(int));
+  lastGen = 0;
+  removed = 0;
+  numberBlock(f->entry);
+  /* the operands of the PHIs */
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; (i != NULL) && (i->op == irPHI); i = i->next)
+      for (j = 0; j < i->nargs; j++)
+        if (repl[i->args[j]] != 0) i->args[j] = repl[i->args[j]];
+  free(repl);
+  free(endGen);
+  return removed;
+} /* numberValues */
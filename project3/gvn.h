@@ -0,0 +1,22 @@
+/****************************************************/
+/* File: gvn.h                                      */
+/* Global value numbering on the SSA form of the IR */
+/* (finds and removes redundant computations)       */
+/****************************************************/
+
+#ifndef _GVN_H_
+#define _GVN_H_
+
+/* Function numberValues removes the instructions
+ * of f, in SSA form, that recompute a value that
+ * an instruction dominating them has computed:
+ * arithmetic and compares of the same operands,
+ * addresses, and loads of memory that no store
+ * or call can have changed in between, a load
+ * after a store of the same word taking the
+ * value stored. It returns the number of
+ * instructions removed
+ */
+int numberValues( IRFUNC * f );
+
+#endif
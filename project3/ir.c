@@ -0,0 +1,877 @@
+/****************************************************/
+/* File: ir.c                                       */
+/* The three-address intermediate representation:   */
+/* lowering from the syntax tree, the control-flow  */
+/* graph and the IR dump                            */
+/* of the C-Minus compiler                          */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "ir.h"
+
+char * irOpTab[] =
+   { "const", "copy", "add", "sub", "mul", "div",
+     "lt", "le", "gt", "ge", "eq", "ne",
+     "loadl", "storel", "loadg", "storeg", "addrl", "addrg",
+     "load", "store", "in", "out", "call", "ret", "jump", "branch", "phi"
+   };
+
+/********************************************/
+/*      I N S T R U C T I O N S             */
+/********************************************/
+
+/* Function irNewReg returns a fresh register of f */
+int irNewReg( IRFUNC * f )
+{ return f->nregs++;
+} /* irNewReg */
+
+/* Function irNewInst returns a new instruction
+ * that belongs to no block
+ */
+IRINST * irNewInst( IROP op, int dst, int a, int b, int k )
+{ IRINST * i = (IRINST *) calloc(1,sizeof(IRINST));
+  if (i == NULL)
+  { fprintf(stderr,"Out of memory for the IR\n");
+    exit(1);
+  }
+  i->op = op;
+  i->dst = dst;
+  i->a = a;
+  i->b = b;
+  i->k = k;
+  return i;
+} /* irNewInst */
+
+/* Function irNewBlock returns an empty block of
+ * f, not yet in its layout
+ */
+BLOCK * irNewBlock( IRFUNC * f )
+{ BLOCK * b = (BLOCK *) calloc(1,sizeof(BLOCK));
+  if (b == NULL)
+  { fprintf(stderr,"Out of memory for the IR\n");
+    exit(1);
+  }
+  b->id = f->nblocks++;
+  return b;
+} /* irNewBlock */
+
+/* Procedure irAppend appends i to block b */
+void irAppend( BLOCK * b, IRINST * i )
+{ i->block = b;
+  i->prev = b->last;
+  i->next = NULL;
+  if (b->last == NULL) b->first = i;
+  else b->last->next = i;
+  b->last = i;
+} /* irAppend */
+
+/* Procedure irInsertBefore inserts i before at,
+ * in the block of at
+ */
+void irInsertBefore( IRINST * at, IRINST * i )
+{ i->block = at->block;
+  i->next = at;
+  i->prev = at->prev;
+  if (at->prev == NULL) at->block->first = i;
+  else at->prev->next = i;
+  at->prev = i;
+} /* irInsertBefore */
+
+/* Procedure irRemove unlinks i from its block */
+void irRemove( IRINST * i )
+{ BLOCK * b = i->block;
+  if (i->prev == NULL) b->first = i->next;
+  else i->prev->next = i->next;
+  if (i->next == NULL) b->last = i->prev;
+  else i->next->prev = i->prev;
+  i->prev = i->next = NULL;
+  i->block = NULL;
+} /* irRemove */
+
+/* Procedure irFreeInst frees i, which belongs to
+ * no block, with its PHI arguments
+ */
+void irFreeInst( IRINST * i )
+{ free(i->args);
+  free(i->from);
+  free(i);
+} /* irFreeInst */
+
+/* Function irNumUses returns the number of
+ * operand registers of i
+ */
+int irNumUses( IRINST * i )
+{ switch (i->op)
+  { case irCONST :
+    case irLOADL :
+    case irLOADG :
+    case irADDRL :
+    case irADDRG :
+    case irIN :
+    case irJUMP :
+      return 0;
+    case irCOPY :
+    case irSTOREL :
+    case irSTOREG :
+    case irLOAD :
+    case irOUT :
+    case irBRANCH :
+      return 1;
+    case irRET :
+      return (i->a != 0);
+    case irCALL :
+    case irPHI :
+      return i->nargs;
+    default :
+      return 2;
+  }
+} /* irNumUses */
+
+/* Function irUse returns the address of operand
+ * n of i
+ */
+int * irUse( IRINST * i, int n )
+{ if ((i->op == irCALL) || (i->op == irPHI)) return &i->args[n];
+  return (n == 0) ? &i->a : &i->b;
+} /* irUse */
+
+/* Function irIsTerminator returns nonzero for the
+ * operations that end a block
+ */
+int irIsTerminator( IROP op )
+{ return (op == irJUMP) || (op == irBRANCH) || (op == irRET);
+} /* irIsTerminator */
+
+/* Function irFold computes d = a op b for the
+ * arithmetic and compare operations, returning
+ * 0 for a division by zero
+ */
+int irFold( IROP op, int a, int b, int * d )
+{ int diff = (int) ((unsigned) a - (unsigned) b);
+  switch (op)
+  { case irADD : *d = (int) ((unsigned) a + (unsigned) b); break;
+    case irSUB : *d = diff; break;
+    case irMUL : *d = (int) ((unsigned) a * (unsigned) b); break;
+    case irDIV :
+      if (b == 0) return 0;
+      /* the one quotient that overflows wraps too */
+      if (b == -1) *d = (int) (0u - (unsigned) a);
+      else *d = a / b;
+      break;
+    case irLT : *d = (diff < 0); break;
+    case irLE : *d = (diff <= 0); break;
+    case irGT : *d = (diff > 0); break;
+    case irGE : *d = (diff >= 0); break;
+    case irEQ : *d = (diff == 0); break;
+    case irNE : *d = (diff != 0); break;
+    default : return 0;
+  }
+  return 1;
+} /* irFold */
+
+/********************************************/
+/*   C O N T R O L - F L O W   G R A P H    */
+/********************************************/
+
+/* Procedure prunePhis drops the arguments of the
+ * PHIs of b whose edge is no longer among the
+ * predecessors of b
+ */
+static void prunePhis( BLOCK * b )
+{ IRINST * i;
+  int j, m, n;
+  char * used = (char *) calloc(b->npred+1,1);
+  for (i = b->first; i != NULL; i = i->next)
+  { if (i->op != irPHI) continue;
+    memset(used,0,b->npred+1);
+    n = 0;
+    for (m = 0; m < i->nargs; m++)
+    { for (j = 0; j < b->npred; j++)
+        if (! used[j] && (b->pred[j] == i->from[m])) break;
+      if (j == b->npred) continue;
+      used[j] = TRUE;
+      i->args[n] = i->args[m];
+      i->from[n] = i->from[m];
+      n++;
+    }
+    i->nargs = n;
+  }
+  free(used);
+} /* prunePhis */
+
+/* Procedure irBuildCFG recomputes the predecessors
+ * of the blocks of f from the successors their
+ * last instructions have, deletes the blocks that
+ * cannot be reached from the entry and numbers
+ * the others in layout order
+ */
+void irBuildCFG( IRFUNC * f )
+{ BLOCK * b, * prev, * next;
+  BLOCK ** stack;
+  int n = 0, top = 0, i;
+  for (b = f->entry; b != NULL; b = b->next)
+  { n++;
+    b->id = -1; /* not reached */
+    b->npred = 0;
+    if (b->last == NULL) b->nsucc = 0;
+    else if (b->last->op == irJUMP) b->nsucc = 1;
+    else if (b->last->op == irBRANCH) b->nsucc = 2;
+    else b->nsucc = 0;
+  }
+  stack = (BLOCK **) malloc((n+1)*sizeof(BLOCK *));
+  f->entry->id = 0;
+  stack[top++] = f->entry;
+  while (top > 0)
+  { b = stack[--top];
+    for (i = 0; i < b->nsucc; i++)
+      if (b->succ[i]->id < 0)
+      { b->succ[i]->id = 0;
+        stack[top++] = b->succ[i];
+      }
+  }
+  free(stack);
+  /* number the reachable blocks and find their predecessors */
+  n = 0;
+  for (b = f->entry; b != NULL; b = b->next)
+    if (b->id >= 0)
+    { b->id = n++;
+      for (i = 0; i < b->nsucc; i++) b->succ[i]->npred++;
+    }
+  f->nblocks = n;
+  for (b = f->entry; b != NULL; b = b->next)
+  { free(b->pred);
+    b->pred = (BLOCK **) malloc((b->npred+1)*sizeof(BLOCK *));
+    b->npred = 0;
+  }
+  for (b = f->entry; b != NULL; b = b->next)
+    if (b->id >= 0)
+      for (i = 0; i < b->nsucc; i++)
+      { next = b->succ[i];
+        next->pred[next->npred++] = b;
+      }
+  for (b = f->entry; b != NULL; b = b->next)
+    if (b->id >= 0) prunePhis(b);
+  /* unlink the unreachable blocks */
+  prev = NULL;
+  for (b = f->entry; b != NULL; b = next)
+  { next = b->next;
+    if (b->id < 0)
+    { IRINST * p, * q;
+      prev->next = next;
+      for (p = b->first; p != NULL; p = q)
+      { q = p->next;
+        irFreeInst(p);
+      }
+      free(b->pred);
+      free(b);
+      continue;
+    }
+    prev = b;
+  }
+} /* irBuildCFG */
+
+/* Procedure irCheckPhis exits with an error if a
+ * PHI of f follows another instruction of its
+ * block or has an argument from a block that is
+ * not among the predecessors of its block
+ */
+void irCheckPhis( IRFUNC * f )
+{ BLOCK * b;
+  IRINST * i;
+  int m, j, other;
+  for (b = f->entry; b != NULL; b = b->next)
+  { other = FALSE;
+    for (i = b->first; i != NULL; i = i->next)
+    { if (i->op != irPHI)
+      { other = TRUE;
+        continue;
+      }
+      if (other)
+      { fprintf(stderr,"Bad IR in %s: PHI r%d follows other "
+                "instructions of B%d\n",f->name,i->dst,b->id);
+        exit(1);
+      }
+      for (m = 0; m < i->nargs; m++)
+      { for (j = 0; j < b->npred; j++)
+          if (b->pred[j] == i->from[m]) break;
+        if (j == b->npred)
+        { fprintf(stderr,"Bad IR in %s: argument %d of PHI r%d of "
+                  "B%d is not from a predecessor\n",f->name,m,i->dst,b->id);
+          exit(1);
+        }
+      }
+    }
+  }
+} /* irCheckPhis */
+
+/* Function jumpTarget returns the block that a
+ * jump to b ends up in, passing the blocks that
+ * only jump
+ */
+static BLOCK * jumpTarget( IRFUNC * f, BLOCK * b )
+{ int n = 0;
+  while ((b != f->entry) && (b->first == b->last)
+         && (b->last->op == irJUMP) && (b->succ[0] != b)
+         && (n++ <= f->nblocks))
+    b = b->succ[0];
+  return b;
+} /* jumpTarget */
+
+/* Procedure irSimplifyCFG simplifies the control
+ * flow of f, which has no PHIs
+ */
+void irSimplifyCFG( IRFUNC * f )
+{ BLOCK * b, * s;
+  IRINST * i;
+  int j;
+  for (b = f->entry; b != NULL; b = b->next)
+    for (j = 0; j < b->nsucc; j++) b->succ[j] = jumpTarget(f,b->succ[j]);
+  irBuildCFG(f);
+  for (b = f->entry; b != NULL; b = b->next)
+    while ((b->nsucc == 1) && (b->last->op == irJUMP)
+           && ((s = b->succ[0]) != b) && (s != f->entry) && (s->npred == 1))
+    { irRemove(b->last);
+      while ((i = s->first) != NULL)
+      { irRemove(i);
+        irAppend(b,i);
+      }
+      b->succ[0] = s->succ[0];
+      b->succ[1] = s->succ[1];
+      b->nsucc = s->nsucc;
+      /* s is left empty and unreachable */
+      s->nsucc = 0;
+      s->npred = 0;
+    }
+  irBuildCFG(f);
+} /* irSimplifyCFG */
+
+/********************************************/
+/*           L O W E R I N G                */
+/********************************************/
+
+/* the variables in scope, innermost last, with
+ * the storage cgen.c gives them
+ */
+#define MAXVARS 1024
+
+typedef struct
+   { char * name;
+     int isGlobal;  /* addressed from gp, else from fp */
+     int offset;
+     int isArray;   /* offset locates element 0 */
+     int isRef;     /* array parameter: holds the address */
+   } VarRec;
+
+static VarRec varTab[MAXVARS];
+static int nVars = 0;
+
+/* the declarations of the program */
+static TreeNode * declList;
+
+static IRPROGRAM * irProg;
+
+/* the function being lowered, the block its
+ * instructions go to, the last block of its
+ * layout and the source line of the statement
+ */
+static IRFUNC * curFunc;
+static BLOCK * curBlock;
+static BLOCK * lastBlock;
+static int curLine;
+
+/* localOffset is the offset of the next local
+ * variable from fp, lowOffset the lowest it has
+ * been in the function
+ */
+static int localOffset;
+static int lowOffset;
+
+static int lowerExp( TreeNode * tree );
+static void lowerStmts( TreeNode * tree );
+
+/* Procedure addVar enters a variable into the
+ * innermost scope
+ */
+static void addVar( char * name, int isGlobal, int offset,
+                    int isArray, int isRef )
+{ if (nVars == MAXVARS)
+  { fprintf(listing,"Too many variables in scope at %s\n",name);
+    Error = TRUE;
+    return;
+  }
+  varTab[nVars].name = name;
+  varTab[nVars].isGlobal = isGlobal;
+  varTab[nVars].offset = offset;
+  varTab[nVars].isArray = isArray;
+  varTab[nVars].isRef = isRef;
+  nVars++;
+} /* addVar */
+
+/* Function lookupVar returns the innermost
+ * variable called name
+ */
+static VarRec * lookupVar( char * name )
+{ int i;
+  for (i = nVars-1; i >= 0; i--)
+    if (strcmp(varTab[i].name,name) == 0) return &varTab[i];
+  fprintf(listing,"BUG: no storage for %s\n",name);
+  Error = TRUE;
+  return &varTab[0];
+} /* lookupVar */
+
+/* Function varSize returns the number of words of
+ * a variable declaration
+ */
+static int varSize( TreeNode * t )
+{ if (t->isArray && (t->child[0] != NULL)) return t->child[0]->val;
+  return 1;
+} /* varSize */
+
+/* Procedure addArray records an array for the
+ * "*@array" marks
+ */
+static void addArray( IRARRAY ** list, char * name, int offset, int size )
+{ IRARRAY * a = (IRARRAY *) malloc(sizeof(IRARRAY));
+  a->name = name;
+  a->offset = offset;
+  a->size = size;
+  a->next = *list;
+  *list = a;
+} /* addArray */
+
+/* Function stmtLine returns the source line a
+ * statement is attributed to: that of its
+ * condition or value where it has one
+ */
+static int stmtLine( TreeNode * t )
+{ switch (t->exprKind)
+  { case IfStmt :
+    case IfElseStmt :
+    case WhileStmt :
+    case ReturnStmt :
+      if (t->child[0] != NULL) return t->child[0]->lineno;
+      break;
+    default :
+      break;
+  }
+  return t->lineno;
+} /* stmtLine */
+
+/* Function newBlock returns an empty block of the
+ * function being lowered
+ */
+static BLOCK * newBlock( void )
+{ return irNewBlock(curFunc);
+} /* newBlock */
+
+/* Procedure enterBlock appends b to the layout;
+ * the instructions generated next go into it
+ */
+static void enterBlock( BLOCK * b )
+{ if (lastBlock == NULL) curFunc->entry = b;
+  else lastBlock->next = b;
+  lastBlock = b;
+  curBlock = b;
+} /* enterBlock */
+
+/* Function gen appends an instruction to the
+ * current block
+ */
+static IRINST * gen( IROP op, int dst, int a, int b, int k )
+{ IRINST * i = irNewInst(op,dst,a,b,k);
+  i->lineno = curLine;
+  irAppend(curBlock,i);
+  return i;
+} /* gen */
+
+/* Function genValue appends an instruction that
+ * defines a fresh register, and returns it
+ */
+static int genValue( IROP op, int a, int b, int k )
+{ int d = irNewReg(curFunc);
+  gen(op,d,a,b,k);
+  return d;
+} /* genValue */
+
+/* Procedure genJump ends the current block with a
+ * jump to target
+ */
+static void genJump( BLOCK * target )
+{ gen(irJUMP,0,0,0,0);
+  curBlock->succ[0] = target;
+} /* genJump */
+
+/* Procedure genBranch ends the current block with
+ * a branch on register c
+ */
+static void genBranch( int c, BLOCK * ifTrue, BLOCK * ifFalse )
+{ gen(irBRANCH,0,c,0,0);
+  curBlock->succ[0] = ifTrue;
+  curBlock->succ[1] = ifFalse;
+} /* genBranch */
+
+/* Function lowerBase returns a register holding
+ * the address of element 0 of array v
+ */
+static int lowerBase( VarRec * v, char * name )
+{ IRINST * i;
+  if (v->isRef)
+    i = gen(irLOADL,irNewReg(curFunc),0,0,v->offset);
+  else
+    i = gen(v->isGlobal ? irADDRG : irADDRL,irNewReg(curFunc),0,0,v->offset);
+  i->name = name;
+  return i->dst;
+} /* lowerBase */
+
+/* Function lowerElement returns a register holding
+ * the address of the element of the indexed
+ * variable tree
+ */
+static int lowerElement( TreeNode * tree )
+{ int index = lowerExp(tree->child[0]);
+  int base = lowerBase(lookupVar(tree->name),tree->name);
+  return genValue(irADD,base,index,0);
+} /* lowerElement */
+
+/* Function lowerCall lowers a call, returning the
+ * register of its value, 0 if it has none
+ */
+static int lowerCall( TreeNode * tree )
+{ TreeNode * p;
+  IRINST * i;
+  int nargs = 0, v;
+  if (strcmp(tree->name,"input") == 0) return genValue(irIN,0,0,0);
+  if (strcmp(tree->name,"output") == 0)
+  { v = lowerExp(tree->child[0]);
+    gen(irOUT,0,v,0,0);
+    return 0;
+  }
+  for (p = tree->child[0]; p != NULL; p = p->sibling) nargs++;
+  i = irNewInst(irCALL,0,0,0,0);
+  i->name = tree->name;
+  i->nargs = nargs;
+  i->args = (int *) malloc((nargs+1)*sizeof(int));
+  nargs = 0;
+  for (p = tree->child[0]; p != NULL; p = p->sibling)
+    i->args[nargs++] = lowerExp(p);
+  for (p = declList; p != NULL; p = p->sibling)
+    if ((p->exprKind == FunDe) && (strcmp(p->name,tree->name) == 0))
+      break;
+  if ((p != NULL) && (p->type != Void)) i->dst = irNewReg(curFunc);
+  i->lineno = curLine;
+  irAppend(curBlock,i);
+  return i->dst;
+} /* lowerCall */
+
+/* Function lowerExp lowers an expression, returning
+ * the register of its value
+ */
+static int lowerExp( TreeNode * tree )
+{ VarRec * v;
+  IRINST * i;
+  int addr, value;
+  switch (tree->exprKind)
+  { case Const :
+      return genValue(irCONST,0,0,tree->val);
+    case Var :
+      if (tree->child[0] != NULL)
+        return genValue(irLOAD,lowerElement(tree),0,0);
+      v = lookupVar(tree->name);
+      if (v->isArray) return lowerBase(v,tree->name);
+      i = gen(v->isGlobal ? irLOADG : irLOADL,irNewReg(curFunc),0,0,
+              v->offset);
+      i->name = tree->name;
+      return i->dst;
+    case AssignExpr :
+      if (tree->child[0]->child[0] != NULL)
+      { addr = lowerElement(tree->child[0]);
+        value = lowerExp(tree->child[1]);
+        gen(irSTORE,0,addr,value,0);
+      }
+      else
+      { v = lookupVar(tree->child[0]->name);
+        value = lowerExp(tree->child[1]);
+        i = gen(v->isGlobal ? irSTOREG : irSTOREL,0,value,0,v->offset);
+        i->name = tree->child[0]->name;
+      }
+      return value;
+    case Call :
+      return lowerCall(tree);
+    case OpExpr :
+    { int left = lowerExp(tree->child[0]);
+      int right = lowerExp(tree->child[1]);
+      IROP op;
+      switch (tree->op)
+      { case PLUS : op = irADD; break;
+        case MINUS : op = irSUB; break;
+        case MUL : op = irMUL; break;
+        case DIV : op = irDIV; break;
+        case LESSTHAN : op = irLT; break;
+        case LESSEQUAL : op = irLE; break;
+        case GREATTHAN : op = irGT; break;
+        case GREATEQUAL : op = irGE; break;
+        case EQ : op = irEQ; break;
+        case NEQ : op = irNE; break;
+        default :
+          fprintf(listing,"BUG: unknown operator at line %d\n",
+                  tree->lineno);
+          Error = TRUE;
+          op = irADD;
+          break;
+      }
+      return genValue(op,left,right,0);
+    }
+    default :
+      return 0;
+  }
+} /* lowerExp */
+
+/* Procedure lowerCompound lowers a compound
+ * statement, allocating its local variables
+ */
+static void lowerCompound( TreeNode * tree )
+{ TreeNode * p;
+  int savedVars = nVars;
+  int savedOffset = localOffset;
+  for (p = tree->child[0]; p != NULL; p = p->sibling)
+  { localOffset -= varSize(p);
+    if (localOffset < lowOffset) lowOffset = localOffset;
+    addVar(p->name,FALSE,localOffset+1,p->isArray,FALSE);
+    if (p->isArray)
+      addArray(&curFunc->arrays,p->name,localOffset+1,varSize(p));
+  }
+  lowerStmts(tree->child[1]);
+  nVars = savedVars;
+  localOffset = savedOffset;
+} /* lowerCompound */
+
+/* Procedure lowerStmt lowers a statement */
+static void lowerStmt( TreeNode * tree )
+{ BLOCK * body, * other, * join;
+  int c;
+  if (tree->exprKind != CmpdStmt) curLine = stmtLine(tree);
+  switch (tree->exprKind)
+  { case IfStmt :
+    case IfElseStmt :
+      c = lowerExp(tree->child[0]);
+      body = newBlock();
+      join = newBlock();
+      other = (tree->exprKind == IfElseStmt) ? newBlock() : join;
+      genBranch(c,body,other);
+      enterBlock(body);
+      lowerStmts(tree->child[1]);
+      genJump(join);
+      if (tree->exprKind == IfElseStmt)
+      { enterBlock(other);
+        lowerStmts(tree->child[2]);
+        genJump(join);
+      }
+      enterBlock(join);
+      break;
+    case WhileStmt :
+      other = newBlock(); /* the test */
+      body = newBlock();
+      join = newBlock();
+      genJump(other);
+      enterBlock(other);
+      c = lowerExp(tree->child[0]);
+      genBranch(c,body,join);
+      enterBlock(body);
+      lowerStmts(tree->child[1]);
+      curLine = stmtLine(tree);
+      genJump(other);
+      enterBlock(join);
+      break;
+    case ReturnStmt :
+      c = (tree->child[0] != NULL) ? lowerExp(tree->child[0]) : 0;
+      gen(irRET,0,c,0,0);
+      /* what follows is unreachable */
+      enterBlock(newBlock());
+      break;
+    case CmpdStmt :
+      lowerCompound(tree);
+      break;
+    default :
+      /* expression statement */
+      lowerExp(tree);
+      break;
+  }
+} /* lowerStmt */
+
+/* Procedure lowerStmts lowers a statement list */
+static void lowerStmts( TreeNode * tree )
+{ while (tree != NULL)
+  { lowerStmt(tree);
+    tree = tree->sibling;
+  }
+} /* lowerStmts */
+
+/* Procedure lowerFunction lowers a function
+ * declaration into curFunc
+ */
+static void lowerFunction( TreeNode * tree )
+{ TreeNode * p;
+  curFunc->name = tree->name;
+  curFunc->lineno = tree->lineno;
+  curFunc->endLine = tree->child[1]->lineno;
+  curFunc->isVoid = (tree->type == Void);
+  curFunc->nregs = 1;
+  for (p = tree->child[0]; p != NULL; p = p->sibling)
+    if (p->exprKind == Param)
+    { addVar(p->name,FALSE,ofsParams-curFunc->nparams,p->isArray,p->isArray);
+      curFunc->nparams++;
+    }
+  localOffset = lowOffset = ofsParams - curFunc->nparams;
+  lastBlock = NULL;
+  curLine = tree->lineno;
+  enterBlock(newBlock());
+  lowerCompound(tree->child[1]);
+  /* return at the closing brace */
+  curLine = curFunc->endLine;
+  gen(irRET,0,0,0,0);
+  curFunc->frameSize = -lowOffset;
+  nVars -= curFunc->nparams;
+  irBuildCFG(curFunc);
+} /* lowerFunction */
+
+/* Function irLower lowers the analyzed syntax
+ * tree into an IR program
+ */
+IRPROGRAM * irLower( TreeNode * syntaxTree )
+{ TreeNode * t;
+  IRFUNC * f, * g, ** tail;
+  BLOCK * b;
+  IRINST * i;
+  irProg = (IRPROGRAM *) calloc(1,sizeof(IRPROGRAM));
+  declList = syntaxTree;
+  nVars = 0;
+  /* allocate the global variables */
+  for (t = syntaxTree; t != NULL; t = t->sibling)
+    if (t->exprKind == VarDe)
+    { addVar(t->name,TRUE,irProg->globalSize,t->isArray,FALSE);
+      if (t->isArray)
+        addArray(&irProg->arrays,t->name,irProg->globalSize,varSize(t));
+      irProg->globalSize += varSize(t);
+    }
+  tail = &irProg->funcs;
+  for (t = syntaxTree; t != NULL; t = t->sibling)
+    if (t->exprKind == FunDe)
+    { curFunc = (IRFUNC *) calloc(1,sizeof(IRFUNC));
+      curFunc->id = irProg->nfuncs++;
+      lowerFunction(t);
+      *tail = curFunc;
+      tail = &curFunc->next;
+    }
+  /* resolve the calls */
+  for (f = irProg->funcs; f != NULL; f = f->next)
+    for (b = f->entry; b != NULL; b = b->next)
+      for (i = b->first; i != NULL; i = i->next)
+        if (i->op == irCALL)
+        { for (g = irProg->funcs; g != NULL; g = g->next)
+            if (strcmp(g->name,i->name) == 0) break;
+          if (g == NULL)
+          { fprintf(listing,"BUG: no function %s\n",i->name);
+            Error = TRUE;
+          }
+          i->callee = g;
+        }
+  for (f = irProg->funcs; f != NULL; f = f->next)
+    if (strcmp(f->name,"main") == 0) break;
+  if (f == NULL)
+  { fprintf(listing,"Error: no function main\n");
+    Error = TRUE;
+  }
+  return irProg;
+} /* irLower */
+
+/********************************************/
+/*               D U M P                    */
+/********************************************/
+
+/* Procedure irFormatInst writes instruction i
+ * as text into buf of size n
+ */
+void irFormatInst( char * buf, int n, IRINST * i )
+{ int len = 0, j;
+  buf[0] = '\0';
+  if (i->dst != 0)
+    len += snprintf(buf+len,n-len,"r%d = ",i->dst);
+  if (len >= n) return;
+  len += snprintf(buf+len,n-len,"%s",irOpTab[i->op]);
+  if (len >= n) return;
+  switch (i->op)
+  { case irCONST :
+    case irLOADL :
+    case irLOADG :
+    case irADDRL :
+    case irADDRG :
+      len += snprintf(buf+len,n-len," %d",i->k);
+      break;
+    case irSTOREL :
+    case irSTOREG :
+      len += snprintf(buf+len,n-len," %d, r%d",i->k,i->a);
+      break;
+    case irCALL :
+      len += snprintf(buf+len,n-len," %s(",i->name);
+      for (j = 0; (j < i->nargs) && (len < n); j++)
+        len += snprintf(buf+len,n-len,"%sr%d",j ? ", " : "",i->args[j]);
+      if (len < n) len += snprintf(buf+len,n-len,")");
+      break;
+    case irJUMP :
+      len += snprintf(buf+len,n-len," B%d",i->block->succ[0]->id);
+      break;
+    case irBRANCH :
+      len += snprintf(buf+len,n-len," r%d, B%d, B%d",i->a,
+                      i->block->succ[0]->id,i->block->succ[1]->id);
+      break;
+    case irPHI :
+      for (j = 0; (j < i->nargs) && (len < n); j++)
+        len += snprintf(buf+len,n-len," [r%d, B%d]",i->args[j],
+                        i->from[j]->id);
+      break;
+    default :
+      for (j = 0; (j < irNumUses(i)) && (len < n); j++)
+        len += snprintf(buf+len,n-len,"%sr%d",j ? ", " : " ",
+                        *irUse(i,j));
+      break;
+  }
+  if ((len < n) && (i->name != NULL) && (i->op != irCALL))
+    snprintf(buf+len,n-len,"\t%s",i->name);
+} /* irFormatInst */
+
+/* Procedure dumpFunction prints the IR of f */
+static void dumpFunction( FILE * f, IRFUNC * func )
+{ BLOCK * b;
+  IRINST * i;
+  IRARRAY * a;
+  char buf[256];
+  int j;
+  fprintf(f,"\nfunction %s: %d params, frame %d, %d registers\n",
+          func->name,func->nparams,func->frameSize,func->nregs-1);
+  for (a = func->arrays; a != NULL; a = a->next)
+    fprintf(f,"  array %s[%d] at fp%+d\n",a->name,a->size,a->offset);
+  for (b = func->entry; b != NULL; b = b->next)
+  { fprintf(f,"B%d:",b->id);
+    if (b->npred > 0)
+    { fprintf(f,"\t\tpreds");
+      for (j = 0; j < b->npred; j++) fprintf(f," B%d",b->pred[j]->id);
+    }
+    fprintf(f,"\n");
+    for (i = b->first; i != NULL; i = i->next)
+    { irFormatInst(buf,sizeof(buf),i);
+      fprintf(f,"\t%s\n",buf);
+    }
+  }
+} /* dumpFunction */
+
+/* Procedure irDump prints the IR of prog to f */
+void irDump( FILE * f, IRPROGRAM * prog )
+{ IRFUNC * func;
+  IRARRAY * a;
+  fprintf(f,"\nIR: %d words of globals\n",prog->globalSize);
+  for (a = prog->arrays; a != NULL; a = a->next)
+    fprintf(f,"  array %s[%d] at gp+%d\n",a->name,a->size,a->offset);
+  for (func = prog->funcs; func != NULL; func = func->next)
+    dumpFunction(f,func);
+} /* irDump */
@@ -0,0 +1,204 @@
+/****************************************************/
+/* File: ir.h                                       */
+/* The three-address intermediate representation    */
+/* of the C-Minus compiler                          */
+/* (instructions, basic blocks and functions)       */
+/****************************************************/
+
+#ifndef _IR_H_
+#define _IR_H_
+
+/* A program is lowered from the analyzed syntax
+ * tree into one IR function per declaration. The
+ * instructions of a function compute into virtual
+ * registers r1, r2, ...; register 0 stands for
+ * "none". Variables stay in memory, laid out as
+ * by cgen.c: locals and parameters at an offset
+ * from fp, globals at an offset from gp. The
+ * instructions are grouped into basic blocks,
+ * each ended by exactly one jump, branch or
+ * return, which form the control-flow graph
+ */
+
+typedef enum {
+   irCONST,   /* d = k */
+   irCOPY,    /* d = a */
+   irADD,     /* d = a+b */
+   irSUB,     /* d = a-b */
+   irMUL,     /* d = a*b */
+   irDIV,     /* d = a/b */
+   irLT,      /* d = 1 if a-b < 0, else 0 */
+   irLE,      /* d = 1 if a-b <= 0, else 0 */
+   irGT,      /* d = 1 if a-b > 0, else 0 */
+   irGE,      /* d = 1 if a-b >= 0, else 0 */
+   irEQ,      /* d = 1 if a-b == 0, else 0 */
+   irNE,      /* d = 1 if a-b != 0, else 0 */
+   irLOADL,   /* d = mem(fp+k) */
+   irSTOREL,  /* mem(fp+k) = a */
+   irLOADG,   /* d = mem(gp+k) */
+   irSTOREG,  /* mem(gp+k) = a */
+   irADDRL,   /* d = fp+k */
+   irADDRG,   /* d = gp+k */
+   irLOAD,    /* d = mem(a) */
+   irSTORE,   /* mem(a) = b */
+   irIN,      /* d = input() */
+   irOUT,     /* output(a) */
+   irCALL,    /* d = name(args), d is 0 for void */
+   irRET,     /* return a, a is 0 for none */
+   irJUMP,    /* goto succ[0] */
+   irBRANCH,  /* if a != 0 goto succ[0] else succ[1] */
+   irPHI      /* d = args[n] when entered from from[n] (SSA) */
+   } IROP;
+
+/* the names of the IR operations */
+extern char * irOpTab[];
+
+struct Block;
+struct IrFunc;
+
+typedef struct IrInst
+   { IROP op;
+     int dst;                  /* register defined, 0 if none */
+     int a, b;                 /* operand registers */
+     int k;                    /* constant or offset */
+     int nargs;
+     int * args;               /* registers of the call arguments */
+     struct Block ** from;     /* PHI: predecessor of each argument */
+     char * name;              /* function called, or variable */
+     struct IrFunc * callee;   /* NULL for input and output */
+     int lineno;               /* source line */
+     struct Block * block;
+     struct IrInst * prev, * next;
+   } IRINST;
+
+typedef struct Block
+   { int id;                   /* position in the layout */
+     IRINST * first, * last;   /* last is JUMP, BRANCH or RET */
+     struct Block * succ[2];   /* targets of the last instruction */
+     int nsucc;
+     struct Block ** pred;
+     int npred;
+     struct Block * next;      /* in the layout */
+     /* the dominator tree, built by findDominators */
+     struct Block * idom;      /* immediate dominator, NULL: entry */
+     struct Block * child;     /* first block it immediately dominates */
+     struct Block * sibling;   /* next child of idom */
+     int rpo;                  /* reverse postorder number */
+     int fewTrips;             /* heads a loop left by unrolling */
+   } BLOCK;
+
+/* the arrays, for the "*@array" marks of the code */
+typedef struct IrArray
+   { char * name;
+     int offset;               /* of element 0 */
+     int size;
+     struct IrArray * next;
+   } IRARRAY;
+
+typedef struct IrFunc
+   { char * name;
+     int id;                   /* position in the program */
+     int lineno;               /* of the declaration */
+     int endLine;              /* of the closing brace */
+     int nparams;
+     int isVoid;
+     int frameSize;            /* words of parameters and locals */
+     int nregs;                /* registers are 1..nregs-1 */
+     BLOCK * entry;            /* first block of the layout */
+     int nblocks;
+     IRARRAY * arrays;         /* local arrays, from fp */
+     struct IrFunc * next;
+   } IRFUNC;
+
+typedef struct
+   { IRFUNC * funcs;
+     int nfuncs;
+     int globalSize;           /* words of global variables */
+     IRARRAY * arrays;         /* global arrays, from gp */
+   } IRPROGRAM;
+
+/* Function irLower lowers the analyzed syntax
+ * tree into an IR program
+ */
+IRPROGRAM * irLower( TreeNode * syntaxTree );
+
+/* Function irNewReg returns a fresh register of f */
+int irNewReg( IRFUNC * f );
+
+/* Function irNewInst returns a new instruction
+ * that belongs to no block
+ */
+IRINST * irNewInst( IROP op, int dst, int a, int b, int k );
+
+/* Function irNewBlock returns an empty block of
+ * f, not yet in its layout
+ */
+BLOCK * irNewBlock( IRFUNC * f );
+
+/* Procedure irAppend appends i to block b;
+ * irInsertBefore inserts i before at, in its
+ * block; irRemove unlinks i from its block
+ */
+void irAppend( BLOCK * b, IRINST * i );
+void irInsertBefore( IRINST * at, IRINST * i );
+void irRemove( IRINST * i );
+
+/* Procedure irFreeInst frees i, which belongs to
+ * no block, with its PHI arguments
+ */
+void irFreeInst( IRINST * i );
+
+/* Function irNumUses returns the number of
+ * operand registers of i; irUse returns the
+ * address of operand n, so that it may be
+ * replaced
+ */
+int irNumUses( IRINST * i );
+int * irUse( IRINST * i, int n );
+
+/* Function irIsTerminator returns nonzero for the
+ * operations that end a block
+ */
+int irIsTerminator( IROP op );
+
+/* Function irFold computes d = a op b for the
+ * arithmetic and compare operations, returning
+ * 0 for a division by zero. It defines the
+ * values the TM computes: sums wrap around, and
+ * a compare tests the wrapped difference a-b
+ */
+int irFold( IROP op, int a, int b, int * d );
+
+/* Procedure irBuildCFG recomputes the predecessors
+ * of the blocks of f from the successors their
+ * last instructions have, deletes the blocks that
+ * cannot be reached from the entry and numbers
+ * the others in layout order. The arguments of a
+ * PHI whose edge is gone are dropped
+ */
+void irBuildCFG( IRFUNC * f );
+
+/* Procedure irCheckPhis exits with an error if a
+ * PHI of f follows another instruction of its
+ * block or has an argument from a block that is
+ * not among the predecessors of its block
+ */
+void irCheckPhis( IRFUNC * f );
+
+/* Procedure irSimplifyCFG simplifies the control
+ * flow of f, which has no PHIs: jumps to a block
+ * that only jumps go to its target instead, and
+ * a block is merged into its predecessor if each
+ * is the only neighbour of the other
+ */
+void irSimplifyCFG( IRFUNC * f );
+
+/* Procedure irFormatInst writes instruction i
+ * as text into buf of size n
+ */
+void irFormatInst( char * buf, int n, IRINST * i );
+
+/* Procedure irDump prints the IR of prog to f */
+void irDump( FILE * f, IRPROGRAM * prog );
+
+#endif
@@ -0,0 +1,446 @@
+/****************************************************/
+/* File: irgen.c                                    */
+/* The TM code generator for the IR of the C-Minus  */
+/* compiler                                         */
+/* (frames, registers and calls on the TM)          */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "irgen.h"
+
+/* Run-time organization
+ *
+ * As in cgen.c, except that there are no
+ * temporaries below the frame. The virtual
+ * registers of a function are held in the TM
+ * registers that regalloc.c gives them, or in
+ * its frame, below its parameters and locals:
+ *
+ *               parameters and locals
+ *               callee-saved registers used
+ *               the word of a borrowed register
+ *               the spill area
+ *
+ * mp points below the whole frame, where the
+ * frame of a callee starts. ac is the scratch
+ * register of the instructions
+ */
+
+/* the function being generated, the allocation
+ * of its registers, the number of callee-saved
+ * registers it saves and the words of its frame
+ */
+static IRFUNC * curFunc;
+static REGALLOC * curAlloc;
+static int nSaved;
+static int frameWords;
+
+/* the number of the instruction being generated,
+ * in the layout order of regalloc.c
+ */
+static int instNo;
+
+/* the location of each block of the function
+ * (-1 until it is generated) and of each
+ * function, and the jumps to be backpatched
+ * with them
+ */
+static int * blockLoc;
+static int * funcLoc;
+
+typedef struct PatchRec
+   { char * op;
+     int r;
+     int loc;
+     BLOCK * block;            /* NULL: jumps to func */
+     IRFUNC * func;
+     struct PatchRec * next;
+   } PatchRec;
+
+static PatchRec * blockPatches = NULL;
+static PatchRec * funcPatches = NULL;
+
+/* Function frameWord returns the offset from fp
+ * of word n of the frame after the parameters
+ * and locals
+ */
+static int frameWord( int n )
+{ return -curFunc->frameSize - n;
+} /* frameWord */
+
+/* Function spillWord returns the offset from fp
+ * of the word of the spilled virtual register n
+ */
+static int spillWord( int n )
+{ return frameWord(nSaved + 1 + curAlloc->spill[n]);
+} /* spillWord */
+
+/* Function useReg returns the TM register that
+ * holds virtual register n, loading it into
+ * scratch if it is spilled
+ */
+static int useReg( int n, int scratch )
+{ if (curAlloc->reg[n] != NOREG) return curAlloc->reg[n];
+  emitRM("LD",scratch,spillWord(n),fp,"load spilled register");
+  return scratch;
+} /* useReg */
+
+/* Function defReg returns the TM register to
+ * compute virtual register n into: its own, or
+ * ac if it is spilled, for storeDef to store
+ */
+static int defReg( int n )
+{ return (curAlloc->reg[n] != NOREG) ? curAlloc->reg[n] : ac;
+} /* defReg */
+
+/* Procedure storeDef stores TM register r into
+ * virtual register n if it is spilled
+ */
+static void storeDef( int n, int r )
+{ if (curAlloc->reg[n] == NOREG)
+    emitRM("ST",r,spillWord(n),fp,"store spilled register");
+} /* storeDef */
+
+/* Procedure moveReg copies TM register from into
+ * register to
+ */
+static void moveReg( int to, int from )
+{ if (to != from) emitRM("LDA",to,0,from,"move register");
+} /* moveReg */
+
+/* the register saved in the word of a borrowed
+ * register, NOREG if none
+ */
+static int borrowed = NOREG;
+
+/* Procedure useOperands puts the virtual
+ * registers a and b into TM registers *ra and
+ * *rb. spare is a register the instruction
+ * changes, NOREG if none but ac: then if a and b
+ * are both spilled, a register that holds no
+ * value across the instruction is used, or else
+ * one is borrowed until releaseBorrowed gives
+ * it back
+ */
+static void useOperands( int a, int b, int spare, int * ra, int * rb )
+{ *ra = useReg(a,ac);
+  if ((curAlloc->reg[a] != NOREG) || (curAlloc->reg[b] != NOREG) || (a == b))
+  { *rb = (a == b) ? *ra : useReg(b,ac);
+    return;
+  }
+  if (spare == NOREG)
+  { for (spare = FIRSTREG; spare <= LASTREG; spare++)
+      if (! (curAlloc->busy[instNo] & (1 << spare))) break;
+    if (spare > LASTREG)
+    { spare = borrowed = FIRSTREG;
+      emitRM("ST",spare,frameWord(nSaved),fp,"borrow register");
+    }
+  }
+  *rb = useReg(b,spare);
+} /* useOperands */
+
+/* Procedure releaseBorrowed gives back the
+ * register borrowed by useOperands
+ */
+static void releaseBorrowed( void )
+{ if (borrowed == NOREG) return;
+  emitRM("LD",borrowed,frameWord(nSaved),fp,"give back register");
+  borrowed = NOREG;
+} /* releaseBorrowed */
+
+/* Procedure addPatch skips a location for a jump
+ * to block or func
+ */
+static void addPatch( PatchRec ** list, char * op, int r,
+                      BLOCK * block, IRFUNC * func )
+{ PatchRec * p = (PatchRec *) malloc(sizeof(PatchRec));
+  p->op = op;
+  p->r = r;
+  p->loc = emitSkip(1);
+  p->block = block;
+  p->func = func;
+  p->next = *list;
+  *list = p;
+} /* addPatch */
+
+/* Procedure applyPatches backpatches the jumps of
+ * list and frees it
+ */
+static void applyPatches( PatchRec ** list )
+{ PatchRec * p, * next;
+  int loc;
+  for (p = *list; p != NULL; p = next)
+  { next = p->next;
+    loc = (p->block != NULL) ? blockLoc[p->block->id] : funcLoc[p->func->id];
+    emitBackup(p->loc);
+    emitRM_Abs(p->op,p->r,loc,"jump");
+    free(p);
+  }
+  emitRestore();
+  *list = NULL;
+} /* applyPatches */
+
+/* Procedure genJump generates op r to block b */
+static void genJump( char * op, int r, BLOCK * b )
+{ if (blockLoc[b->id] >= 0) emitRM_Abs(op,r,blockLoc[b->id],"jump");
+  else addPatch(&blockPatches,op,r,b,NULL);
+} /* genJump */
+
+/* Procedure genCall generates code at a call */
+static void genCall( IRINST * i )
+{ int j;
+  for (j = 0; j < i->nargs; j++)
+    emitRM("ST",useReg(i->args[j],ac),ofsParams-j,mp,"call: store argument");
+  emitRM("ST",fp,ofsOldFp,mp,"call: store fp");
+  emitRM("LDA",fp,0,mp,"call: push frame");
+  emitRM("LDA",ac,2,pc,"call: compute return address");
+  emitRM("ST",ac,ofsRetAddr,fp,"call: store return address");
+  emitCall(emitSkip(0));
+  if (funcLoc[i->callee->id] >= 0)
+    emitRM_Abs("LDA",pc,funcLoc[i->callee->id],"call: jump to function");
+  else
+    addPatch(&funcPatches,"LDA",pc,NULL,i->callee);
+  emitRM("LDA",mp,-frameWords,fp,"call: restore mp");
+  if (i->dst != 0)
+  { moveReg(defReg(i->dst),ac);
+    storeDef(i->dst,ac);
+  }
+} /* genCall */
+
+/* the jumps taken if a compare is true, and if it
+ * is false, by the sign of the difference
+ */
+static char * jumpIfTrue[] = { "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE" };
+static char * jumpIfFalse[] = { "JGE", "JGT", "JLE", "JLT", "JNE", "JEQ" };
+
+/* Procedure genCompare generates d = a op b for
+ * a compare, unless the branch ending its block
+ * computes it, jumping on the difference of the
+ * operands
+ */
+static void genCompare( IRINST * i )
+{ int r = defReg(i->dst), a, b;
+  if (curAlloc->tested[i->block->id] == i) return;
+  useOperands(i->a,i->b,(r != ac) ? r : NOREG,&a,&b);
+  emitRO("SUB",r,a,b,"op compare");
+  emitRM(jumpIfTrue[i->op - irLT],r,2,pc,"br if true");
+  emitRM("LDC",r,0,r,"false case");
+  emitRM("LDA",pc,1,pc,"unconditional jmp");
+  emitRM("LDC",r,1,r,"true case");
+  releaseBorrowed();
+  storeDef(i->dst,r);
+} /* genCompare */
+
+/* Procedure genInst generates code at an IR
+ * instruction
+ */
+static void genInst( IRINST * i )
+{ static char * arith[] = { "ADD", "SUB", "MUL", "DIV" };
+  BLOCK * next = i->block->next;
+  char * ifTrue, * ifFalse;
+  IRINST * c;
+  char buf[256];
+  int r, a, b, n;
+  emitLine(i->lineno);
+  if (TraceCode)
+  { irFormatInst(buf,sizeof(buf),i);
+    emitComment(buf);
+  }
+  switch (i->op)
+  { case irCONST :
+      r = defReg(i->dst);
+      emitRM("LDC",r,i->k,0,"load const");
+      storeDef(i->dst,r);
+      break;
+    case irCOPY :
+      r = defReg(i->dst);
+      moveReg(r,useReg(i->a,r));
+      storeDef(i->dst,r);
+      break;
+    case irADD :
+    case irSUB :
+    case irMUL :
+    case irDIV :
+      r = defReg(i->dst);
+      useOperands(i->a,i->b,(r != ac) ? r : NOREG,&a,&b);
+      emitRO(arith[i->op - irADD],r,a,b,"op");
+      releaseBorrowed();
+      storeDef(i->dst,r);
+      break;
+    case irLT :
+    case irLE :
+    case irGT :
+    case irGE :
+    case irEQ :
+    case irNE :
+      genCompare(i);
+      break;
+    case irLOADL :
+    case irLOADG :
+      r = defReg(i->dst);
+      emitRM("LD",r,i->k,(i->op == irLOADL) ? fp : gp,"load id value");
+      storeDef(i->dst,r);
+      break;
+    case irSTOREL :
+    case irSTOREG :
+      a = useReg(i->a,ac);
+      emitRM("ST",a,i->k,(i->op == irSTOREL) ? fp : gp,"store id value");
+      break;
+    case irADDRL :
+    case irADDRG :
+      r = defReg(i->dst);
+      emitRM("LDA",r,i->k,(i->op == irADDRL) ? fp : gp,"load address");
+      storeDef(i->dst,r);
+      break;
+    case irLOAD :
+      a = useReg(i->a,ac);
+      r = defReg(i->dst);
+      emitRM("LD",r,0,a,"load element value");
+      storeDef(i->dst,r);
+      break;
+    case irSTORE :
+      useOperands(i->a,i->b,NOREG,&a,&b);
+      emitRM("ST",b,0,a,"store element value");
+      releaseBorrowed();
+      break;
+    case irIN :
+      r = defReg(i->dst);
+      emitRO("IN",r,0,0,"input integer value");
+      storeDef(i->dst,r);
+      break;
+    case irOUT :
+      emitRO("OUT",useReg(i->a,ac),0,0,"output register");
+      break;
+    case irCALL :
+      genCall(i);
+      break;
+    case irRET :
+      if (i->a != 0) moveReg(ac,useReg(i->a,ac));
+      for (r = FIRSTSAVED, n = 0; r <= LASTREG; r++)
+        if (curAlloc->saved[r])
+          emitRM("LD",r,frameWord(n++),fp,"return: restore register");
+      emitRM("LD",ac1,ofsRetAddr,fp,"return: load return address");
+      emitRM("LD",fp,ofsOldFp,fp,"return: pop frame");
+      emitReturn();
+      emitRM("LDA",pc,0,ac1,"return: jump to caller");
+      break;
+    case irJUMP :
+      if (i->block->succ[0] != next) genJump("LDA",pc,i->block->succ[0]);
+      break;
+    case irBRANCH :
+      ifTrue = "JNE";
+      ifFalse = "JEQ";
+      if ((c = curAlloc->tested[i->block->id]) != NULL)
+      { useOperands(c->a,c->b,NOREG,&a,&b);
+        emitRO("SUB",ac,a,b,"op compare");
+        releaseBorrowed();
+        ifTrue = jumpIfTrue[c->op - irLT];
+        ifFalse = jumpIfFalse[c->op - irLT];
+        r = ac;
+      }
+      else r = useReg(i->a,ac);
+      if (i->block->succ[1] == next)
+        genJump(ifTrue,r,i->block->succ[0]);
+      else if (i->block->succ[0] == next)
+        genJump(ifFalse,r,i->block->succ[1]);
+      else
+      { genJump(ifTrue,r,i->block->succ[0]);
+        genJump("LDA",pc,i->block->succ[1]);
+      }
+      break;
+    case irPHI :
+      emitComment("BUG: PHI left in the IR");
+      break;
+  }
+} /* genInst */
+
+/* Procedure genFunction generates the code of an
+ * IR function
+ */
+static void genFunction( IRFUNC * f )
+{ BLOCK * b;
+  IRINST * i;
+  IRARRAY * a;
+  int n, r;
+  curFunc = f;
+  curAlloc = allocRegisters(f);
+  nSaved = 0;
+  for (r = FIRSTSAVED; r <= LASTREG; r++)
+    if (curAlloc->saved[r]) nSaved++;
+  frameWords = f->frameSize + nSaved;
+  if (curAlloc->nspills > 0) frameWords += 1 + curAlloc->nspills;
+  if (TraceOpt)
+    fprintf(listing,"%s: %d live intervals, %d spilled to %d words, "
+            "%d callee-saved registers\n",f->name,curAlloc->nintervals,
+            curAlloc->nspilled,curAlloc->nspills,nSaved);
+  blockLoc = (int *) malloc((f->nblocks+1)*sizeof(int));
+  for (n = 0; n < f->nblocks; n++) blockLoc[n] = -1;
+  funcLoc[f->id] = emitSkip(0);
+  emitFunction(f->name);
+  for (a = f->arrays; a != NULL; a = a->next)
+    emitArray(a->name,FALSE,a->offset,a->size);
+  emitLine(f->lineno);
+  emitRM("LDA",mp,-frameWords,fp,"entry: point mp below frame");
+  for (r = FIRSTSAVED, n = 0; r <= LASTREG; r++)
+    if (curAlloc->saved[r])
+      emitRM("ST",r,frameWord(n++),fp,"entry: save register");
+  instNo = 0;
+  for (b = f->entry; b != NULL; b = b->next)
+  { blockLoc[b->id] = emitSkip(0);
+    for (i = b->first; i != NULL; i = i->next, instNo++) genInst(i);
+  }
+  applyPatches(&blockPatches);
+  free(blockLoc);
+  freeRegAlloc(curAlloc);
+} /* genFunction */
+
+/**********************************************/
+/* the primary function of the code generator */
+/**********************************************/
+/* Procedure irCodeGen generates code for the IR
+ * program prog
+ */
+void irCodeGen( IRPROGRAM * prog, char * codefile, char * srcfile )
+{  char * s = malloc(strlen(codefile)+7);
+   IRFUNC * f;
+   IRARRAY * a;
+   int n;
+   strcpy(s,"File: ");
+   strcat(s,codefile);
+   emitComment("C-Minus Compilation to TM Code");
+   emitComment(s);
+   emitFile(srcfile);
+   for (a = prog->arrays; a != NULL; a = a->next)
+     emitArray(a->name,TRUE,a->offset,a->size);
+   funcLoc = (int *) malloc((prog->nfuncs+1)*sizeof(int));
+   for (n = 0; n < prog->nfuncs; n++) funcLoc[n] = -1;
+   for (f = prog->funcs; f != NULL; f = f->next)
+     if (strcmp(f->name,"main") == 0) break;
+   if (f == NULL)
+   { fprintf(listing,"Error: no function main\n");
+     Error = TRUE;
+     return;
+   }
+   /* generate standard prelude */
+   emitComment("Standard prelude:");
+   emitLine(0);
+   emitRM("LD",mp,0,ac,"load maxaddress from location 0");
+   emitRM("ST",ac,0,ac,"clear location 0");
+   emitRM("LDA",fp,0,mp,"frame of main at top of memory");
+   emitComment("End of standard prelude.");
+   /* call main; its entry is backpatched */
+   emitRM("ST",fp,ofsOldFp,mp,"call: store fp");
+   emitRM("LDA",ac,2,pc,"call: compute return address");
+   emitRM("ST",ac,ofsRetAddr,fp,"call: store return address");
+   emitCall(emitSkip(0));
+   addPatch(&funcPatches,"LDA",pc,NULL,f);
+   emitComment("End of execution.");
+   emitRO("HALT",0,0,0,"");
+   for (f = prog->funcs; f != NULL; f = f->next) genFunction(f);
+   applyPatches(&funcPatches);
+   free(funcLoc);
+   free(s);
+}
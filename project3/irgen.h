@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: irgen.h                                    */
+/* The TM code generator for the IR of the C-Minus  */
+/* compiler                                         */
+/* (frames, registers and calls on the TM)          */
+/****************************************************/
+
+#ifndef _IRGEN_H_
+#define _IRGEN_H_
+
+/* Procedure irCodeGen generates code for the IR
+ * program prog, as codeGen does for the syntax
+ * tree: to the code file, whose name is codefile,
+ * and to the program of emitProgram
+ */
+void irCodeGen( IRPROGRAM * prog, char * codefile, char * srcfile );
+
+#endif
@@ -0,0 +1,205 @@
+/****************************************************/
+/* File: irinterp.c                                 */
+/* The IR interpreter of the C-Minus compiler       */
+/* (runs the IR without generating TM code)         */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "ir.h"
+#include "irinterp.h"
+
+/* An activation of a function holds its virtual
+ * registers; its frame is in the data memory at
+ * the place the TM code would put it, below the
+ * frame of the caller
+ */
+typedef struct Activation
+   { IRFUNC * func;
+     IRINST * inst;            /* next to execute */
+     IRINST * call;            /* call in the caller */
+     int * regs;
+     int frame;                /* its fp */
+     struct Activation * caller;
+   } ACTIVATION;
+
+static int * dMem;
+static int dSize;
+
+/* Function valid returns nonzero if a is a data
+ * address
+ */
+static int valid( int a )
+{ return (a >= 0) && (a < dSize);
+} /* valid */
+
+/* Function newActivation returns an activation of
+ * f whose frame is at location frame, storing
+ * the fp of the caller into it; NULL if that is
+ * outside the memory
+ */
+static ACTIVATION * newActivation( IRFUNC * f, int frame, int callerFp )
+{ ACTIVATION * act;
+  if (! valid(frame + ofsOldFp)) return NULL;
+  dMem[frame + ofsOldFp] = callerFp;
+  act = (ACTIVATION *) malloc(sizeof(ACTIVATION));
+  act->func = f;
+  act->inst = f->entry->first;
+  act->call = NULL;
+  act->regs = (int *) calloc(f->nregs,sizeof(int));
+  act->frame = frame;
+  act->caller = NULL;
+  return act;
+} /* newActivation */
+
+/* Function popActivation frees act and returns
+ * its caller
+ */
+static ACTIVATION * popActivation( ACTIVATION * act )
+{ ACTIVATION * caller = act->caller;
+  free(act->regs);
+  free(act);
+  return caller;
+} /* popActivation */
+
+/* Function enterBlock moves act from block from
+ * to block b and returns the first instruction
+ * to execute there. The PHIs at the head of b
+ * take their values together, as the values of
+ * their arguments on the edge from from
+ */
+static IRINST * enterBlock( ACTIVATION * act, BLOCK * b, BLOCK * from )
+{ static int * phiVal = NULL;
+  static int phiSize = 0;
+  IRINST * i;
+  int n = 0, m;
+  for (i = b->first; i->op == irPHI; i = i->next)
+  { if (n == phiSize)
+    { phiSize = 2*phiSize + 8;
+      phiVal = (int *) realloc(phiVal,phiSize*sizeof(int));
+    }
+    for (m = 0; m < i->nargs; m++)
+      if (i->from[m] == from) break;
+    phiVal[n++] = (m < i->nargs) ? act->regs[i->args[m]] : 0;
+  }
+  n = 0;
+  for (i = b->first; i->op == irPHI; i = i->next)
+    act->regs[i->dst] = phiVal[n++];
+  return i;
+} /* enterBlock */
+
+/* Function irInterpret executes prog on a data
+ * memory of dSize words laid out as the TM code
+ * lays it out
+ */
+STEPRESULT irInterpret( IRPROGRAM * prog, int size,
+                        TMINPUT input, TMOUTPUT output, void * host,
+                        long limit, long * steps )
+{ ACTIVATION * act, * callee;
+  IRFUNC * f;
+  IRINST * i;
+  STEPRESULT result = srOKAY;
+  int * r, addr, v, j;
+  for (f = prog->funcs; f != NULL; f = f->next)
+    if (strcmp(f->name,"main") == 0) break;
+  if (f == NULL) return srIMEM_ERR;
+  dSize = size;
+  dMem = (int *) calloc(dSize,sizeof(int));
+  *steps = 0;
+  /* the prelude puts the frame of main at the top */
+  act = newActivation(f,dSize-1,dSize-1);
+  while (result == srOKAY)
+  { if (*steps >= limit)
+    { result = srLIMIT;
+      break;
+    }
+    i = act->inst;
+    act->inst = i->next;
+    r = act->regs;
+    (*steps)++;
+    switch (i->op)
+    { case irCONST : r[i->dst] = i->k; break;
+      case irCOPY : r[i->dst] = r[i->a]; break;
+      case irADD :
+      case irSUB :
+      case irMUL :
+      case irDIV :
+      case irLT :
+      case irLE :
+      case irGT :
+      case irGE :
+      case irEQ :
+      case irNE :
+        if (! irFold(i->op,r[i->a],r[i->b],&r[i->dst]))
+          result = srZERODIVIDE;
+        break;
+      case irLOADL :
+      case irLOADG :
+      case irLOAD :
+        if (i->op == irLOADL) addr = act->frame + i->k;
+        else if (i->op == irLOADG) addr = i->k;
+        else addr = r[i->a];
+        if (valid(addr)) r[i->dst] = dMem[addr];
+        else result = srDMEM_ERR;
+        break;
+      case irSTOREL :
+      case irSTOREG :
+      case irSTORE :
+        if (i->op == irSTOREL) addr = act->frame + i->k;
+        else if (i->op == irSTOREG) addr = i->k;
+        else addr = r[i->a];
+        v = (i->op == irSTORE) ? r[i->b] : r[i->a];
+        if (valid(addr)) dMem[addr] = v;
+        else result = srDMEM_ERR;
+        break;
+      case irADDRL : r[i->dst] = act->frame + i->k; break;
+      case irADDRG : r[i->dst] = i->k; break;
+      case irIN :
+        if ((input != NULL) && input(host,&v)) r[i->dst] = v;
+        else result = srINPUT_ERR;
+        break;
+      case irOUT :
+        if (output != NULL) output(host,r[i->a]);
+        break;
+      case irCALL :
+        /* the frame of the callee is below that of act */
+        addr = act->frame - act->func->frameSize;
+        for (j = 0; j < i->nargs; j++)
+        { if (! valid(addr + ofsParams - j)) break;
+          dMem[addr + ofsParams - j] = r[i->args[j]];
+        }
+        callee = (j < i->nargs) ? NULL
+                 : newActivation(i->callee,addr,act->frame);
+        if (callee == NULL)
+        { result = srDMEM_ERR;
+          break;
+        }
+        callee->call = i;
+        callee->caller = act;
+        act = callee;
+        break;
+      case irRET :
+        v = (i->a != 0) ? r[i->a] : 0;
+        if (act->caller == NULL)
+        { result = srHALT;
+          break;
+        }
+        if (act->call->dst != 0) act->caller->regs[act->call->dst] = v;
+        act = popActivation(act);
+        break;
+      case irJUMP :
+        act->inst = enterBlock(act,i->block->succ[0],i->block);
+        break;
+      case irBRANCH :
+        act->inst = enterBlock(act,i->block->succ[r[i->a] != 0 ? 0 : 1],
+                               i->block);
+        break;
+      case irPHI :
+        /* only in the entry block, which has none */
+        break;
+    }
+  }
+  while (act != NULL) act = popActivation(act);
+  free(dMem);
+  return result;
+} /* irInterpret */
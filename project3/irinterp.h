@@ -0,0 +1,25 @@
+/****************************************************/
+/* File: irinterp.h                                 */
+/* The IR interpreter of the C-Minus compiler       */
+/* (runs the IR without generating TM code)         */
+/****************************************************/
+
+#ifndef _IRINTERP_H_
+#define _IRINTERP_H_
+
+#include "libtm.h"
+
+/* Function irInterpret executes prog on a data
+ * memory of dSize words laid out as the TM code
+ * lays it out, so that its outputs and faults can
+ * be compared with those of the code. input() and
+ * output() call input and output with host. It
+ * returns srHALT when main returns, a fault, or
+ * srLIMIT when *steps, which counts the IR
+ * instructions executed, reaches limit
+ */
+STEPRESULT irInterpret( IRPROGRAM * prog, int dSize,
+                        TMINPUT input, TMOUTPUT output, void * host,
+                        long limit, long * steps );
+
+#endif
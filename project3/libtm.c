@@ -0,0 +1,936 @@
+/****************************************************/
+/* File: libtm.c                                    */
+/* The TM ("Tiny Machine") library: loads programs  */
+/* and executes them on machines                    */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "libtm.h"
+
+/* the memories are anonymous mappings where mmap exists */
+#if defined(__unix__) || defined(__APPLE__)
+#define MMAP_AVAILABLE 1
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#else
+#define MMAP_AVAILABLE 0
+#endif
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define   LINESIZE  121
+#define   WORDSIZE  20
+
+/* DMEM_FAULT is the data address check of stepTM;
+ * fused instructions must fault exactly where
+ * single stepping would
+ */
+#define   DMEM_FAULT(m) (((m) < 0) || ((m) >= dSize))
+
+/* superinstructions recognized by fuseInstructions;
+ * the comment shows the instruction sequence each
+ * one replaces (x = any register other than the pc)
+ */
+typedef enum {
+   fuNONE,    /* no superinstruction starts here */
+   fuCMP,     /* SUB r,s,t; Jxx r,2(7); LDC r,d0(x);
+                 LDA 7,1(7); LDC r,d1(x) */
+   fuLDST,    /* LD r,d(s); ST r2,e(s2) */
+   fuSTLD,    /* ST r,d(s); LD r2,e(s2) */
+   fuLDCST,   /* LDC r,d(x); ST r2,e(s2) */
+   fuLDOP     /* LD r,d(s); ADD/SUB/MUL r2,s2,t2 */
+   } FUSEKIND;
+
+/* the line of the code file being read by
+ * loadProgram, with the scanner's position
+ */
+typedef struct
+   { char line[LINESIZE];
+     int len;
+     int col;
+     char ch;
+     int num;
+     char word[WORDSIZE];
+   } SCANNER;
+
+char * opCodeTab[]
+        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV","????",
+            /* RR opcodes */
+           "LD","ST","????", /* RM opcodes */
+           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
+           /* RA opcodes */
+          };
+
+char * stepResultTab[]
+        = {"OK","Halted","Instruction Memory Fault",
+           "Data Memory Fault","Division by 0",
+           "Input Exhausted","Step Limit Reached"
+          };
+
+/********************************************/
+int opClass( int c )
+{ if      ( c <= opRRLim) return ( opclRR );
+  else if ( c <= opRMLim) return ( opclRM );
+  else                    return ( opclRA );
+} /* opClass */
+
+/********************************************/
+/* Function newMemory returns n bytes of zeroed
+ * memory. Anonymous mappings are zeroed by the
+ * system page by page as they are first touched,
+ * so the cost does not grow with n
+ */
+void * newMemory( size_t n )
+{ void * p;
+#if MMAP_AVAILABLE
+  p = mmap(NULL, n, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED) p = NULL;
+#else
+  p = calloc(n, 1);
+#endif
+  if (p == NULL)
+  { printf("Out of memory for %lu bytes\n", (unsigned long) n);
+    exit(1);
+  }
+  return p;
+} /* newMemory */
+
+/********************************************/
+void freeMemory( void * p, size_t n )
+{
+#if MMAP_AVAILABLE
+  munmap(p, n);
+#else
+  free(p);
+#endif
+} /* freeMemory */
+
+/********************************************/
+/*              P R O G R A M S             */
+/********************************************/
+
+/********************************************/
+/* Function newProgram returns a program of
+ * iSize locations. The memories start out as
+ * zero pages, and an all-zero instruction is
+ * HALT 0,0,0, so nothing needs to be cleared
+ */
+PROGRAM * newProgram( int iSize )
+{ PROGRAM * p = (PROGRAM *) malloc(sizeof(PROGRAM));
+  if (p == NULL)
+  { printf("Out of memory for programs\n");
+    exit(1);
+  }
+  p->iMem = (INSTRUCTION *) newMemory(iSize * sizeof(INSTRUCTION));
+  p->fuseTab = (unsigned char *) newMemory(iSize);
+  p->iSize = iSize;
+  p->iCount = 0;
+  return p;
+} /* newProgram */
+
+/********************************************/
+void freeProgram( PROGRAM * p )
+{ freeMemory(p->iMem, p->iSize * sizeof(INSTRUCTION));
+  freeMemory(p->fuseTab, p->iSize);
+  free(p);
+} /* freeProgram */
+
+/********************************************/
+/* Function setInstruction stores op r,s,t at
+ * loc of p, returning FALSE if it is not a
+ * legal instruction
+ */
+int setInstruction( PROGRAM * p, int loc, int op, int r, int s, int t )
+{ if ( (loc < 0) || (loc >= p->iSize) || (op < opHALT) || (op >= opRALim)
+       || (op == opRRLim) || (op == opRMLim)
+       || (r < 0) || (r >= NO_REGS) || (t < 0) || (t >= NO_REGS)
+       || ((opClass(op) == opclRR) && ((s < 0) || (s >= NO_REGS))) )
+    return FALSE;
+  p->iMem[loc].iop = op;
+  p->iMem[loc].iarg1 = r;
+  p->iMem[loc].iarg2 = s;
+  p->iMem[loc].iarg3 = t;
+  if (loc >= p->iCount) p->iCount = loc + 1;
+  return TRUE;
+} /* setInstruction */
+
+/********************************************/
+static void getCh( SCANNER * sc )
+{ if (++sc->col < sc->len)
+  sc->ch = sc->line[sc->col] ;
+  else sc->ch = ' ' ;
+} /* getCh */
+
+/********************************************/
+static int nonBlank( SCANNER * sc )
+{ while ((sc->col < sc->len)
+         && (sc->line[sc->col] == ' ') )
+    sc->col++ ;
+  if (sc->col < sc->len)
+  { sc->ch = sc->line[sc->col] ;
+    return TRUE ; }
+  else
+  { sc->ch = ' ' ;
+    return FALSE ; }
+} /* nonBlank */
+
+/********************************************/
+static int getNum( SCANNER * sc )
+{ int sign;
+  int term;
+  int temp = FALSE;
+  sc->num = 0 ;
+  do
+  { sign = 1;
+    while ( nonBlank(sc) && ((sc->ch == '+') || (sc->ch == '-')) )
+    { temp = FALSE ;
+      if (sc->ch == '-')  sign = - sign ;
+      getCh(sc);
+    }
+    term = 0 ;
+    nonBlank(sc);
+    while (isdigit(sc->ch))
+    { temp = TRUE ;
+      term = term * 10 + ( sc->ch - '0' ) ;
+      getCh(sc);
+    }
+    sc->num = sc->num + (term * sign) ;
+  } while ( (nonBlank(sc)) && ((sc->ch == '+') || (sc->ch == '-')) ) ;
+  return temp;
+} /* getNum */
+
+/********************************************/
+static int getWord( SCANNER * sc )
+{ int temp = FALSE;
+  int length = 0;
+  if (nonBlank (sc))
+  { while (isalnum(sc->ch))
+    { if (length < WORDSIZE-1) sc->word [length++] =  sc->ch ;
+      getCh(sc) ;
+    }
+    sc->word[length] = '\0';
+    temp = (length != 0);
+  }
+  return temp;
+} /* getWord */
+
+/********************************************/
+static int skipCh( SCANNER * sc, char c )
+{ int temp = FALSE;
+  if ( nonBlank(sc) && (sc->ch == c) )
+  { getCh(sc);
+    temp = TRUE;
+  }
+  return temp;
+} /* skipCh */
+
+/********************************************/
+static int error( char * msg, int lineNo, int instNo, char * buf )
+{ if (instNo >= 0)
+    sprintf(buf,"Line %d (Instruction %d)   %s",lineNo,instNo,msg);
+  else sprintf(buf,"Line %d   %s",lineNo,msg);
+  return FALSE;
+} /* error */
+
+/********************************************/
+/* Function readRegister reads a register number
+ * into sc->num, returning FALSE if there is none
+ */
+static int readRegister( SCANNER * sc )
+{ return getNum(sc) && (sc->num >= 0) && (sc->num < NO_REGS);
+} /* readRegister */
+
+/********************************************/
+/* Function loadProgram loads the code file in
+ * text into p, one line at a time; the part of
+ * a line beyond LINESIZE characters is ignored
+ */
+int loadProgram( PROGRAM * p, const char * text,
+                 TMMARK mark, void * host, char * msg )
+{ SCANNER sc;
+  OPCODE op;
+  int arg1, arg2, arg3;
+  int loc, lineNo, n;
+  lineNo = 0 ;
+  while (*text != '\0')
+  { n = strcspn(text, "\n");
+    sc.len = (n < LINESIZE-2) ? n : LINESIZE-2 ;
+    memcpy(sc.line, text, sc.len);
+    sc.line[sc.len] = '\0';
+    text += (text[n] == '\n') ? n + 1 : n ;
+    sc.col = 0 ;
+    lineNo++;
+    if ( (nonBlank(&sc)) && (sc.line[sc.col] == '*')
+         && (sc.line[sc.col+1] == '@') && (mark != NULL) )
+      mark(host, sc.line + sc.col + 2);
+    if ( (nonBlank(&sc)) && (sc.line[sc.col] != '*') )
+    { if (! getNum (&sc))
+        return error("Bad location", lineNo,-1,msg);
+      loc = sc.num;
+      if ((loc < 0) || (loc >= p->iSize))
+        return error("Location too large",lineNo,loc,msg);
+      if (! skipCh(&sc,':'))
+        return error("Missing colon", lineNo,loc,msg);
+      if (! getWord (&sc))
+        return error("Missing opcode", lineNo,loc,msg);
+      op = opHALT ;
+      while ((op < opRALim)
+             && (strncmp(opCodeTab[op], sc.word, 4) != 0) )
+          op++ ;
+      if (strncmp(opCodeTab[op], sc.word, 4) != 0)
+          return error("Illegal opcode", lineNo,loc,msg);
+      switch ( opClass(op) )
+      { case opclRR :
+        /***********************************/
+        if ( ! readRegister (&sc) )
+            return error("Bad first register", lineNo,loc,msg);
+        arg1 = sc.num;
+        if ( ! skipCh(&sc,','))
+            return error("Missing comma", lineNo, loc,msg);
+        if ( ! readRegister (&sc) )
+            return error("Bad second register", lineNo, loc,msg);
+        arg2 = sc.num;
+        if ( ! skipCh(&sc,','))
+            return error("Missing comma", lineNo,loc,msg);
+        if ( ! readRegister (&sc) )
+            return error("Bad third register", lineNo,loc,msg);
+        arg3 = sc.num;
+        break;
+
+        case opclRM :
+        case opclRA :
+        /***********************************/
+        if ( ! readRegister (&sc) )
+            return error("Bad first register", lineNo,loc,msg);
+        arg1 = sc.num;
+        if ( ! skipCh(&sc,','))
+            return error("Missing comma", lineNo,loc,msg);
+        if (! getNum (&sc))
+            return error("Bad displacement", lineNo,loc,msg);
+        arg2 = sc.num;
+        if ( ! skipCh(&sc,'(') && ! skipCh(&sc,',') )
+            return error("Missing LParen", lineNo,loc,msg);
+        if ( ! readRegister (&sc) )
+            return error("Bad second register", lineNo,loc,msg);
+        arg3 = sc.num;
+        break;
+        }
+      setInstruction(p, loc, op, arg1, arg2, arg3);
+    }
+  }
+  fuseInstructions(p);
+  return TRUE;
+} /* loadProgram */
+
+/********************************************/
+/* Function plainReg returns TRUE if register
+ * number r can be read and written by a fused
+ * instruction without observing or changing
+ * the pc
+ */
+static int plainReg( int r )
+{ return (r != PC_REG);
+} /* plainReg */
+
+/********************************************/
+static int isOp( PROGRAM * p, int loc, int op )
+{ return (loc < p->iCount) && (p->iMem[loc].iop == op);
+} /* isOp */
+
+/********************************************/
+/* Function plainRM returns TRUE if iMem[loc]
+ * is the RM (or LDC) instruction op and neither
+ * of its registers is the pc
+ */
+static int plainRM( PROGRAM * p, int loc, int op )
+{ return isOp(p,loc,op) && plainReg(p->iMem[loc].iarg1)
+         && plainReg(p->iMem[loc].iarg3);
+} /* plainRM */
+
+/********************************************/
+/* Function fuseKind returns the superinstruction
+ * whose instruction pattern matches iMem at loc
+ */
+static int fuseKind( PROGRAM * p, int loc )
+{ INSTRUCTION * i = &p->iMem[loc];
+  int op;
+  if ( isOp(p,loc,opSUB) && plainReg(i[0].iarg1)
+       && plainReg(i[0].iarg2) && plainReg(i[0].iarg3)
+       && (loc+4 < p->iCount)
+       && (i[1].iop >= opJLT) && (i[1].iop <= opJNE)
+       && (i[1].iarg1 == i[0].iarg1) && (i[1].iarg2 == 2)
+       && (i[1].iarg3 == PC_REG)
+       && isOp(p,loc+2,opLDC) && (i[2].iarg1 == i[0].iarg1)
+       && isOp(p,loc+3,opLDA) && (i[3].iarg1 == PC_REG)
+       && (i[3].iarg2 == 1) && (i[3].iarg3 == PC_REG)
+       && isOp(p,loc+4,opLDC) && (i[4].iarg1 == i[0].iarg1) )
+    return fuCMP;
+  if ( plainRM(p,loc,opLD) && plainRM(p,loc+1,opST) )
+    return fuLDST;
+  if ( plainRM(p,loc,opST) && plainRM(p,loc+1,opLD) )
+    return fuSTLD;
+  if ( plainRM(p,loc,opLDC) && plainRM(p,loc+1,opST) )
+    return fuLDCST;
+  if ( plainRM(p,loc,opLD) && (loc+1 < p->iCount) )
+  { op = i[1].iop;
+    if ( ((op == opADD) || (op == opSUB) || (op == opMUL))
+         && plainReg(i[1].iarg1) && plainReg(i[1].iarg2)
+         && plainReg(i[1].iarg3) )
+      return fuLDOP;
+  }
+  return fuNONE;
+} /* fuseKind */
+
+/********************************************/
+/* Procedure fuseInstructions is the pre-decoder:
+ * it scans iMem once after loading and marks in
+ * fuseTab every location where one of the
+ * superinstructions of FUSEKIND starts. A pair
+ * is not formed if its second instruction starts
+ * a compare, which saves more dispatches
+ */
+void fuseInstructions( PROGRAM * p )
+{ int loc;
+  for (loc = 0 ; loc < p->iCount ; loc++)
+  { p->fuseTab[loc] = fuseKind(p,loc);
+    if ( (p->fuseTab[loc] != fuNONE) && (p->fuseTab[loc] != fuCMP)
+         && (fuseKind(p,loc+1) == fuCMP) )
+      p->fuseTab[loc] = fuNONE;
+  }
+} /* fuseInstructions */
+
+/********************************************/
+/*              M A C H I N E S             */
+/********************************************/
+
+/********************************************/
+MACHINE * newMachine( PROGRAM * p, int dSize )
+{ MACHINE * mc = (MACHINE *) calloc(1,sizeof(MACHINE));
+  if (mc == NULL)
+  { printf("Out of memory for machines\n");
+    exit(1);
+  }
+  mc->prog = p;
+  mc->dSize = dSize;
+  mc->fuse = TRUE;
+  clearMachine(mc);
+  return mc;
+} /* newMachine */
+
+/********************************************/
+void freeMachine( MACHINE * mc )
+{ freeMemory(mc->dMem, mc->dSize * sizeof(int));
+  free(mc);
+} /* freeMachine */
+
+/********************************************/
+/* Procedure clearMachine zeros the registers of
+ * mc, gives its dMem fresh zero pages and stores
+ * the highest address in dMem[0]
+ */
+void clearMachine( MACHINE * mc )
+{ int regNo;
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+      mc->reg[regNo] = 0 ;
+  if (mc->dMem != NULL) freeMemory(mc->dMem, mc->dSize * sizeof(int));
+  mc->dMem = (int *) newMemory(mc->dSize * sizeof(int));
+  mc->dMem[0] = mc->dSize - 1 ;
+} /* clearMachine */
+
+/********************************************/
+void setMachineIO( MACHINE * mc, TMINPUT input, TMOUTPUT output,
+                   void * host )
+{ mc->input = input;
+  mc->output = output;
+  mc->host = host;
+} /* setMachineIO */
+
+/********************************************/
+void setMachineInputPos( MACHINE * mc, TMTELL tell, TMSEEK seek )
+{ mc->tell = tell;
+  mc->seek = seek;
+} /* setMachineInputPos */
+
+/********************************************/
+int getRegister( MACHINE * mc, int r, int * value )
+{ if ( (r < 0) || (r >= NO_REGS) ) return FALSE;
+  *value = mc->reg[r];
+  return TRUE;
+} /* getRegister */
+
+/********************************************/
+int setRegister( MACHINE * mc, int r, int value )
+{ if ( (r < 0) || (r >= NO_REGS) ) return FALSE;
+  mc->reg[r] = value;
+  return TRUE;
+} /* setRegister */
+
+/********************************************/
+int getMemory( MACHINE * mc, int a, int * value )
+{ if ( (a < 0) || (a >= mc->dSize) ) return FALSE;
+  *value = mc->dMem[a];
+  return TRUE;
+} /* getMemory */
+
+/********************************************/
+int setMemory( MACHINE * mc, int a, int value )
+{ if ( (a < 0) || (a >= mc->dSize) ) return FALSE;
+  mc->dMem[a] = value;
+  return TRUE;
+} /* setMemory */
+
+/********************************************/
+/* Function jumpTaken returns TRUE if the
+ * instruction i is a conditional jump and will
+ * jump; it is called before i is executed
+ */
+int jumpTaken( MACHINE * mc, INSTRUCTION * i )
+{ int v = mc->reg[i->iarg1];
+  switch (i->iop)
+  { case opJLT : return v <  0;
+    case opJLE : return v <= 0;
+    case opJGT : return v >  0;
+    case opJGE : return v >= 0;
+    case opJEQ : return v == 0;
+    case opJNE : return v != 0;
+    default : return FALSE;
+  }
+} /* jumpTaken */
+
+/********************************************/
+/* Function stepTM executes one instruction on the
+ * machine mc
+ */
+STEPRESULT stepTM( MACHINE * mc )
+{ INSTRUCTION currentinstruction  ;
+  int * reg = mc->reg ;
+  int * dMem = mc->dMem ;
+  int dSize = mc->dSize ;
+  int pc  ;
+  int r,s,t,m  ;
+
+  pc = reg[PC_REG] ;
+  if ( (pc < 0) || (pc >= mc->prog->iSize)  )
+      return srIMEM_ERR ;
+  reg[PC_REG] = pc + 1 ;
+  currentinstruction = mc->prog->iMem[ pc ] ;
+  if ( mc->hook != NULL ) mc->hook(mc->host, mc, pc) ;
+  switch (opClass(currentinstruction.iop) )
+  { case opclRR :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg2 ;
+      t = currentinstruction.iarg3 ;
+      break;
+
+    case opclRM :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg3 ;
+      m = currentinstruction.iarg2 + reg[s] ;
+      if ( DMEM_FAULT(m) )
+         return srDMEM_ERR ;
+      break;
+
+    case opclRA :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg3 ;
+      m = currentinstruction.iarg2 + reg[s] ;
+      break;
+  } /* case */
+
+  switch ( currentinstruction.iop)
+  { /* RR instructions */
+    case opHALT :
+    /***********************************/
+      return srHALT ;
+      /* break; */
+
+    case opIN :
+    /***********************************/
+      if ( (mc->input == NULL) || ! mc->input(mc->host, &reg[r]) )
+      { reg[PC_REG] = pc ;
+        return srINPUT_ERR ;
+      }
+      break;
+
+    case opOUT :
+      if ( mc->output != NULL ) mc->output(mc->host, reg[r]) ;
+      break;
+    case opADD :  reg[r] = reg[s] + reg[t] ;  break;
+    case opSUB :  reg[r] = reg[s] - reg[t] ;  break;
+    case opMUL :  reg[r] = reg[s] * reg[t] ;  break;
+
+    case opDIV :
+    /***********************************/
+      if ( reg[t] != 0 ) reg[r] = reg[s] / reg[t];
+      else return srZERODIVIDE ;
+      break;
+
+    /*************** RM instructions ********************/
+    case opLD :    reg[r] = dMem[m] ;  break;
+    case opST :    dMem[m] = reg[r] ;  break;
+
+    /*************** RA instructions ********************/
+    case opLDA :    reg[r] = m ; break;
+    case opLDC :    reg[r] = currentinstruction.iarg2 ;   break;
+    case opJLT :    if ( reg[r] <  0 ) reg[PC_REG] = m ; break;
+    case opJLE :    if ( reg[r] <=  0 ) reg[PC_REG] = m ; break;
+    case opJGT :    if ( reg[r] >  0 ) reg[PC_REG] = m ; break;
+    case opJGE :    if ( reg[r] >=  0 ) reg[PC_REG] = m ; break;
+    case opJEQ :    if ( reg[r] == 0 ) reg[PC_REG] = m ; break;
+    case opJNE :    if ( reg[r] != 0 ) reg[PC_REG] = m ; break;
+
+    /* end of legal instructions */
+  } /* case */
+  return srOKAY ;
+} /* stepTM */
+
+/********************************************/
+/* Function stepFused executes the superinstruction
+ * starting at the pc of mc in one dispatch, or a
+ * single instruction through stepTM if there is
+ * none (or it could run more than limit
+ * instructions, or mc has a hook, which must see
+ * every instruction). The number of TM
+ * instructions actually executed is returned in
+ * cnt; registers, memory, pc and the result are
+ * exactly those of calling stepTM cnt times
+ */
+STEPRESULT stepFused( MACHINE * mc, int limit, int * cnt )
+{ INSTRUCTION * i;
+  unsigned char * fuseTab = mc->prog->fuseTab ;
+  int * reg = mc->reg ;
+  int * dMem = mc->dMem ;
+  int dSize = mc->dSize ;
+  int pc, m;
+
+  pc = reg[PC_REG] ;
+  if ( (! mc->fuse) || (mc->hook != NULL)
+       || (pc < 0) || (pc >= mc->prog->iCount)
+       || (fuseTab[pc] == fuNONE)
+       || (limit < ((fuseTab[pc] == fuCMP) ? 4 : 2)) )
+  { *cnt = 1;
+    return stepTM (mc);
+  }
+  i = &mc->prog->iMem[pc];
+  switch (fuseTab[pc])
+  { case fuCMP :
+    /***********************************/
+      m = reg[i[0].iarg2] - reg[i[0].iarg3] ;
+      switch (i[1].iop)
+      { case opJLT : m = (m <  0) ; break;
+        case opJLE : m = (m <= 0) ; break;
+        case opJGT : m = (m >  0) ; break;
+        case opJGE : m = (m >= 0) ; break;
+        case opJEQ : m = (m == 0) ; break;
+        default :    m = (m != 0) ; break;
+      }
+      reg[i[0].iarg1] = m ? i[4].iarg2 : i[2].iarg2 ;
+      reg[PC_REG] = pc + 5 ;
+      *cnt = m ? 3 : 4 ;
+      return srOKAY ;
+
+    case fuLDST :
+    /***********************************/
+      *cnt = 1 ;
+      reg[PC_REG] = pc + 1 ;
+      m = i[0].iarg2 + reg[i[0].iarg3] ;
+      if ( DMEM_FAULT(m) ) return srDMEM_ERR ;
+      reg[i[0].iarg1] = dMem[m] ;
+      *cnt = 2 ;
+      reg[PC_REG] = pc + 2 ;
+      m = i[1].iarg2 + reg[i[1].iarg3] ;
+      if ( DMEM_FAULT(m) ) return srDMEM_ERR ;
+      dMem[m] = reg[i[1].iarg1] ;
+      return srOKAY ;
+
+    case fuSTLD :
+    /***********************************/
+      *cnt = 1 ;
+      reg[PC_REG] = pc + 1 ;
+      m = i[0].iarg2 + reg[i[0].iarg3] ;
+      if ( DMEM_FAULT(m) ) return srDMEM_ERR ;
+      dMem[m] = reg[i[0].iarg1] ;
+      *cnt = 2 ;
+      reg[PC_REG] = pc + 2 ;
+      m = i[1].iarg2 + reg[i[1].iarg3] ;
+      if ( DMEM_FAULT(m) ) return srDMEM_ERR ;
+      reg[i[1].iarg1] = dMem[m] ;
+      return srOKAY ;
+
+    case fuLDCST :
+    /***********************************/
+      reg[i[0].iarg1] = i[0].iarg2 ;
+      *cnt = 2 ;
+      reg[PC_REG] = pc + 2 ;
+      m = i[1].iarg2 + reg[i[1].iarg3] ;
+      if ( DMEM_FAULT(m) ) return srDMEM_ERR ;
+      dMem[m] = reg[i[1].iarg1] ;
+      return srOKAY ;
+
+    case fuLDOP :
+    /***********************************/
+      *cnt = 1 ;
+      reg[PC_REG] = pc + 1 ;
+      m = i[0].iarg2 + reg[i[0].iarg3] ;
+      if ( DMEM_FAULT(m) ) return srDMEM_ERR ;
+      reg[i[0].iarg1] = dMem[m] ;
+      *cnt = 2 ;
+      reg[PC_REG] = pc + 2 ;
+      switch (i[1].iop)
+      { case opADD : m = reg[i[1].iarg2] + reg[i[1].iarg3] ; break;
+        case opSUB : m = reg[i[1].iarg2] - reg[i[1].iarg3] ; break;
+        default :    m = reg[i[1].iarg2] * reg[i[1].iarg3] ; break;
+      }
+      reg[i[1].iarg1] = m ;
+      return srOKAY ;
+  } /* case */
+  *cnt = 1;
+  return stepTM (mc);
+} /* stepFused */
+
+/********************************************/
+/* Function runMachine executes instructions on
+ * mc until a step result other than srOKAY or
+ * until *steps reaches limit (srLIMIT); *steps
+ * counts the instructions executed
+ */
+STEPRESULT runMachine( MACHINE * mc, long limit, long * steps )
+{ STEPRESULT result = srOKAY;
+  long left;
+  int n;
+  while (result == srOKAY)
+  { left = limit - *steps;
+    if (left <= 0) return srLIMIT;
+    result = stepFused(mc, (left < INT_MAX) ? (int) left : INT_MAX, &n);
+    *steps += n;
+  }
+  return result;
+} /* runMachine */
+
+/********************************************/
+/*           S N A P S H O T S              */
+/********************************************/
+/* A snapshot holds the state of a machine: its
+ * registers (the pc among them), its dMem and the
+ * position of its input, as the tell function of
+ * its host gives it. dMem is kept in pages of
+ * SNAP_PAGE words; pages of zeros are not
+ * stored, and a page equal to the same page
+ * of the base snapshot it was taken after is
+ * shared with it, so a series of snapshots of a
+ * large memory costs about the pages written in
+ * between. A snapshot belongs to the program it
+ * was taken of; restoring it on another program
+ * or memory size is refused
+ */
+
+#define   SNAP_PAGE   1024  /* words per dMem page */
+#define   SNAP_MAXSIZE (1 << 28) /* largest dMem read from a file */
+#define   SNAP_MAGIC  "TMSNAP1"
+
+typedef struct
+   { int refs;               /* snapshots sharing the page */
+     int word[SNAP_PAGE];
+   } SNAPPAGE;
+
+struct Snapshot
+   { unsigned hash;          /* of the program */
+     int dSize;              /* of dMem when taken */
+     int reg[NO_REGS];
+     long inPos;             /* of the input, -1 if none */
+     int npages;
+     SNAPPAGE ** page;       /* NULL: a page of zeros */
+   };
+
+/********************************************/
+/* Function programHash returns a hash of the
+ * program of mc
+ */
+static unsigned programHash( MACHINE * mc )
+{ unsigned h = 2166136261u;
+  int loc;
+  INSTRUCTION * i = mc->prog->iMem;
+  for (loc = 0; loc < mc->prog->iCount; loc++)
+  { h = (h ^ i[loc].iop) * 16777619u;
+    h = (h ^ i[loc].iarg1) * 16777619u;
+    h = (h ^ i[loc].iarg2) * 16777619u;
+    h = (h ^ i[loc].iarg3) * 16777619u;
+  }
+  return h;
+} /* programHash */
+
+/********************************************/
+static SNAPSHOT * newSnapshot( int dSize )
+{ SNAPSHOT * snap = (SNAPSHOT *) calloc(1,sizeof(SNAPSHOT));
+  if (snap != NULL)
+  { snap->dSize = dSize;
+    snap->npages = (dSize + SNAP_PAGE - 1) / SNAP_PAGE;
+    snap->page = (SNAPPAGE **) calloc(snap->npages,sizeof(SNAPPAGE *));
+  }
+  if ( (snap == NULL) || (snap->page == NULL) )
+  { printf("Out of memory for snapshot\n");
+    exit(1);
+  }
+  return snap;
+} /* newSnapshot */
+
+/********************************************/
+static SNAPPAGE * newPage( int * words, int n )
+{ SNAPPAGE * p = (SNAPPAGE *) calloc(1,sizeof(SNAPPAGE));
+  if (p == NULL)
+  { printf("Out of memory for snapshot\n");
+    exit(1);
+  }
+  memcpy(p->word,words,n * sizeof(int));
+  p->refs = 1;
+  return p;
+} /* newPage */
+
+/********************************************/
+/* Procedure freeSnapshot releases snap and the
+ * pages no other snapshot shares
+ */
+void freeSnapshot( SNAPSHOT * snap )
+{ int k;
+  if (snap == NULL) return;
+  for (k = 0; k < snap->npages; k++)
+    if ( (snap->page[k] != NULL) && (--snap->page[k]->refs == 0) )
+      free(snap->page[k]);
+  free(snap->page);
+  free(snap);
+} /* freeSnapshot */
+
+/********************************************/
+/* Function saveSnapshot returns a snapshot of
+ * mc; pages equal to those of base (which may be
+ * NULL) are shared with it
+ */
+SNAPSHOT * saveSnapshot( MACHINE * mc, SNAPSHOT * base )
+{ static int zeros[SNAP_PAGE];
+  SNAPSHOT * snap = newSnapshot(mc->dSize);
+  SNAPPAGE * old;
+  int k, n;
+  snap->hash = programHash(mc);
+  memcpy(snap->reg,mc->reg,sizeof(snap->reg));
+  snap->inPos = (mc->tell != NULL) ? mc->tell(mc->host) : -1;
+  if ( (base != NULL) && (base->dSize != mc->dSize) ) base = NULL;
+  for (k = 0; k < snap->npages; k++)
+  { int * words = mc->dMem + k * SNAP_PAGE;
+    n = mc->dSize - k * SNAP_PAGE;
+    if (n > SNAP_PAGE) n = SNAP_PAGE;
+    old = (base != NULL) ? base->page[k] : NULL;
+    if ( (old != NULL) && (memcmp(old->word,words,n * sizeof(int)) == 0) )
+    { old->refs++;
+      snap->page[k] = old;
+    }
+    else if (memcmp(zeros,words,n * sizeof(int)) != 0)
+      snap->page[k] = newPage(words,n);
+  }
+  return snap;
+} /* saveSnapshot */
+
+/********************************************/
+/* Function restoreSnapshot puts mc back in the
+ * state of snap, returning FALSE if snap was
+ * taken of another program or memory size
+ */
+int restoreSnapshot( MACHINE * mc, SNAPSHOT * snap )
+{ int k, n;
+  if ( (snap->hash != programHash(mc)) || (snap->dSize != mc->dSize) )
+    return FALSE;
+  /* fresh zero pages, then the stored ones */
+  freeMemory(mc->dMem, mc->dSize * sizeof(int));
+  mc->dMem = (int *) newMemory(mc->dSize * sizeof(int));
+  for (k = 0; k < snap->npages; k++)
+    if (snap->page[k] != NULL)
+    { n = mc->dSize - k * SNAP_PAGE;
+      if (n > SNAP_PAGE) n = SNAP_PAGE;
+      memcpy(mc->dMem + k * SNAP_PAGE,snap->page[k]->word,n * sizeof(int));
+    }
+  memcpy(mc->reg,snap->reg,sizeof(snap->reg));
+  if ( (mc->seek != NULL) && (snap->inPos >= 0) )
+    mc->seek(mc->host,snap->inPos);
+  return TRUE;
+} /* restoreSnapshot */
+
+/********************************************/
+/* Function writeSnapshot writes snap to the file
+ * name, returning FALSE on an error. The file
+ * holds the header fields and then the stored
+ * pages, each after its number, in the byte
+ * order of the host
+ */
+int writeSnapshot( SNAPSHOT * snap, const char * name )
+{ FILE * f = fopen(name,"wb");
+  int k, end = -1;
+  if (f == NULL) return FALSE;
+  fwrite(SNAP_MAGIC,1,sizeof(SNAP_MAGIC),f);
+  fwrite(&snap->hash,sizeof(snap->hash),1,f);
+  fwrite(&snap->dSize,sizeof(snap->dSize),1,f);
+  fwrite(snap->reg,sizeof(snap->reg),1,f);
+  fwrite(&snap->inPos,sizeof(snap->inPos),1,f);
+  for (k = 0; k < snap->npages; k++)
+    if (snap->page[k] != NULL)
+    { fwrite(&k,sizeof(k),1,f);
+      fwrite(snap->page[k]->word,sizeof(snap->page[k]->word),1,f);
+    }
+  fwrite(&end,sizeof(end),1,f);
+  return (fclose(f) == 0);
+} /* writeSnapshot */
+
+/********************************************/
+/* Function readSnapshot returns the snapshot in
+ * the file name, or NULL if it cannot be read
+ */
+SNAPSHOT * readSnapshot( const char * name )
+{ FILE * f = fopen(name,"rb");
+  char magic[sizeof(SNAP_MAGIC)];
+  SNAPSHOT * snap;
+  SNAPPAGE page;
+  unsigned hash;
+  int dSize, k;
+  if (f == NULL) return NULL;
+  if ( (fread(magic,1,sizeof(magic),f) != sizeof(magic))
+       || (memcmp(magic,SNAP_MAGIC,sizeof(magic)) != 0)
+       || (fread(&hash,sizeof(hash),1,f) != 1)
+       || (fread(&dSize,sizeof(dSize),1,f) != 1)
+       || (dSize <= 0) || (dSize > SNAP_MAXSIZE) )
+  { fclose(f);
+    return NULL;
+  }
+  snap = newSnapshot(dSize);
+  snap->hash = hash;
+  if ( (fread(snap->reg,sizeof(snap->reg),1,f) != 1)
+       || (fread(&snap->inPos,sizeof(snap->inPos),1,f) != 1) )
+    k = snap->npages;
+  else
+    while ( (fread(&k,sizeof(k),1,f) == 1) && (k >= 0) && (k < snap->npages)
+            && (fread(page.word,sizeof(page.word),1,f) == 1) )
+      snap->page[k] = newPage(page.word,SNAP_PAGE);
+  fclose(f);
+  if (k != -1)
+  { freeSnapshot(snap);
+    return NULL;
+  }
+  return snap;
+} /* readSnapshot */
@@ -0,0 +1,255 @@
+/****************************************************/
+/* File: libtm.h                                    */
+/* Interface of the TM ("Tiny Machine") library:    */
+/* programs, machines, their execution and          */
+/* snapshots, with host callbacks for IN and OUT    */
+/****************************************************/
+
+#ifndef _LIBTM_H_
+#define _LIBTM_H_
+
+#include <stddef.h>
+
+/* A program is loaded once and may be run by any
+ * number of machines, even in different threads,
+ * since running never writes it. A machine holds
+ * the registers and the data memory of one
+ * execution; IN and OUT call the functions its
+ * host supplies. The library keeps no state of
+ * its own outside programs and machines
+ */
+
+#define   NO_REGS 8
+#define   PC_REG  7
+
+typedef enum {
+   opclRR,     /* reg operands r,s,t */
+   opclRM,     /* reg r, mem d+s */
+   opclRA      /* reg r, int d+s */
+   } OPCLASS;
+
+typedef enum {
+   /* RR instructions */
+   opHALT,    /* RR     halt, operands are ignored */
+   opIN,      /* RR     read into reg(r); s and t are ignored */
+   opOUT,     /* RR     write from reg(r), s and t are ignored */
+   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
+   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
+   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
+   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
+   opRRLim,   /* limit of RR opcodes */
+
+   /* RM instructions */
+   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
+   opST,      /* RM     mem(d+reg(s)) = reg(r) */
+   opRMLim,   /* Limit of RM opcodes */
+
+   /* RA instructions */
+   opLDA,     /* RA     reg(r) = d+reg(s) */
+   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
+   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
+   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
+   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
+   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
+   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
+   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+   opRALim    /* Limit of RA opcodes */
+   } OPCODE;
+
+typedef enum {
+   srOKAY,
+   srHALT,
+   srIMEM_ERR,
+   srDMEM_ERR,
+   srZERODIVIDE,
+   srINPUT_ERR,  /* IN found no more input */
+   srLIMIT       /* the step limit of runMachine ran out */
+   } STEPRESULT;
+
+typedef struct {
+      int iop  ;
+      int iarg1  ;
+      int iarg2  ;
+      int iarg3  ;
+   } INSTRUCTION;
+
+typedef struct
+   { INSTRUCTION * iMem;
+     unsigned char * fuseTab;  /* superinstruction at each location */
+     int iSize;                /* locations of iMem */
+     int iCount;               /* one past the highest location loaded */
+   } PROGRAM;
+
+struct Machine;
+
+/* IN stores the next input value in *value and
+ * returns nonzero, or returns 0 if there is none
+ */
+typedef int (* TMINPUT) (void * host, int * value);
+/* OUT passes the value written */
+typedef void (* TMOUTPUT) (void * host, int value);
+/* the hook is called before each instruction with
+ * its location, which the pc has already passed
+ */
+typedef void (* TMHOOK) (void * host, struct Machine * mc, int loc);
+/* the "*@" comments of a code file are passed to
+ * the mark function of loadProgram; text follows
+ * the "*@"
+ */
+typedef void (* TMMARK) (void * host, char * text);
+/* the position of the input IN reads, which
+ * snapshots keep: tell returns it, or -1 if the
+ * input has none, and seek goes back to one that
+ * tell returned
+ */
+typedef long (* TMTELL) (void * host);
+typedef void (* TMSEEK) (void * host, long pos);
+
+typedef struct Machine
+   { int reg[NO_REGS];
+     int * dMem;
+     int dSize;                /* locations of dMem */
+     PROGRAM * prog;
+     int fuse;                 /* execute superinstructions */
+     TMINPUT input;            /* NULL: IN finds no input */
+     TMOUTPUT output;          /* NULL: OUT is discarded */
+     TMHOOK hook;              /* NULL if none */
+     TMTELL tell;              /* NULL: the input has no position */
+     TMSEEK seek;
+     void * host;              /* passed to the functions above */
+   } MACHINE;
+
+/* the names of the opcodes and step results */
+extern char * opCodeTab[];
+extern char * stepResultTab[];
+
+/* size of the message buffer of loadProgram */
+#define   TM_MSGSIZE  160
+
+/* Function opClass returns the OPCLASS of opcode c */
+int opClass( int c );
+
+/* Function newMemory returns n bytes of zeroed
+ * memory, exiting if there is none
+ */
+void * newMemory( size_t n );
+void freeMemory( void * p, size_t n );
+
+/* Function newProgram returns an empty program of
+ * iSize locations; every location holds HALT 0,0,0
+ */
+PROGRAM * newProgram( int iSize );
+void freeProgram( PROGRAM * p );
+
+/* Function loadProgram loads the instructions of
+ * the code file in text into p, calling mark (if
+ * not NULL) for each "*@" comment. On an error it
+ * writes a message into msg, which holds
+ * TM_MSGSIZE characters, and returns 0
+ */
+int loadProgram( PROGRAM * p, const char * text,
+                 TMMARK mark, void * host, char * msg );
+
+/* Function setInstruction stores op r,s,t at loc
+ * of p (for RM and RA instructions s is the
+ * displacement and t the register), returning 0
+ * if the location, opcode or a register is out
+ * of range. fuseInstructions must be called once
+ * all instructions are stored
+ */
+int setInstruction( PROGRAM * p, int loc, int op, int r, int s, int t );
+
+/* Procedure fuseInstructions finds the
+ * superinstructions of p
+ */
+void fuseInstructions( PROGRAM * p );
+
+/* Function newMachine returns a cleared machine of
+ * dSize data locations running p, with no input,
+ * output or hook
+ */
+MACHINE * newMachine( PROGRAM * p, int dSize );
+void freeMachine( MACHINE * mc );
+
+/* Procedure clearMachine zeros the registers and
+ * dMem of mc and stores the highest address in
+ * dMem[0]
+ */
+void clearMachine( MACHINE * mc );
+
+/* Procedure setMachineIO makes IN and OUT of mc
+ * call input and output with host
+ */
+void setMachineIO( MACHINE * mc, TMINPUT input, TMOUTPUT output,
+                   void * host );
+
+/* Procedure setMachineInputPos gives snapshots of
+ * mc the position of its input through tell and
+ * seek, called with the host of setMachineIO
+ */
+void setMachineInputPos( MACHINE * mc, TMTELL tell, TMSEEK seek );
+
+/* the registers and memory of a machine; the
+ * functions return 0 if r or a is out of range
+ */
+int getRegister( MACHINE * mc, int r, int * value );
+int setRegister( MACHINE * mc, int r, int value );
+int getMemory( MACHINE * mc, int a, int * value );
+int setMemory( MACHINE * mc, int a, int value );
+
+/* Function stepTM executes one instruction */
+STEPRESULT stepTM( MACHINE * mc );
+
+/* Function stepFused executes the superinstruction
+ * at the pc, or one instruction; *cnt is set to
+ * the TM instructions executed, at most limit
+ */
+STEPRESULT stepFused( MACHINE * mc, int limit, int * cnt );
+
+/* Function runMachine executes instructions until
+ * a step result other than srOKAY, or srLIMIT when
+ * *steps reaches limit; *steps counts the
+ * instructions executed
+ */
+STEPRESULT runMachine( MACHINE * mc, long limit, long * steps );
+
+/* Function jumpTaken returns nonzero if i is a
+ * conditional jump that jumps in the current
+ * state of mc
+ */
+int jumpTaken( MACHINE * mc, INSTRUCTION * i );
+
+/* A snapshot holds the registers, dMem and input
+ * position of a machine, so that a run can be
+ * continued from it any number of times. dMem is
+ * kept in pages; pages of zeros are not stored
+ * and pages equal to those of the base snapshot
+ * are shared with it
+ */
+typedef struct Snapshot SNAPSHOT;
+
+/* Function saveSnapshot returns a snapshot of mc;
+ * pages equal to those of base (which may be
+ * NULL) are shared with it
+ */
+SNAPSHOT * saveSnapshot( MACHINE * mc, SNAPSHOT * base );
+
+/* Function restoreSnapshot puts mc back in the
+ * state of snap, returning 0 if snap was taken of
+ * another program or memory size
+ */
+int restoreSnapshot( MACHINE * mc, SNAPSHOT * snap );
+
+/* Procedure freeSnapshot releases snap and the
+ * pages no other snapshot shares
+ */
+void freeSnapshot( SNAPSHOT * snap );
+
+/* Function writeSnapshot writes snap to the file
+ * name, and readSnapshot returns the snapshot in
+ * one; they return 0 and NULL on an error
+ */
+int writeSnapshot( SNAPSHOT * snap, const char * name );
+SNAPSHOT * readSnapshot( const char * name );
+
+#endif
@@ -0,0 +1,1168 @@
+/****************************************************/
+/* File: loop.c                                     */
+/* The loops of the IR and the optimizations of     */
+/* them                                             */
+/* (preheaders, hoisting of invariants, strength    */
+/* reduction and unrolling)                         */
+/****************************************************/
+
+#include "globals.h"
+#include "ir.h"
+#include "ssa.h"
+#include "loop.h"
+
+/********************************************/
+/*              L O O P S                   */
+/********************************************/
+
+/* Function dominates returns nonzero if block a
+ * dominates block b
+ */
+static int dominates( BLOCK * a, BLOCK * b )
+{ while ((b != NULL) && (b != a)) b = b->idom;
+  return b == a;
+} /* dominates */
+
+/* Function newLoop returns the loop of header h
+ * with the header only
+ */
+static LOOP * newLoop( IRFUNC * f, BLOCK * h )
+{ LOOP * l = (LOOP *) calloc(1,sizeof(LOOP));
+  l->header = h;
+  l->inLoop = (char *) calloc(f->nblocks+1,1);
+  l->inLoop[h->id] = TRUE;
+  l->nblocks = 1;
+  return l;
+} /* newLoop */
+
+/* Function findLoops returns the natural loops of
+ * f, the inner loops first
+ */
+LOOP * findLoops( IRFUNC * f )
+{ BLOCK ** work = (BLOCK **) malloc((f->nblocks+1)*sizeof(BLOCK *));
+  LOOP * loops = NULL, * sorted = NULL, * l, * m, ** p;
+  BLOCK * b, * h, * x, * outside;
+  int top, j, n;
+  for (b = f->entry; b != NULL; b = b->next)
+    for (j = 0; j < b->nsucc; j++)
+    { h = b->succ[j];
+      if (! dominates(h,b)) continue;
+      /* a back edge: add the blocks reaching b */
+      for (l = loops; (l != NULL) && (l->header != h); l = l->next) ;
+      if (l == NULL)
+      { l = newLoop(f,h);
+        l->next = loops;
+        loops = l;
+      }
+      top = 0;
+      if (! l->inLoop[b->id])
+      { l->inLoop[b->id] = TRUE;
+        l->nblocks++;
+        work[top++] = b;
+      }
+      while (top > 0)
+      { x = work[--top];
+        for (n = 0; n < x->npred; n++)
+          if (! l->inLoop[x->pred[n]->id])
+          { l->inLoop[x->pred[n]->id] = TRUE;
+            l->nblocks++;
+            work[top++] = x->pred[n];
+          }
+      }
+    }
+  free(work);
+  /* a loop inside another has fewer blocks */
+  while (loops != NULL)
+  { l = loops;
+    loops = l->next;
+    for (p = &sorted; (*p != NULL) && ((*p)->nblocks <= l->nblocks);
+         p = &(*p)->next) ;
+    l->next = *p;
+    *p = l;
+  }
+  for (l = sorted; l != NULL; l = l->next)
+  { for (m = l->next; m != NULL; m = m->next)
+      if (m->inLoop[l->header->id]) break;
+    l->parent = m;
+    outside = NULL;
+    for (n = 0, j = 0; j < l->header->npred; j++)
+      if (! l->inLoop[l->header->pred[j]->id])
+      { outside = l->header->pred[j];
+        n++;
+      }
+    if ((n == 1) && (outside->nsucc == 1)) l->preheader = outside;
+  }
+  for (l = sorted; l != NULL; l = l->next)
+    for (m = l; m != NULL; m = m->parent) l->depth++;
+  return sorted;
+} /* findLoops */
+
+/* Procedure freeLoops frees the list of loops */
+void freeLoops( LOOP * loops )
+{ LOOP * next;
+  for ( ; loops != NULL; loops = next)
+  { next = loops->next;
+    free(loops->inLoop);
+    free(loops);
+  }
+} /* freeLoops */
+
+/* Procedure makePreheader inserts a preheader
+ * before the header of l
+ */
+static void makePreheader( IRFUNC * f, LOOP * l )
+{ BLOCK * h = l->header, * ph = irNewBlock(f), * p;
+  IRINST * jump = irNewInst(irJUMP,0,0,0,0), * i, * phi;
+  int j, m, n, k;
+  jump->lineno = h->first->lineno;
+  irAppend(ph,jump);
+  ph->succ[0] = h;
+  ph->nsucc = 1;
+  for (i = h->first; i->op == irPHI; i = i->next)
+  { for (n = 0, m = 0; m < i->nargs; m++)
+      if (! l->inLoop[i->from[m]->id]) n++;
+    if (n == 1)
+    { for (m = 0; m < i->nargs; m++)
+        if (! l->inLoop[i->from[m]->id]) i->from[m] = ph;
+      continue;
+    }
+    /* merge the values from outside in ph */
+    phi = irNewInst(irPHI,irNewReg(f),0,0,i->k);
+    phi->name = i->name;
+    phi->lineno = i->lineno;
+    phi->args = (int *) malloc((n+1)*sizeof(int));
+    phi->from = (BLOCK **) malloc((n+1)*sizeof(BLOCK *));
+    for (k = 0, m = 0; m < i->nargs; m++)
+      if (l->inLoop[i->from[m]->id])
+      { i->args[k] = i->args[m];
+        i->from[k++] = i->from[m];
+      }
+      else
+      { phi->args[phi->nargs] = i->args[m];
+        phi->from[phi->nargs++] = i->from[m];
+      }
+    i->args[k] = phi->dst;
+    i->from[k++] = ph;
+    i->nargs = k;
+    irInsertBefore(jump,phi);
+  }
+  for (j = 0; j < h->npred; j++)
+  { p = h->pred[j];
+    if (l->inLoop[p->id]) continue;
+    for (m = 0; m < p->nsucc; m++)
+      if (p->succ[m] == h) p->succ[m] = ph;
+  }
+  for (p = f->entry; p->next != h; p = p->next) ;
+  p->next = ph;
+  ph->next = h;
+} /* makePreheader */
+
+/* Procedure makePreheaders gives every loop of f a
+ * preheader
+ */
+void makePreheaders( IRFUNC * f )
+{ LOOP * loops, * l;
+  int made = FALSE;
+  findDominators(f);
+  loops = findLoops(f);
+  for (l = loops; l != NULL; l = l->next)
+    /* the entry has no predecessor to replace */
+    if ((l->preheader == NULL) && (l->header != f->entry))
+    { makePreheader(f,l);
+      made = TRUE;
+    }
+  freeLoops(loops);
+  if (made) irBuildCFG(f);
+} /* makePreheaders */
+
+/********************************************/
+/*     I N V A R I A N T   M O T I O N      */
+/********************************************/
+
+/* Function storesGlobal returns nonzero if a block
+ * of l stores the global variable at gp+k
+ */
+static int storesGlobal( IRFUNC * f, LOOP * l, int k )
+{ BLOCK * b;
+  IRINST * i;
+  for (b = f->entry; b != NULL; b = b->next)
+    if (l->inLoop[b->id])
+      for (i = b->first; i != NULL; i = i->next)
+        if ((i->op == irSTOREG) && (i->k == k)) return TRUE;
+  return FALSE;
+} /* storesGlobal */
+
+/* Function readsSafely returns nonzero if the load
+ * i at the head of the header cannot fault before
+ * an input or output would happen: no IN, OUT or
+ * call, whose callee may do either, comes before
+ * it in the header
+ */
+static int readsSafely( LOOP * l, IRINST * i )
+{ IRINST * p;
+  if (i->block != l->header) return FALSE;
+  for (p = i->prev; p != NULL; p = p->prev)
+    if ((p->op == irIN) || (p->op == irOUT) || (p->op == irCALL))
+      return FALSE;
+  return TRUE;
+} /* readsSafely */
+
+/* Function hoistInvariants moves the invariant
+ * instructions of the loops of f into their
+ * preheaders
+ */
+int hoistInvariants( IRFUNC * f, char * writesMemory )
+{ IRINST ** def;
+  BLOCK ** order;
+  LOOP * loops, * l;
+  BLOCK * b;
+  IRINST * i, * next;
+  int moved = 0, writes, stores, canMove, j, n;
+  makePreheaders(f);
+  findDominators(f);
+  loops = findLoops(f);
+  def = (IRINST **) calloc(f->nregs+1,sizeof(IRINST *));
+  order = (BLOCK **) calloc(f->nblocks+1,sizeof(BLOCK *));
+  for (b = f->entry; b != NULL; b = b->next)
+  { order[b->rpo] = b;
+    for (i = b->first; i != NULL; i = i->next)
+      if (i->dst != 0) def[i->dst] = i;
+  }
+  for (l = loops; l != NULL; l = l->next)
+  { if (l->preheader == NULL) continue;
+    writes = stores = FALSE;
+    for (b = f->entry; b != NULL; b = b->next)
+      if (l->inLoop[b->id])
+        for (i = b->first; i != NULL; i = i->next)
+        { if (i->op == irSTORE) stores = TRUE;
+          if ((i->op == irCALL) && writesMemory[i->callee->id]) writes = TRUE;
+        }
+    /* in reverse postorder the operands come first */
+    for (j = 0; j < f->nblocks; j++)
+    { b = order[j];
+      if ((b == NULL) || ! l->inLoop[b->id]) continue;
+      for (i = b->first; i != NULL; i = next)
+      { next = i->next;
+        for (n = 0; n < irNumUses(i); n++)
+          if ((def[*irUse(i,n)] != NULL)
+              && l->inLoop[def[*irUse(i,n)]->block->id])
+            break;
+        if (n < irNumUses(i)) continue;
+        switch (i->op)
+        { case irCONST :
+          case irADDRL :
+          case irADDRG :
+          case irADD :
+          case irSUB :
+          case irMUL :
+          case irLT :
+          case irLE :
+          case irGT :
+          case irGE :
+          case irEQ :
+          case irNE :
+            canMove = TRUE;
+            break;
+          case irDIV :
+            /* by a constant it cannot fault */
+            canMove = (def[i->b] != NULL) && (def[i->b]->op == irCONST)
+                      && (def[i->b]->k != 0) && (def[i->b]->k != -1);
+            break;
+          case irLOADG :
+            canMove = ! writes && ! storesGlobal(f,l,i->k);
+            break;
+          case irLOAD :
+            canMove = ! writes && ! stores && readsSafely(l,i);
+            break;
+          default :
+            canMove = FALSE;
+            break;
+        }
+        if (! canMove) continue;
+        irRemove(i);
+        irInsertBefore(l->preheader->last,i);
+        moved++;
+      }
+    }
+  }
+  freeLoops(loops);
+  free(def);
+  free(order);
+  return moved;
+} /* hoistInvariants */
+
+/********************************************/
+/*  I N D U C T I O N   V A R I A B L E S   */
+/********************************************/
+
+/* A basic induction variable of a loop is a PHI p
+ * of its header that the latch sets to p+c, c+p
+ * or p-c for an invariant c, or to a chain of
+ * such steps; a derived one is a basic or
+ * derived one x plus, minus or times an
+ * invariant, computed in the loop. Each derived
+ * register r is then a linear function of its p,
+ * and a new PHI t that starts at the value of r
+ * for the initial p and steps by the step of p
+ * times the factors of r holds the value of r in
+ * every iteration
+ */
+
+/* the most steps of a basic variable */
+#define MAXCHAIN 64
+
+/* the loop being reduced, its function and
+ * preheader, and the registers of the function
+ * before it
+ */
+static IRFUNC * curFunc;
+static LOOP * curLoop;
+static BLOCK * curPre;
+static int nOldRegs;
+
+/* the instruction defining each register, grown
+ * with the new ones
+ */
+static IRINST ** defOf;
+static int defSize;
+
+/* for the registers before the loop: the basic
+ * variable of an induction variable (0 if none),
+ * the operand it is derived from (0 for a basic
+ * one), and the registers of its initial value
+ * and step, 0 until made
+ */
+static int * root;
+static int * parentOf;
+static int * initReg;
+static int * stepReg;
+
+/* onStep[r] is nonzero if r is a step of a basic
+ * variable to its next value, which the latch
+ * computes anyway
+ */
+static char * onStep;
+
+/* Procedure setDef records that i defines r */
+static void setDef( int r, IRINST * i )
+{ if (r >= defSize)
+  { int n = 2*r + 16;
+    defOf = (IRINST **) realloc(defOf,n*sizeof(IRINST *));
+    memset(defOf+defSize,0,(n-defSize)*sizeof(IRINST *));
+    defSize = n;
+  }
+  defOf[r] = i;
+} /* setDef */
+
+/* Function isInvariant returns nonzero if r is
+ * defined outside the current loop
+ */
+static int isInvariant( int r )
+{ return (r >= defSize) || (defOf[r] == NULL)
+         || ! curLoop->inLoop[defOf[r]->block->id];
+} /* isInvariant */
+
+/* Function ivRoot returns the basic induction
+ * variable of r, 0 if r is none
+ */
+static int ivRoot( int r )
+{ return (r < nOldRegs) ? root[r] : 0;
+} /* ivRoot */
+
+/* Function constOf returns nonzero if r holds a
+ * constant, which it puts into *v
+ */
+static int constOf( int r, int * v )
+{ if ((r >= defSize) || (defOf[r] == NULL) || (defOf[r]->op != irCONST))
+    return FALSE;
+  *v = defOf[r]->k;
+  return TRUE;
+} /* constOf */
+
+/* Function emitPre appends d = a op b (or a CONST
+ * k) to the preheader and returns d; constants are
+ * folded and the identities of 0 and 1 reduced
+ */
+static int emitPre( IROP op, int a, int b, int k )
+{ IRINST * i;
+  int va, vb, v, d;
+  if (op != irCONST)
+  { if (constOf(a,&va) && constOf(b,&vb) && irFold(op,va,vb,&v))
+      return emitPre(irCONST,0,0,v);
+    if ((op == irADD) && constOf(a,&va) && (va == 0)) return b;
+    if (((op == irADD) || (op == irSUB)) && constOf(b,&vb) && (vb == 0))
+      return a;
+    if ((op == irMUL) && constOf(a,&va) && (va == 1)) return b;
+    if ((op == irMUL) && constOf(b,&vb) && (vb == 1)) return a;
+  }
+  d = irNewReg(curFunc);
+  i = irNewInst(op,d,a,b,k);
+  i->lineno = curPre->last->lineno;
+  irInsertBefore(curPre->last,i);
+  setDef(d,i);
+  return d;
+} /* emitPre */
+
+/* Function otherOperand returns the operand of
+ * the instruction defining r that is not the
+ * induction variable it is derived from
+ */
+static int otherOperand( int r )
+{ IRINST * i = defOf[r];
+  return (i->a == parentOf[r]) ? i->b : i->a;
+} /* otherOperand */
+
+/* Function linkOf returns the operand of the
+ * instruction defining r that is in the loop if
+ * r is that plus or minus an invariant, else 0
+ */
+static int linkOf( int r )
+{ IRINST * d = ((r < defSize) && ! isInvariant(r)) ? defOf[r] : NULL;
+  if ((d == NULL) || ((d->op != irADD) && (d->op != irSUB))) return 0;
+  if (isInvariant(d->b)) return d->a;
+  if ((d->op == irADD) && isInvariant(d->a)) return d->b;
+  return 0;
+} /* linkOf */
+
+/* Function chainsTo returns nonzero if r is p
+ * plus or minus invariants, in one step or more
+ * in the loop, as the latch of an unrolled loop
+ * steps its counter
+ */
+static int chainsTo( int r, int p )
+{ int n;
+  for (n = 0; n <= MAXCHAIN; n++)
+  { r = linkOf(r);
+    if (r == 0) return FALSE;
+    if (r == p) return TRUE;
+  }
+  return FALSE;
+} /* chainsTo */
+
+/* Function initOf returns a register holding the
+ * value of the induction variable r when the
+ * loop is entered
+ */
+static int initOf( int r )
+{ IRINST * i = defOf[r];
+  int m, x;
+  if (initReg[r] != 0) return initReg[r];
+  if (parentOf[r] == 0)
+  { m = (i->from[0] == curPre) ? 0 : 1;
+    initReg[r] = i->args[m];
+  }
+  else
+  { x = initOf(parentOf[r]);
+    if (i->a == parentOf[r]) initReg[r] = emitPre(i->op,x,i->b,0);
+    else initReg[r] = emitPre(i->op,i->a,x,0);
+  }
+  return initReg[r];
+} /* initOf */
+
+/* Function stepOf returns a register holding the
+ * change of the induction variable r in one
+ * iteration
+ */
+static int stepOf( int r )
+{ IRINST * i = defOf[r], * next;
+  int m, s, x;
+  if (stepReg[r] != 0) return stepReg[r];
+  if (parentOf[r] == 0)
+  { m = (i->from[0] == curPre) ? 1 : 0;
+    s = emitPre(irCONST,0,0,0);
+    for (x = i->args[m]; x != r; x = linkOf(x))
+    { next = defOf[x];
+      if (next->op == irSUB) s = emitPre(irSUB,s,next->b,0);
+      else s = emitPre(irADD,s,(next->a == linkOf(x)) ? next->b : next->a,0);
+    }
+  }
+  else
+  { s = stepOf(parentOf[r]);
+    if (i->op == irMUL) s = emitPre(irMUL,s,otherOperand(r),0);
+    else if ((i->op == irSUB) && (i->b == parentOf[r]))
+      s = emitPre(irSUB,emitPre(irCONST,0,0,0),s,0);
+  }
+  stepReg[r] = s;
+  return s;
+} /* stepOf */
+
+/* Function hasUnitFactor returns nonzero if the
+ * induction variable r is its basic variable
+ * plus an invariant
+ */
+static int hasUnitFactor( int r )
+{ for ( ; parentOf[r] != 0; r = parentOf[r])
+    if ((defOf[r]->op == irMUL)
+        || ((defOf[r]->op == irSUB) && (defOf[r]->b == parentOf[r])))
+      return FALSE;
+  return TRUE;
+} /* hasUnitFactor */
+
+/* Function savesAlone returns nonzero if a PHI
+ * for r saves work in each iteration even if the
+ * basic variable of r stays: r is derived by a
+ * multiplication or by more than one step from
+ * the steps of the basic variable
+ */
+static int savesAlone( int r )
+{ int n = 0;
+  for ( ; (parentOf[r] != 0) && ! onStep[r]; r = parentOf[r])
+  { if (defOf[r]->op == irMUL) return TRUE;
+    n++;
+  }
+  return n > 1;
+} /* savesAlone */
+
+/* Function reduceLoop reduces the derived
+ * induction variables of the current loop and
+ * returns their number and that of the compares
+ * replaced
+ */
+static int reduceLoop( BLOCK ** order, int nblocks )
+{ BLOCK * h = curLoop->header, * latch, * b;
+  IRINST * i, * d, * phi, * step;
+  int * repl, * isNext, * wanted, * dies;
+  int reduced = 0, j, m, n, p, r, u, x, t;
+  if ((curPre == NULL) || (h->npred != 2)) return 0;
+  latch = (h->pred[0] == curPre) ? h->pred[1] : h->pred[0];
+  nOldRegs = curFunc->nregs;
+  root = (int *) calloc(nOldRegs+1,sizeof(int));
+  parentOf = (int *) calloc(nOldRegs+1,sizeof(int));
+  initReg = (int *) calloc(nOldRegs+1,sizeof(int));
+  stepReg = (int *) calloc(nOldRegs+1,sizeof(int));
+  repl = (int *) calloc(nOldRegs+1,sizeof(int));
+  isNext = (int *) calloc(nOldRegs+1,sizeof(int));
+  wanted = (int *) calloc(nOldRegs+1,sizeof(int));
+  dies = (int *) calloc(nOldRegs+1,sizeof(int));
+  onStep = (char *) calloc(nOldRegs+1,1);
+  /* the basic induction variables */
+  for (i = h->first; i->op == irPHI; i = i->next)
+  { if (i->nargs != 2) continue;
+    m = (i->from[0] == latch) ? 0 : 1;
+    d = defOf[i->args[m]];
+    if ((d == NULL) || ! curLoop->inLoop[d->block->id]) continue;
+    p = i->dst;
+    if (chainsTo(d->dst,p))
+    { root[p] = p;
+      for (r = d->dst; r != p; r = linkOf(r)) onStep[r] = TRUE;
+      isNext[d->dst] = p;
+    }
+  }
+  /* the derived ones, the operands first */
+  for (j = 0; j < nblocks; j++)
+  { b = order[j];
+    if ((b == NULL) || ! curLoop->inLoop[b->id]) continue;
+    for (i = b->first; i != NULL; i = i->next)
+    { if ((i->op != irADD) && (i->op != irSUB) && (i->op != irMUL)) continue;
+      if (ivRoot(i->a) && isInvariant(i->b)) x = i->a;
+      else if (ivRoot(i->b) && isInvariant(i->a)) x = i->b;
+      else continue;
+      root[i->dst] = root[x];
+      parentOf[i->dst] = x;
+    }
+  }
+  /* the candidates: those with a use that is not
+   * itself an induction variable
+   */
+  for (j = 0; j < nblocks; j++)
+  { b = order[j];
+    if ((b == NULL) || ! curLoop->inLoop[b->id]) continue;
+    for (i = b->first; i != NULL; i = i->next)
+    { if ((i->dst != 0) && (i->dst < nOldRegs) && (parentOf[i->dst] != 0))
+        continue;
+      for (n = 0; n < irNumUses(i); n++)
+      { r = *irUse(i,n);
+        if ((r < nOldRegs) && (parentOf[r] != 0) && ! isNext[r])
+          wanted[r] = TRUE;
+      }
+    }
+  }
+  /* a basic variable dies if it is only stepped,
+   * compared with invariants and derived from; it
+   * then pays to reduce every derived one
+   */
+  for (i = h->first; i->op == irPHI; i = i->next)
+    if (ivRoot(i->dst) == i->dst) dies[i->dst] = TRUE;
+  for (b = curFunc->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+      for (n = 0; n < irNumUses(i); n++)
+      { u = *irUse(i,n);
+        if (u >= nOldRegs) continue;
+        p = isNext[u] ? isNext[u] : u;
+        if (! dies[p]) continue;
+        if (! curLoop->inLoop[b->id]) dies[p] = FALSE;
+        else if ((i->dst != 0) && (i->dst < nOldRegs)
+                 && ((parentOf[i->dst] != 0) || isNext[i->dst]))
+          ; /* derived from p, or its step */
+        else if ((i->op == irPHI) && (i->dst == p))
+          ; /* the step of p */
+        else if ((i->op >= irLT) && (i->op <= irNE) && (u == p)
+                 && isInvariant((i->a == p) ? i->b : i->a))
+        { for (r = 1; r < nOldRegs; r++)
+            if (wanted[r] && (root[r] == p) && hasUnitFactor(r)) break;
+          if (r == nOldRegs) dies[p] = FALSE;
+        }
+        else dies[p] = FALSE;
+      }
+  for (r = 1; r < nOldRegs; r++)
+  { if (! wanted[r] || (! dies[root[r]] && ! savesAlone(r))) continue;
+    t = irNewReg(curFunc);
+    phi = irNewInst(irPHI,t,0,0,0);
+    phi->lineno = h->first->lineno;
+    phi->nargs = 2;
+    phi->args = (int *) malloc(3*sizeof(int));
+    phi->from = (BLOCK **) malloc(3*sizeof(BLOCK *));
+    phi->args[0] = initOf(r);
+    phi->from[0] = curPre;
+    phi->args[1] = irNewReg(curFunc);
+    phi->from[1] = latch;
+    irInsertBefore(h->first,phi);
+    setDef(t,phi);
+    step = irNewInst(irADD,phi->args[1],t,stepOf(r),0);
+    step->lineno = latch->last->lineno;
+    irInsertBefore(latch->last,step);
+    setDef(phi->args[1],step);
+    repl[r] = t;
+    reduced++;
+  }
+  /* replace the tests of a basic variable by tests
+   * of a reduced one that differs by an invariant:
+   * (p+e)-(c+e) is p-c even when it wraps
+   */
+  for (j = 0; j < nblocks; j++)
+  { b = order[j];
+    if ((b == NULL) || ! curLoop->inLoop[b->id]) continue;
+    for (i = b->first; i != NULL; i = i->next)
+    { if ((i->op < irLT) || (i->op > irNE)) continue;
+      if ((ivRoot(i->a) == i->a) && isInvariant(i->b)) n = 0;
+      else if ((ivRoot(i->b) == i->b) && isInvariant(i->a)) n = 1;
+      else continue;
+      p = (n == 0) ? i->a : i->b;
+      for (r = 1; r < nOldRegs; r++)
+        if ((repl[r] != 0) && (root[r] == p) && hasUnitFactor(r)) break;
+      if (r == nOldRegs) continue;
+      x = emitPre(irSUB,initOf(r),initOf(p),0);
+      if (n == 0)
+      { i->a = repl[r];
+        i->b = emitPre(irADD,i->b,x,0);
+      }
+      else
+      { i->b = repl[r];
+        i->a = emitPre(irADD,i->a,x,0);
+      }
+      reduced++;
+    }
+  }
+  for (j = 0; j < nblocks; j++)
+  { b = order[j];
+    if ((b == NULL) || ! curLoop->inLoop[b->id]) continue;
+    for (i = b->first; i != NULL; i = i->next)
+      for (n = 0; n < irNumUses(i); n++)
+        if ((*irUse(i,n) < nOldRegs) && (repl[*irUse(i,n)] != 0))
+          *irUse(i,n) = repl[*irUse(i,n)];
+  }
+  free(root);
+  free(parentOf);
+  free(initReg);
+  free(stepReg);
+  free(repl);
+  free(isNext);
+  free(wanted);
+  free(dies);
+  free(onStep);
+  return reduced;
+} /* reduceLoop */
+
+/* Function reduceStrength reduces the derived
+ * induction variables of the loops of f
+ */
+int reduceStrength( IRFUNC * f )
+{ BLOCK ** order;
+  LOOP * loops, * l;
+  BLOCK * b;
+  IRINST * i;
+  int reduced = 0;
+  makePreheaders(f);
+  findDominators(f);
+  loops = findLoops(f);
+  order = (BLOCK **) calloc(f->nblocks+1,sizeof(BLOCK *));
+  defSize = 0;
+  defOf = NULL;
+  setDef(f->nregs,NULL);
+  for (b = f->entry; b != NULL; b = b->next)
+  { order[b->rpo] = b;
+    for (i = b->first; i != NULL; i = i->next)
+      if (i->dst != 0) setDef(i->dst,i);
+  }
+  curFunc = f;
+  for (l = loops; l != NULL; l = l->next)
+  { /* the setup of the remainder of an unrolled
+     * loop costs more than its few iterations
+     */
+    if (l->header->fewTrips) continue;
+    curLoop = l;
+    curPre = l->preheader;
+    reduced += reduceLoop(order,f->nblocks);
+  }
+  freeLoops(loops);
+  free(order);
+  free(defOf);
+  return reduced;
+} /* reduceStrength */
+
+/********************************************/
+/*          U N R O L L I N G               */
+/********************************************/
+
+/* A counted loop, before SSA, has a header that
+ * only loads its counter, a local variable, and
+ * an invariant bound to compare them and branch
+ * into the loop or out of it, and one latch that
+ * holds the only store of the counter in the
+ * loop, i = i+c or i = i-c for a constant c that
+ * moves it towards the bound. Every register of
+ * the loop is used in its own block, as the
+ * lowering leaves them, so a block is copied by
+ * renaming the registers it defines
+ */
+
+/* the largest factor and trip count of unrolling,
+ * and the most instructions a loop is fully
+ * unrolled into
+ */
+#define MAXUNROLL 16
+#define MAXFULLSIZE 64
+
+/* the counted loop being unrolled: its latch, the
+ * first block of its body and the exit, the frame
+ * offset of the counter, the operand of the
+ * compare it is, the step, the register of the
+ * bound and, if it is constant, its value
+ */
+static BLOCK * latch;
+static BLOCK * bodyEntry;
+static BLOCK * loopExit;
+static IRINST * test;
+static int counterK;
+static int counterSide;
+static int stepVal;
+static int boundReg;
+static int boundIsConst;
+static int boundVal;
+
+/* the blocks of f before the unrolling; the
+ * copies come after them
+ */
+static int nOldBlocks;
+
+/* Function inside returns nonzero if b is a block
+ * of l that was there before the unrolling
+ */
+static int inside( LOOP * l, BLOCK * b )
+{ return (b->id < nOldBlocks) && l->inLoop[b->id];
+} /* inside */
+
+/* Function countStores returns the number of
+ * stores of op to the word at offset k in l
+ */
+static int countStores( IRFUNC * f, LOOP * l, IROP op, int k )
+{ BLOCK * b;
+  IRINST * i;
+  int n = 0;
+  for (b = f->entry; b != NULL; b = b->next)
+    if (inside(l,b))
+      for (i = b->first; i != NULL; i = i->next)
+        if ((i->op == op) && (i->k == k)) n++;
+  return n;
+} /* countStores */
+
+/* Function blockLocal returns nonzero if every
+ * register used in a block of l is defined before
+ * in the same block
+ */
+static int blockLocal( IRFUNC * f, LOOP * l )
+{ int * defIn = (int *) malloc((f->nregs+1)*sizeof(int));
+  BLOCK * b;
+  IRINST * i;
+  int ok = TRUE, n;
+  for (n = 0; n <= f->nregs; n++) defIn[n] = -1;
+  for (b = f->entry; (b != NULL) && ok; b = b->next)
+    if (inside(l,b))
+      for (i = b->first; i != NULL; i = i->next)
+      { for (n = 0; n < irNumUses(i); n++)
+          if (defIn[*irUse(i,n)] != b->id) ok = FALSE;
+        if (i->dst != 0) defIn[i->dst] = b->id;
+      }
+  free(defIn);
+  return ok;
+} /* blockLocal */
+
+/* Function countedHeader returns nonzero if the
+ * header of l loads the counter and the bound and
+ * tests them, recording the test and the bound
+ */
+static int countedHeader( IRFUNC * f, LOOP * l, int writes )
+{ BLOCK * h = l->header;
+  char * counter = (char *) calloc(f->nregs+1,1);
+  char * inv = (char *) calloc(f->nregs+1,1);
+  int * val = (int *) calloc(f->nregs+1,sizeof(int));
+  char * known = (char *) calloc(f->nregs+1,1);
+  IRINST * i;
+  int ok = TRUE, haveCounter = FALSE, n;
+  test = NULL;
+  for (i = h->first; ok && (i != h->last); i = i->next)
+    switch (i->op)
+    { case irCONST :
+        inv[i->dst] = known[i->dst] = TRUE;
+        val[i->dst] = i->k;
+        break;
+      case irLOADL :
+        n = countStores(f,l,irSTOREL,i->k);
+        if ((n == 1) && (! haveCounter || (counterK == i->k)))
+        { counter[i->dst] = TRUE;
+          counterK = i->k;
+          haveCounter = TRUE;
+        }
+        else if (n == 0) inv[i->dst] = TRUE;
+        else ok = FALSE;
+        break;
+      case irLOADG :
+        inv[i->dst] = ! writes && (countStores(f,l,irSTOREG,i->k) == 0);
+        ok = inv[i->dst];
+        break;
+      case irADD :
+      case irSUB :
+      case irMUL :
+        inv[i->dst] = inv[i->a] && inv[i->b];
+        known[i->dst] = known[i->a] && known[i->b]
+                        && irFold(i->op,val[i->a],val[i->b],&val[i->dst]);
+        ok = inv[i->dst];
+        break;
+      case irLT :
+      case irLE :
+      case irGT :
+      case irGE :
+        if ((test != NULL) || (i->next != h->last)) ok = FALSE;
+        else if (counter[i->a] && inv[i->b]) counterSide = 0;
+        else if (inv[i->a] && counter[i->b]) counterSide = 1;
+        else ok = FALSE;
+        test = i;
+        break;
+      default :
+        ok = FALSE;
+        break;
+    }
+  ok = ok && (test != NULL) && (h->last->op == irBRANCH)
+       && (h->last->a == test->dst) && inside(l,h->succ[0])
+       && ! inside(l,h->succ[1]) && (h->succ[0] != h);
+  if (ok)
+  { boundReg = (counterSide == 0) ? test->b : test->a;
+    boundIsConst = known[boundReg];
+    boundVal = val[boundReg];
+    bodyEntry = h->succ[0];
+    loopExit = h->succ[1];
+  }
+  free(counter);
+  free(inv);
+  free(val);
+  free(known);
+  return ok;
+} /* countedHeader */
+
+/* Function defBefore returns the instruction of
+ * the block of at, before it, that defines r, or
+ * NULL
+ */
+static IRINST * defBefore( IRINST * at, int r )
+{ IRINST * i;
+  for (i = at->prev; i != NULL; i = i->prev)
+    if (i->dst == r) return i;
+  return NULL;
+} /* defBefore */
+
+/* Function countedLatch returns nonzero if the
+ * latch of l steps the counter by a constant
+ * towards the bound, recording the step
+ */
+static int countedLatch( LOOP * l )
+{ BLOCK * h = l->header;
+  IRINST * s, * d, * x, * c;
+  int j, up;
+  latch = NULL;
+  for (j = 0; j < h->npred; j++)
+    if (inside(l,h->pred[j]))
+    { if (latch != NULL) return FALSE;
+      latch = h->pred[j];
+    }
+  if ((latch == NULL) || (latch == h) || (latch->last->op != irJUMP))
+    return FALSE;
+  for (s = latch->first; s != NULL; s = s->next)
+    if ((s->op == irSTOREL) && (s->k == counterK)) break;
+  if ((s == NULL) || ((d = defBefore(s,s->a)) == NULL)) return FALSE;
+  if ((d->op != irADD) && (d->op != irSUB)) return FALSE;
+  x = defBefore(d,d->a);
+  c = defBefore(d,d->b);
+  if ((d->op == irADD) && (c != NULL) && (c->op == irLOADL))
+  { x = c;
+    c = defBefore(d,d->a);
+  }
+  if ((x == NULL) || (x->op != irLOADL) || (x->k != counterK)
+      || (c == NULL) || (c->op != irCONST))
+    return FALSE;
+  stepVal = (d->op == irSUB) ? -c->k : c->k;
+  /* (U-1)*c must not wrap */
+  if ((stepVal == 0) || (stepVal > 65536) || (stepVal < -65536))
+    return FALSE;
+  up = (test->op == irLT) || (test->op == irLE);
+  if (counterSide == 1) up = ! up;
+  return up ? (stepVal > 0) : (stepVal < 0);
+} /* countedLatch */
+
+/* Function tripCount returns the number of
+ * iterations of l if the block before it stores a
+ * constant into the counter and the bound is a
+ * constant, else -1, as for more than MAXUNROLL
+ */
+static int tripCount( IRFUNC * f, LOOP * l )
+{ BLOCK * b, * pre = NULL;
+  IRINST * s, * c;
+  int j, n, v, t;
+  if (! boundIsConst) return -1;
+  for (b = f->entry; b != NULL; b = b->next)
+    for (j = 0; j < b->nsucc; j++)
+      if ((b->succ[j] == l->header) && (b != latch))
+      { if ((pre != NULL) && (pre != b)) return -1;
+        pre = b;
+      }
+  if (pre == NULL) return -1;
+  for (s = pre->last; s != NULL; s = s->prev)
+    if ((s->op == irSTOREL) && (s->k == counterK)) break;
+  if ((s == NULL) || ((c = defBefore(s,s->a)) == NULL) || (c->op != irCONST))
+    return -1;
+  v = c->k;
+  for (n = 0; n <= MAXUNROLL; n++)
+  { if (counterSide == 0) irFold(test->op,v,boundVal,&t);
+    else irFold(test->op,boundVal,v,&t);
+    if (! t) return n;
+    v = (int) ((unsigned) v + (unsigned) stepVal);
+  }
+  return -1;
+} /* tripCount */
+
+/* Function cloneBlock returns a copy of b with
+ * fresh registers, recorded in regMap, and puts
+ * it into the layout after *tail. The loads of
+ * the counter read it plus shift, and the store
+ * of it is left out, adding the step to shift
+ * instead, unless keepStore
+ */
+static BLOCK * cloneBlock( IRFUNC * f, BLOCK * b, int * regMap,
+                           BLOCK ** tail, int shift, int keepStore )
+{ BLOCK * c = irNewBlock(f);
+  IRINST * i, * n, * k;
+  int j;
+  for (i = b->first; i != NULL; i = i->next)
+  { if ((i->op == irSTOREL) && (i->k == counterK))
+    { if (! keepStore)
+      { shift += stepVal;
+        continue;
+      }
+      shift = 0;
+    }
+    n = irNewInst(i->op,0,i->a,i->b,i->k);
+    n->name = i->name;
+    n->callee = i->callee;
+    n->lineno = i->lineno;
+    n->nargs = i->nargs;
+    if (i->args != NULL)
+    { n->args = (int *) malloc((i->nargs+1)*sizeof(int));
+      memcpy(n->args,i->args,(i->nargs+1)*sizeof(int));
+    }
+    for (j = 0; j < irNumUses(n); j++) *irUse(n,j) = regMap[*irUse(n,j)];
+    if (i->dst != 0)
+    { n->dst = irNewReg(f);
+      regMap[i->dst] = n->dst;
+    }
+    irAppend(c,n);
+    if ((i->op == irLOADL) && (i->k == counterK) && (shift != 0))
+    { k = irNewInst(irCONST,irNewReg(f),0,0,shift);
+      k->lineno = i->lineno;
+      irAppend(c,k);
+      n = irNewInst(irADD,irNewReg(f),n->dst,k->dst,0);
+      n->lineno = i->lineno;
+      irAppend(c,n);
+      regMap[i->dst] = n->dst;
+    }
+  }
+  c->succ[0] = b->succ[0];
+  c->succ[1] = b->succ[1];
+  c->nsucc = b->nsucc;
+  c->next = (*tail)->next;
+  (*tail)->next = c;
+  *tail = c;
+  return c;
+} /* cloneBlock */
+
+/* Function copyBody puts the copy number n of the
+ * blocks of l but the header after *tail, its
+ * latch going to next instead of the header, and
+ * returns its first block and in *last the copy
+ * of the latch. The counter is stored only by
+ * the last copy, and the others read it plus the
+ * steps they have made
+ */
+static BLOCK * copyBody( IRFUNC * f, LOOP * l, int n, int isLast,
+                         BLOCK * next, int * regMap, BLOCK ** tail,
+                         BLOCK ** last )
+{ BLOCK ** clone = (BLOCK **) calloc(nOldBlocks+1,sizeof(BLOCK *));
+  BLOCK * b, * c, * first;
+  int j;
+  for (b = f->entry; b != NULL; b = b->next)
+    if (inside(l,b) && (b != l->header))
+      clone[b->id] = cloneBlock(f,b,regMap,tail,n*stepVal,isLast);
+  for (b = f->entry; b != NULL; b = b->next)
+    if (inside(l,b) && (b != l->header))
+    { c = clone[b->id];
+      for (j = 0; j < c->nsucc; j++)
+        if (c->succ[j] == l->header) c->succ[j] = next;
+        else if (inside(l,c->succ[j])) c->succ[j] = clone[c->succ[j]->id];
+    }
+  first = clone[bodyEntry->id];
+  *last = clone[latch->id];
+  free(clone);
+  return first;
+} /* copyBody */
+
+/* Procedure enterAt makes the jumps into the
+ * header of l from outside it, except from the
+ * blocks numbered firstNew and after, go to b
+ */
+static void enterAt( IRFUNC * f, LOOP * l, BLOCK * b, int firstNew )
+{ BLOCK * p;
+  int j;
+  for (p = f->entry; p != NULL; p = p->next)
+    if ((p != latch) && (p->id < firstNew))
+      for (j = 0; j < p->nsucc; j++)
+        if (p->succ[j] == l->header) p->succ[j] = b;
+} /* enterAt */
+
+/* Procedure unrollFully replaces l by trips
+ * copies of its body, put after tail
+ */
+static void unrollFully( IRFUNC * f, LOOP * l, int trips, int * regMap,
+                         BLOCK * tail )
+{ int firstNew = f->nblocks, n;
+  BLOCK * first = loopExit, * prevLatch = NULL, * b, * last;
+  for (n = 0; n < trips; n++)
+  { b = copyBody(f,l,n,n == trips-1,loopExit,regMap,&tail,&last);
+    if (prevLatch == NULL) first = b;
+    else prevLatch->succ[0] = b;
+    prevLatch = last;
+  }
+  enterAt(f,l,first,firstNew);
+} /* unrollFully */
+
+/* Procedure unrollBy puts before l, after tail, a
+ * loop of factor copies of its body. Its header
+ * tests whether the counter moved by (factor-1)
+ * steps would still pass the test of l, going on
+ * to the rest of the iterations in l if not. A
+ * copy of the header of l tests the counter once
+ * before it: the test of the loop alone may pass
+ * if the counter wraps around, but not after
+ * that, as the counter then stays within a step
+ * of the bound
+ */
+static void unrollBy( IRFUNC * f, LOOP * l, int factor, int * regMap,
+                      BLOCK * tail )
+{ int firstNew = f->nblocks, n;
+  BLOCK * top, * guard, * b, * prevLatch = NULL, * last;
+  IRINST * t, * k, * d;
+  top = cloneBlock(f,l->header,regMap,&tail,0,TRUE);
+  guard = cloneBlock(f,l->header,regMap,&tail,0,TRUE);
+  t = guard->last->prev;
+  k = irNewInst(irCONST,irNewReg(f),0,0,(factor-1)*stepVal);
+  d = irNewInst(irSUB,irNewReg(f),regMap[boundReg],k->dst,0);
+  k->lineno = d->lineno = t->lineno;
+  irInsertBefore(t,k);
+  irInsertBefore(t,d);
+  if (counterSide == 0) t->b = d->dst;
+  else t->a = d->dst;
+  top->succ[0] = guard;
+  guard->succ[1] = l->header;
+  l->header->fewTrips = TRUE;
+  for (n = 0; n < factor; n++)
+  { b = copyBody(f,l,n,n == factor-1,guard,regMap,&tail,&last);
+    if (prevLatch == NULL) guard->succ[0] = b;
+    else prevLatch->succ[0] = b;
+    prevLatch = last;
+  }
+  enterAt(f,l,top,firstNew);
+} /* unrollBy */
+
+/* Function blockSize returns the number of
+ * instructions of b
+ */
+static int blockSize( BLOCK * b )
+{ IRINST * i;
+  int n = 0;
+  for (i = b->first; i != NULL; i = i->next) n++;
+  return n;
+} /* blockSize */
+
+/* Function unrollLoops unrolls the counted loops
+ * of f
+ */
+int unrollLoops( IRFUNC * f, int factor, char * writesMemory, int * budget )
+{ LOOP * loops, * l, * m;
+  BLOCK * b, * tail;
+  IRINST * i;
+  int * regMap;
+  int unrolled = 0, writes, trips, bodySize, grows;
+  if (factor > MAXUNROLL) factor = MAXUNROLL;
+  findDominators(f);
+  loops = findLoops(f);
+  nOldBlocks = f->nblocks;
+  regMap = (int *) calloc(f->nregs+1,sizeof(int));
+  for (l = loops; l != NULL; l = l->next)
+  { /* only the innermost loops */
+    for (m = loops; m != NULL; m = m->next)
+      if ((m != l) && l->inLoop[m->header->id]) break;
+    if ((m != NULL) || (l->header == f->entry) || ! blockLocal(f,l))
+      continue;
+    writes = FALSE;
+    bodySize = 0;
+    for (b = f->entry; b != NULL; b = b->next)
+      if (inside(l,b))
+      { if (b != l->header) bodySize += blockSize(b);
+        for (i = b->first; i != NULL; i = i->next)
+          if ((i->op == irCALL) && writesMemory[i->callee->id]) writes = TRUE;
+      }
+    if (! countedHeader(f,l,writes) || ! countedLatch(l)) continue;
+    for (tail = f->entry; tail->next != l->header; tail = tail->next) ;
+    trips = tripCount(f,l);
+    /* a copy adds the shift to the counter it loads */
+    bodySize += 2;
+    grows = trips*bodySize - bodySize - blockSize(l->header);
+    if ((trips >= 0) && (trips*bodySize <= MAXFULLSIZE) && (grows <= *budget))
+    { unrollFully(f,l,trips,regMap,tail);
+      *budget -= grows;
+      unrolled++;
+      continue;
+    }
+    /* the copies save the tests of the counter; a
+     * body that branches keeps most of its tests
+     */
+    grows = factor*bodySize + 2*blockSize(l->header) + 2;
+    if ((factor > 1) && (bodyEntry == latch)
+        && ((trips < 0) || (trips >= factor)) && (grows <= *budget))
+    { unrollBy(f,l,factor,regMap,tail);
+      *budget -= grows;
+      unrolled++;
+    }
+  }
+  free(regMap);
+  freeLoops(loops);
+  if (unrolled > 0) irBuildCFG(f);
+  return unrolled;
+} /* unrollLoops */
@@ -0,0 +1,89 @@
+/****************************************************/
+/* File: loop.h                                     */
+/* The loops of the IR and the optimizations of     */
+/* them                                             */
+/* (preheaders, hoisting of invariants, strength    */
+/* reduction and unrolling)                         */
+/****************************************************/
+
+#ifndef _LOOP_H_
+#define _LOOP_H_
+
+/* A natural loop: the header and the blocks that
+ * reach a back edge to it without passing it.
+ * The loops with the same header are one loop
+ */
+typedef struct Loop
+   { BLOCK * header;
+     BLOCK * preheader;        /* only predecessor from outside, or NULL */
+     char * inLoop;            /* by block id */
+     int nblocks;
+     int depth;                /* 1 for an outermost loop */
+     struct Loop * parent;     /* the loop enclosing it, or NULL */
+     struct Loop * next;       /* inner loops come first */
+   } LOOP;
+
+/* Function findLoops returns the natural loops of
+ * f, whose dominator tree is built, the inner
+ * loops before the loops enclosing them
+ */
+LOOP * findLoops( IRFUNC * f );
+
+/* Procedure freeLoops frees the list of loops */
+void freeLoops( LOOP * loops );
+
+/* Procedure makePreheaders gives every loop of f,
+ * in SSA form, a preheader: a block whose only
+ * successor is the header and that is the only
+ * predecessor of the header from outside the
+ * loop. The PHIs of the header merge the values
+ * from outside in the preheader
+ */
+void makePreheaders( IRFUNC * f );
+
+/* Function hoistInvariants moves the instructions
+ * of the loops of f, in SSA form, whose operands
+ * are defined outside the loop and that have no
+ * effect into the preheaders, inner loops first,
+ * so that they may leave several loops. Loads
+ * move only from loops without stores to their
+ * memory, or calls of a function that
+ * writesMemory[id] marks. It returns the number
+ * of instructions moved
+ */
+int hoistInvariants( IRFUNC * f, char * writesMemory );
+
+/* Function reduceStrength gives a derived
+ * induction variable of the loops of f, in SSA
+ * form, that is used other than to derive more
+ * a PHI of its own, which an addition steps
+ * through the loop instead of the arithmetic
+ * from the basic variable: if it takes a
+ * multiplication or more than one step, or if
+ * the basic variable then dies. A compare of a
+ * basic variable with an invariant becomes a
+ * compare of such a PHI that differs from it by
+ * an invariant, so that a basic variable used
+ * only to count is left dead. It returns the
+ * number of variables and compares replaced.
+ * The loops left to finish unrolled loops are
+ * not reduced
+ */
+int reduceStrength( IRFUNC * f );
+
+/* Function unrollLoops unrolls the innermost
+ * counted loops of f, before SSA: while loops
+ * that compare a local counter with an invariant
+ * bound and step it by a constant in their only
+ * latch. A loop of a small constant number of
+ * iterations is replaced by that many copies of
+ * its body; another whose body is one block gets
+ * a loop of factor copies before it, which it
+ * finishes in fewer trips. Loops grow only
+ * while the instructions added stay within
+ * *budget, which is decreased. It returns the
+ * number of loops unrolled
+ */
+int unrollLoops( IRFUNC * f, int factor, char * writesMemory, int * budget );
+
+#endif
@@ -16,7 +16,7 @@
 /* set NO_CODE to TRUE to get a compiler that does not
  * generate code
  */
-#define NO_CODE TRUE
+#define NO_CODE FALSE
 
 #include "util.h"
 #if NO_PARSE
@@ -26,7 +26,14 @@
 #if !NO_ANALYZE
 #include "analyze.h"
 #if !NO_CODE
+#include <limits.h>
 #include "cgen.h"
+#include "code.h"
+#include "ir.h"
+#include "irgen.h"
+#include "irinterp.h"
+#include "opt.h"
+#include "fold.h"
 #endif
 #endif
 #endif
@@ -43,17 +50,131 @@ int TraceScan = FALSE;
 int TraceParse = FALSE;
 int TraceAnalyze = FALSE; // print symbol table
 int TraceCode = FALSE;
+int TraceOpt = FALSE;
 
 int Error = FALSE;
 
+#if !NO_CODE
+/* with --run the program is compiled into memory
+ * and executed there by libtm, reading the values
+ * of input() from the standard input and writing
+ * those of output() to the standard output, one
+ * per line; the listing goes to the standard error
+ */
+int RunCode = FALSE;
+
+/* --ir generates the code from the IR instead of
+ * the syntax tree, --dump-ir prints the IR to the
+ * listing, and --interp executes the IR with the
+ * IR interpreter instead of generating code, for
+ * comparison with the TM run of the code. --opt
+ * optimizes the IR (and implies --ir)
+ */
+int UseIR = FALSE;
+int DumpIR = FALSE;
+int InterpIR = FALSE;
+int OptimizeIR = FALSE;
+
+/* the constants of the syntax tree are folded
+ * before code generation, unless --no-fold
+ */
+int FoldConstants = TRUE;
+
+/* --opt unrolls the counted loops by UnrollFactor,
+ * which --unroll=N sets; 1 turns unrolling off
+ */
+int UnrollFactor = 4;
+
+/* the memories of --run; dMem has the default
+ * size of tm, so programs run as they do there
+ */
+#define RUN_IADDR_SIZE 65536
+#define RUN_DADDR_SIZE 1024
+
+/* the instruction memory of tm by default, which
+ * the code written to a file is unrolled to fit
+ */
+#define TM_IADDR_SIZE 1024
+
+static int runInput( void * host, int * value )
+{ (void) host;
+  return (scanf("%d",value) == 1);
+} /* runInput */
+
+static void runOutput( void * host, int value )
+{ (void) host;
+  printf("%d\n",value);
+} /* runOutput */
+
+/* Function runProgram compiles syntaxTree, or
+ * irProg if not NULL, into memory and executes
+ * it, returning the exit status of cminus
+ */
+static int runProgram( TreeNode * syntaxTree, IRPROGRAM * irProg,
+                       char * pgm )
+{ PROGRAM * prog = newProgram(RUN_IADDR_SIZE);
+  MACHINE * mc;
+  STEPRESULT result;
+  long steps = 0;
+  emitProgram(prog);
+  if (irProg != NULL) irCodeGen(irProg,pgm,pgm);
+  else codeGen(syntaxTree,pgm,pgm);
+  if (Error) return 1;
+  fuseInstructions(prog);
+  mc = newMachine(prog,RUN_DADDR_SIZE);
+  setMachineIO(mc,runInput,runOutput,NULL);
+  result = runMachine(mc,LONG_MAX,&steps);
+  fflush(stdout);
+  if (result == srHALT) return 0;
+  fprintf(stderr,"%s: %s after %ld instructions\n",
+          pgm,stepResultTab[result],steps);
+  return 1;
+} /* runProgram */
+
+/* Function interpProgram executes irProg with the
+ * IR interpreter, on a memory of the size that
+ * runProgram uses, returning the exit status of
+ * cminus
+ */
+static int interpProgram( IRPROGRAM * irProg, char * pgm )
+{ STEPRESULT result;
+  long steps = 0;
+  result = irInterpret(irProg,RUN_DADDR_SIZE,runInput,runOutput,NULL,
+                       LONG_MAX,&steps);
+  fflush(stdout);
+  if (result == srHALT) return 0;
+  fprintf(stderr,"%s: %s after %ld IR instructions\n",
+          pgm,stepResultTab[result],steps);
+  return 1;
+} /* interpProgram */
+#endif
+
 main( int argc, char * argv[] )
 { TreeNode * syntaxTree;
   char pgm[120]; /* source code file name */
-  if (argc != 2)
-    { fprintf(stderr,"usage: %s <filename>\n",argv[0]);
+  int arg = 1;
+#if !NO_CODE
+  IRPROGRAM * irProg = NULL;
+  for ( ; (arg < argc) && (strncmp(argv[arg],"--",2) == 0); arg++)
+    if (strcmp(argv[arg],"--run") == 0) RunCode = TRUE;
+    else if (strcmp(argv[arg],"--ir") == 0) UseIR = TRUE;
+    else if (strcmp(argv[arg],"--dump-ir") == 0) DumpIR = TRUE;
+    else if (strcmp(argv[arg],"--interp") == 0) InterpIR = TRUE;
+    else if (strcmp(argv[arg],"--opt") == 0) UseIR = OptimizeIR = TRUE;
+    else if (strcmp(argv[arg],"--trace-opt") == 0) TraceOpt = TRUE;
+    else if (strcmp(argv[arg],"--no-fold") == 0) FoldConstants = FALSE;
+    else if ((strncmp(argv[arg],"--unroll=",9) == 0)
+             && (atoi(argv[arg]+9) >= 1))
+      UnrollFactor = atoi(argv[arg]+9);
+    else break;
+#endif
+  if (argc != arg + 1)
+    { fprintf(stderr,"usage: %s [--run] [--ir] [--opt] [--trace-opt] "
+                     "[--no-fold] [--unroll=N] [--dump-ir] [--interp] "
+                     "<filename>\n",argv[0]);
       exit(1);
     }
-  strcpy(pgm,argv[1]) ;
+  strcpy(pgm,argv[arg]) ;
   if (strchr (pgm, '.') == NULL)
      strcat(pgm,".tny");
   source = fopen(pgm,"r");
@@ -62,6 +183,10 @@ main( int argc, char * argv[] )
     exit(1);
   }
   listing = stdout; /* send listing to screen */
+#if !NO_CODE
+  if (RunCode || InterpIR) listing = stderr;
+  else
+#endif
   fprintf(listing,"\nC-MINUS COMPILATION: %s\n",pgm);
 #if NO_PARSE
   while (getToken()!=ENDFILE);
@@ -80,6 +205,22 @@ main( int argc, char * argv[] )
     if (TraceAnalyze) fprintf(listing,"\nType Checking Finished\n");
   }
 #if !NO_CODE
+  if (! Error && FoldConstants) foldConstants(syntaxTree);
+  if (! Error && (UseIR || DumpIR || InterpIR))
+  { irProg = irLower(syntaxTree);
+    if (OptimizeIR && ! Error)
+      irOptimize(irProg,UnrollFactor,
+                 (RunCode || InterpIR) ? RUN_IADDR_SIZE : TM_IADDR_SIZE);
+    if (DumpIR) irDump(listing,irProg);
+  }
+  if (InterpIR)
+  { fclose(source);
+    return Error ? 1 : interpProgram(irProg,pgm);
+  }
+  if (RunCode)
+  { fclose(source);
+    return Error ? 1 : runProgram(syntaxTree,UseIR ? irProg : NULL,pgm);
+  }
   if (! Error)
   { char * codefile;
     int fnlen = strcspn(pgm,".");
@@ -91,7 +232,8 @@ main( int argc, char * argv[] )
     { printf("Unable to open %s\n",codefile);
       exit(1);
     }
-    codeGen(syntaxTree,codefile);
+    if (UseIR) irCodeGen(irProg,codefile,pgm);
+    else codeGen(syntaxTree,codefile,pgm);
     fclose(code);
   }
 #endif
@@ -0,0 +1,141 @@
+/****************************************************/
+/* File: opt.c                                      */
+/* The IR optimizer of the C-Minus compiler         */
+/* (the order of the passes and their budgets)      */
+/****************************************************/
+
+#include "globals.h"
+#include "ir.h"
+#include "ssa.h"
+#include "gvn.h"
+#include "loop.h"
+#include "opt.h"
+
+/* Function findZeroGlobals returns a flag for each
+ * word of the global variables: nonzero if it is
+ * a scalar that is zero everywhere, because the
+ * TM starts with a zeroed memory and every store
+ * to it stores a CONST 0. Such variables are the
+ * switches of a program that are turned off
+ */
+static char * findZeroGlobals( IRPROGRAM * prog )
+{ char * zero = (char *) malloc(prog->globalSize+1);
+  IRARRAY * a;
+  IRFUNC * f;
+  IRINST ** def;
+  BLOCK * b;
+  IRINST * i;
+  int k;
+  memset(zero,TRUE,prog->globalSize+1);
+  for (a = prog->arrays; a != NULL; a = a->next)
+    for (k = 0; k < a->size; k++) zero[a->offset+k] = FALSE;
+  for (f = prog->funcs; f != NULL; f = f->next)
+  { def = (IRINST **) calloc(f->nregs+1,sizeof(IRINST *));
+    for (b = f->entry; b != NULL; b = b->next)
+      for (i = b->first; i != NULL; i = i->next)
+        if (i->dst != 0) def[i->dst] = i;
+    for (b = f->entry; b != NULL; b = b->next)
+      for (i = b->first; i != NULL; i = i->next)
+        if ((i->op == irSTOREG)
+            && ((def[i->a] == NULL) || (def[i->a]->op != irCONST)
+                || (def[i->a]->k != 0)))
+          zero[i->k] = FALSE;
+    free(def);
+  }
+  return zero;
+} /* findZeroGlobals */
+
+/* Function findMemoryWriters returns a flag for
+ * each function: nonzero if a call of it may
+ * store into the memory of its caller, the
+ * globals or an array, itself or by the
+ * functions it calls
+ */
+static char * findMemoryWriters( IRPROGRAM * prog )
+{ char * writes = (char *) calloc(prog->nfuncs+1,1);
+  IRFUNC * f;
+  BLOCK * b;
+  IRINST * i;
+  int changed;
+  do
+  { changed = FALSE;
+    for (f = prog->funcs; f != NULL; f = f->next)
+    { if (writes[f->id]) continue;
+      for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+          if ((i->op == irSTOREG) || (i->op == irSTORE)
+              || ((i->op == irCALL) && writes[i->callee->id]))
+            writes[f->id] = TRUE;
+      if (writes[f->id]) changed = TRUE;
+    }
+  } while (changed);
+  return writes;
+} /* findMemoryWriters */
+
+/* the code of an IR instruction takes about
+ * TM_PER_IR instructions of the TM; unrolling
+ * adds instructions only while the code of the
+ * program would fit in its instruction memory
+ */
+#define TM_PER_IR 3
+
+/* Function countInsts returns the number of
+ * instructions of f
+ */
+static int countInsts( IRFUNC * f )
+{ BLOCK * b;
+  IRINST * i;
+  int n = 0;
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next) n++;
+  return n;
+} /* countInsts */
+
+/* Procedure irOptimize optimizes the IR program
+ * prog, unrolling loops by unrollFactor within
+ * an instruction memory of iaddrSize
+ */
+void irOptimize( IRPROGRAM * prog, int unrollFactor, int iaddrSize )
+{ char * zeroGlobal = findZeroGlobals(prog);
+  char * writesMemory = findMemoryWriters(prog);
+  IRFUNC * f;
+  int budget = iaddrSize/TM_PER_IR;
+  int before, unrolled, folded, copies, numbered, hoisted, reduced, dead;
+  if (TraceOpt) fprintf(listing,"\nOptimizing the IR...\n");
+  for (f = prog->funcs; f != NULL; f = f->next) budget -= countInsts(f);
+  for (f = prog->funcs; f != NULL; f = f->next)
+  { before = countInsts(f);
+    unrolled = 0;
+    if (unrollFactor > 1)
+      unrolled = unrollLoops(f,unrollFactor,writesMemory,&budget);
+    buildSSA(f);
+    folded = propagateConstants(f,zeroGlobal);
+    copies = propagateCopies(f);
+    numbered = numberValues(f);
+    /* the loop passes look at every use, so the
+     * PHIs of values that die go first
+     */
+    dead = removeDeadCode(f,prog->arrays);
+    hoisted = hoistInvariants(f,writesMemory);
+    reduced = reduceStrength(f);
+    /* the starts and steps of the reduced variables
+     * go into preheaders that may lie in outer loops
+     */
+    if (reduced > 0)
+    { numbered += numberValues(f);
+      hoisted += hoistInvariants(f,writesMemory);
+    }
+    dead += removeDeadCode(f,prog->arrays);
+    leaveSSA(f);
+    irSimplifyCFG(f);
+    if (TraceOpt)
+      fprintf(listing,"%s: %d instructions before, %d after; "
+              "unrolled %d, sccp folded %d, copies propagated %d, "
+              "gvn removed %d, licm hoisted %d, strength reduced %d, "
+              "dead code %d\n",
+              f->name,before,countInsts(f),unrolled,folded,copies,numbered,
+              hoisted,reduced,dead);
+  }
+  free(zeroGlobal);
+  free(writesMemory);
+} /* irOptimize */
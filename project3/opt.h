@@ -0,0 +1,20 @@
+/****************************************************/
+/* File: opt.h                                      */
+/* The IR optimizer of the C-Minus compiler         */
+/* (the order of the passes and their budgets)      */
+/****************************************************/
+
+#ifndef _OPT_H_
+#define _OPT_H_
+
+/* Procedure irOptimize optimizes the IR program
+ * prog, reporting the work of each pass to the
+ * listing if TraceOpt is TRUE. Counted loops are
+ * unrolled by unrollFactor, not at all if it is
+ * 1, and fully if they are small, as long as the
+ * code fits in a TM instruction memory of
+ * iaddrSize
+ */
+void irOptimize( IRPROGRAM * prog, int unrollFactor, int iaddrSize );
+
+#endif
@@ -0,0 +1,349 @@
+/****************************************************/
+/* File: regalloc.c                                 */
+/* Linear-scan register allocation for the TM code  */
+/* of the IR                                        */
+/* (live intervals, spilling by loop depth)         */
+/****************************************************/
+
+#include "globals.h"
+#include "ir.h"
+#include "ssa.h"
+#include "loop.h"
+#include "regalloc.h"
+
+/* The instructions of a function are numbered in
+ * the order of its layout; instruction n reads
+ * its operands at position 2n and writes its
+ * result at 2n+1, so that a value it uses last
+ * may leave its register to the result. The live
+ * interval of a virtual register runs from the
+ * first position where it is live to the last,
+ * without holes. A call changes the caller-saved
+ * registers at the position of its result, which
+ * the intervals around it must not contain
+ */
+
+/* the weight of a use grows 8 times a loop, up
+ * to MAXDEPTH loops deep
+ */
+#define MAXDEPTH 4
+
+/* the interval of each virtual register, start
+ * -1 if it has none, and the weight of its uses
+ */
+static int * start;
+static int * end;
+static int * weight;
+
+/* the number of calls before each position, and
+ * the weights of the positions before it, as a
+ * use there weighs
+ */
+static int * callsBefore;
+static long * hotBefore;
+
+/* Procedure extend extends the interval of
+ * virtual register v to position p
+ */
+static void extend( int v, int p )
+{ if ((start[v] < 0) || (p < start[v])) start[v] = p;
+  if (p > end[v]) end[v] = p;
+} /* extend */
+
+/* Function crossesCall returns nonzero if a call
+ * is made inside the interval of v
+ */
+static int crossesCall( int v )
+{ return callsBefore[end[v]] > callsBefore[start[v]+1];
+} /* crossesCall */
+
+/* Procedure findLiveness computes the virtual
+ * registers live on entry to each block of f,
+ * and on exit from it, by block id
+ */
+static void findLiveness( IRFUNC * f, char ** liveIn, char ** liveOut )
+{ BLOCK ** blocks = (BLOCK **) malloc((f->nblocks+1)*sizeof(BLOCK *));
+  char ** gen = (char **) malloc((f->nblocks+1)*sizeof(char *));
+  char ** kill = (char **) malloc((f->nblocks+1)*sizeof(char *));
+  BLOCK * b;
+  IRINST * i;
+  int changed, in, out, n, r, j;
+  for (b = f->entry; b != NULL; b = b->next)
+  { n = b->id;
+    blocks[n] = b;
+    gen[n] = (char *) calloc(f->nregs+1,1);
+    kill[n] = (char *) calloc(f->nregs+1,1);
+    liveIn[n] = (char *) calloc(f->nregs+1,1);
+    liveOut[n] = (char *) calloc(f->nregs+1,1);
+    for (i = b->first; i != NULL; i = i->next)
+    { for (j = 0; j < irNumUses(i); j++)
+        if (! kill[n][*irUse(i,j)]) gen[n][*irUse(i,j)] = TRUE;
+      if (i->dst != 0) kill[n][i->dst] = TRUE;
+    }
+  }
+  do
+  { changed = FALSE;
+    for (n = f->nblocks-1; n >= 0; n--)
+    { b = blocks[n];
+      for (r = 1; r < f->nregs; r++)
+      { out = FALSE;
+        for (j = 0; j < b->nsucc; j++)
+          if (liveIn[b->succ[j]->id][r]) out = TRUE;
+        in = gen[n][r] || (out && ! kill[n][r]);
+        if ((in != liveIn[n][r]) || (out != liveOut[n][r]))
+        { liveIn[n][r] = in;
+          liveOut[n][r] = out;
+          changed = TRUE;
+        }
+      }
+    }
+  } while (changed);
+  for (n = 0; n < f->nblocks; n++)
+  { free(gen[n]);
+    free(kill[n]);
+  }
+  free(gen);
+  free(kill);
+  free(blocks);
+} /* findLiveness */
+
+/* Procedure findTested finds the compares that
+ * the branches ending their blocks compute
+ */
+static void findTested( REGALLOC * ra, IRFUNC * f )
+{ int * nUses = (int *) calloc(f->nregs+1,sizeof(int));
+  BLOCK * b;
+  IRINST * i, * p;
+  int j;
+  ra->tested = (IRINST **) calloc(f->nblocks+1,sizeof(IRINST *));
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+      for (j = 0; j < irNumUses(i); j++) nUses[*irUse(i,j)]++;
+  for (b = f->entry; b != NULL; b = b->next)
+  { if (b->last->op != irBRANCH) continue;
+    for (i = b->first; i != b->last; i = i->next)
+    { if ((i->op < irLT) || (i->op > irNE) || (i->dst != b->last->a)
+          || (nUses[i->dst] != 1))
+        continue;
+      for (p = i->next; p != b->last; p = p->next)
+        if ((p->dst == i->a) || (p->dst == i->b)) break;
+      if (p == b->last) ra->tested[b->id] = i;
+    }
+  }
+  free(nUses);
+} /* findTested */
+
+/* Function blockDepths returns the loop depth of
+ * each block of f, by block id
+ */
+static int * blockDepths( IRFUNC * f )
+{ int * depth = (int *) calloc(f->nblocks+1,sizeof(int));
+  LOOP * loops, * l;
+  int n;
+  findDominators(f);
+  loops = findLoops(f);
+  for (l = loops; l != NULL; l = l->next)
+    for (n = 0; n < f->nblocks; n++)
+      if (l->inLoop[n] && (l->depth > depth[n])) depth[n] = l->depth;
+  freeLoops(loops);
+  return depth;
+} /* blockDepths */
+
+/* Function buildIntervals computes the live
+ * intervals of the virtual registers of f, the
+ * weights of their uses, and the calls and the
+ * weights before each position. It returns the number of
+ * positions
+ */
+static int buildIntervals( REGALLOC * ra, IRFUNC * f )
+{ char ** liveIn = (char **) malloc((f->nblocks+1)*sizeof(char *));
+  char ** liveOut = (char **) malloc((f->nblocks+1)*sizeof(char *));
+  int * depth = blockDepths(f);
+  BLOCK * b;
+  IRINST * i, * c;
+  int n, npos, w, r, j;
+  findTested(ra,f);
+  findLiveness(f,liveIn,liveOut);
+  npos = 0;
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next) npos += 2;
+  callsBefore = (int *) calloc(npos+1,sizeof(int));
+  hotBefore = (long *) calloc(npos+1,sizeof(long));
+  n = 0;
+  for (b = f->entry; b != NULL; b = b->next)
+  { for (w = 1, j = 0; (j < depth[b->id]) && (j < MAXDEPTH); j++) w *= 8;
+    for (r = 1; r < f->nregs; r++)
+      if (liveIn[b->id][r]) extend(r,2*n);
+    c = ra->tested[b->id];
+    for (i = b->first; i != NULL; i = i->next, n++)
+    { hotBefore[2*n+1] = hotBefore[2*n+2] = w;
+      if (i == c) continue;
+      if ((i->op == irBRANCH) && (c != NULL))
+      { extend(c->a,2*n);
+        extend(c->b,2*n);
+        weight[c->a] += w;
+        weight[c->b] += w;
+        continue;
+      }
+      for (j = 0; j < irNumUses(i); j++)
+      { extend(*irUse(i,j),2*n);
+        weight[*irUse(i,j)] += w;
+      }
+      if (i->dst != 0)
+      { extend(i->dst,2*n+1);
+        weight[i->dst] += w;
+      }
+      if (i->op == irCALL) callsBefore[2*n+2] = 1;
+    }
+    for (r = 1; r < f->nregs; r++)
+      if (liveOut[b->id][r]) extend(r,2*n-1);
+  }
+  for (n = 1; n <= npos; n++)
+  { callsBefore[n] += callsBefore[n-1];
+    hotBefore[n] += hotBefore[n-1];
+  }
+  for (n = 0; n < f->nblocks; n++)
+  { free(liveIn[n]);
+    free(liveOut[n]);
+  }
+  free(liveIn);
+  free(liveOut);
+  free(depth);
+  return npos;
+} /* buildIntervals */
+
+/* Function hotLength returns the length of the
+ * interval of v, its positions weighed as uses
+ * there: a register held through a loop is the
+ * more costly, the deeper the loop
+ */
+static long hotLength( int v )
+{ return hotBefore[end[v]+1] - hotBefore[start[v]];
+} /* hotLength */
+
+/* Function lighter returns nonzero if the uses of
+ * u weigh less for the hot length of its
+ * interval than those of v, or as much and it
+ * ends later
+ */
+static int lighter( int u, int v )
+{ long wu = weight[u] * hotLength(v);
+  long wv = weight[v] * hotLength(u);
+  return (wu < wv) || ((wu == wv) && (end[u] > end[v]));
+} /* lighter */
+
+/* Procedure linearScan assigns the intervals, in
+ * order of their starts, to the registers free
+ * at their starts. Without one, the lightest of
+ * the interval and those holding a register it
+ * may take is spilled
+ */
+static void linearScan( REGALLOC * ra, int * order )
+{ int holder[LASTREG+1];
+  int k, r, v, u, lo, victim, victimReg;
+  for (r = 0; r <= LASTREG; r++) holder[r] = 0;
+  for (k = 0; k < ra->nintervals; k++)
+  { v = order[k];
+    for (r = FIRSTREG; r <= LASTREG; r++)
+      if ((holder[r] != 0) && (end[holder[r]] < start[v])) holder[r] = 0;
+    lo = crossesCall(v) ? FIRSTSAVED : FIRSTREG;
+    for (r = lo; (r <= LASTREG) && (holder[r] != 0); r++) ;
+    if (r > LASTREG)
+    { victim = v;
+      victimReg = NOREG;
+      for (r = lo; r <= LASTREG; r++)
+      { u = holder[r];
+        if (lighter(u,victim))
+        { victim = u;
+          victimReg = r;
+        }
+      }
+      ra->reg[victim] = NOREG;
+      ra->nspilled++;
+      if (victim == v) continue;
+      r = victimReg;
+    }
+    ra->reg[v] = r;
+    holder[r] = v;
+    if (r >= FIRSTSAVED) ra->saved[r] = TRUE;
+  }
+} /* linearScan */
+
+/* Procedure assignSpills gives the spilled
+ * intervals words of the spill area, sharing a
+ * word among intervals that do not overlap
+ */
+static void assignSpills( REGALLOC * ra, int * order )
+{ int * wordEnd = (int *) malloc((ra->nintervals+1)*sizeof(int));
+  int k, v, w;
+  for (k = 0; k < ra->nintervals; k++)
+  { v = order[k];
+    if (ra->reg[v] != NOREG) continue;
+    for (w = 0; (w < ra->nspills) && (wordEnd[w] >= start[v]); w++) ;
+    if (w == ra->nspills) ra->nspills++;
+    wordEnd[w] = end[v];
+    ra->spill[v] = w;
+  }
+  free(wordEnd);
+} /* assignSpills */
+
+/* Procedure findBusy marks the registers that
+ * hold a value across each instruction
+ */
+static void findBusy( REGALLOC * ra, int npos, int nregs )
+{ int v, p;
+  ra->busy = (char *) calloc(npos/2+1,1);
+  for (v = 1; v < nregs; v++)
+    if ((start[v] >= 0) && (ra->reg[v] != NOREG))
+      for (p = start[v]/2; p <= end[v]/2; p++) ra->busy[p] |= 1 << ra->reg[v];
+} /* findBusy */
+
+/* Function allocRegisters assigns the virtual
+ * registers of f to TM registers
+ */
+REGALLOC * allocRegisters( IRFUNC * f )
+{ REGALLOC * ra = (REGALLOC *) calloc(1,sizeof(REGALLOC));
+  int * order, * count;
+  int npos, v;
+  ra->reg = (int *) malloc((f->nregs+1)*sizeof(int));
+  ra->spill = (int *) calloc(f->nregs+1,sizeof(int));
+  start = (int *) malloc((f->nregs+1)*sizeof(int));
+  end = (int *) malloc((f->nregs+1)*sizeof(int));
+  weight = (int *) calloc(f->nregs+1,sizeof(int));
+  for (v = 0; v <= f->nregs; v++)
+  { ra->reg[v] = NOREG;
+    start[v] = end[v] = -1;
+  }
+  npos = buildIntervals(ra,f);
+  /* sort the intervals by their starts */
+  count = (int *) calloc(npos+1,sizeof(int));
+  order = (int *) malloc((f->nregs+1)*sizeof(int));
+  for (v = 1; v < f->nregs; v++)
+    if (start[v] >= 0)
+    { count[start[v]+1]++;
+      ra->nintervals++;
+    }
+  for (v = 1; v <= npos; v++) count[v] += count[v-1];
+  for (v = 1; v < f->nregs; v++)
+    if (start[v] >= 0) order[count[start[v]]++] = v;
+  linearScan(ra,order);
+  assignSpills(ra,order);
+  findBusy(ra,npos,f->nregs);
+  free(count);
+  free(order);
+  free(start);
+  free(end);
+  free(weight);
+  free(callsBefore);
+  free(hotBefore);
+  return ra;
+} /* allocRegisters */
+
+/* Procedure freeRegAlloc frees an allocation */
+void freeRegAlloc( REGALLOC * ra )
+{ free(ra->reg);
+  free(ra->spill);
+  free(ra->busy);
+  free(ra->tested);
+  free(ra);
+} /* freeRegAlloc */
@@ -0,0 +1,59 @@
+/****************************************************/
+/* File: regalloc.h                                 */
+/* Register allocation for the TM code of the IR    */
+/* (TM registers of the virtual registers)          */
+/****************************************************/
+
+#ifndef _REGALLOC_H_
+#define _REGALLOC_H_
+
+/* The TM registers given to virtual registers:
+ * ac is left to the code as its scratch
+ * register, and fp, gp, mp and pc keep their
+ * roles. ac1 is caller-saved: a call may change
+ * it, so it only holds values that are not live
+ * across a call. The registers from FIRSTSAVED
+ * are callee-saved: a function that uses them
+ * saves them on entry and restores them when it
+ * returns
+ */
+#define FIRSTREG 1
+#define FIRSTSAVED 2
+#define LASTREG 3
+
+/* the register of a virtual register in memory */
+#define NOREG (-1)
+
+typedef struct
+   { int * reg;                /* TM register of each, or NOREG */
+     int * spill;              /* word of the spill area of a NOREG one */
+     int nspills;              /* words of the spill area */
+     int saved[LASTREG+1];     /* nonzero if a callee-saved one is used */
+     char * busy;              /* bit r set: r is live across instruction */
+     IRINST ** tested;         /* by block id: the compare its branch */
+                               /* computes, or NULL */
+     int nintervals;           /* virtual registers with a live interval */
+     int nspilled;             /* of them, those left in memory */
+   } REGALLOC;
+
+/* Function allocRegisters assigns the virtual
+ * registers of f, which has no PHIs, to TM
+ * registers by a linear scan of their live
+ * intervals over the layout of f. When the
+ * registers run out, the interval whose uses,
+ * counted more deeply in loops, weigh least for
+ * the code it spans is spilled to the frame for
+ * its whole life;
+ * intervals that do not overlap share the words
+ * of the spill area. A compare used only by the
+ * branch ending its block, whose operands are
+ * not changed in between, is left to the branch
+ * to compute: it takes no register, and its
+ * operands are live up to the branch
+ */
+REGALLOC * allocRegisters( IRFUNC * f );
+
+/* Procedure freeRegAlloc frees an allocation */
+void freeRegAlloc( REGALLOC * ra );
+
+#endif
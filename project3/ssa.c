@@ -0,0 +1,795 @@
+/****************************************************/
+/* File: ssa.c                                      */
+/* Static single assignment form of the IR and the  */
+/* optimizations on it                              */
+/* (dominators, construction and leaving, constant  */
+/* and copy propagation, dead code)                 */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "ir.h"
+#include "ssa.h"
+
+/********************************************/
+/*          D O M I N A T O R S             */
+/********************************************/
+
+/* Function intersect returns the nearest common
+ * dominator of a and b (Cooper, Harvey and
+ * Kennedy)
+ */
+static BLOCK * intersect( BLOCK * a, BLOCK * b )
+{ while (a != b)
+  { while (a->rpo > b->rpo) a = a->idom;
+    while (b->rpo > a->rpo) b = b->idom;
+  }
+  return a;
+} /* intersect */
+
+/* Procedure findDominators builds the dominator
+ * tree of f
+ */
+void findDominators( IRFUNC * f )
+{ int n = f->nblocks, top = 0, cnt = n, changed, j;
+  BLOCK ** order = (BLOCK **) malloc((n+1)*sizeof(BLOCK *));
+  BLOCK ** stack = (BLOCK **) malloc((n+1)*sizeof(BLOCK *));
+  int * nextSucc = (int *) calloc(n+1,sizeof(int));
+  char * seen = (char *) calloc(n+1,1);
+  BLOCK * b, * s, * d;
+  for (b = f->entry; b != NULL; b = b->next)
+  { b->idom = b->child = b->sibling = NULL;
+    b->rpo = n;
+  }
+  /* number the blocks in reverse postorder */
+  stack[top++] = f->entry;
+  seen[f->entry->id] = TRUE;
+  while (top > 0)
+  { b = stack[top-1];
+    if (nextSucc[b->id] < b->nsucc)
+    { s = b->succ[nextSucc[b->id]++];
+      if (! seen[s->id])
+      { seen[s->id] = TRUE;
+        stack[top++] = s;
+      }
+    }
+    else
+    { top--;
+      b->rpo = --cnt;
+      order[cnt] = b;
+    }
+  }
+  /* iterate to the immediate dominators */
+  f->entry->idom = f->entry;
+  do
+  { changed = FALSE;
+    for (j = 1; j < n; j++)
+    { b = order[j];
+      d = NULL;
+      for (top = 0; top < b->npred; top++)
+        if (b->pred[top]->idom != NULL)
+          d = (d == NULL) ? b->pred[top] : intersect(b->pred[top],d);
+      if (b->idom != d)
+      { b->idom = d;
+        changed = TRUE;
+      }
+    }
+  } while (changed);
+  f->entry->idom = NULL;
+  for (j = n-1; j > 0; j--)
+  { b = order[j];
+    b->sibling = b->idom->child;
+    b->idom->child = b;
+  }
+  free(order);
+  free(stack);
+  free(nextSucc);
+  free(seen);
+} /* findDominators */
+
+/********************************************/
+/*      S S A   C O N S T R U C T I O N     */
+/********************************************/
+
+/* the variables of the function put into SSA
+ * form: the frame words that LOADL and STOREL
+ * access, numbered by -offset
+ */
+static char * isVar;
+static int nVarWords;
+
+/* cur[v] is the register holding the value of
+ * variable v during renaming; the changes are
+ * logged to be undone when leaving a block
+ */
+static int * cur;
+static int * logVar;
+static int * logReg;
+static int logTop;
+
+/* subst[r] replaces register r, 0 if none */
+static int * subst;
+
+/* Function isPromoted returns nonzero if i loads
+ * or stores a variable of the SSA form
+ */
+static int isPromoted( IRINST * i )
+{ return ((i->op == irLOADL) || (i->op == irSTOREL))
+         && (-i->k >= 0) && (-i->k < nVarWords) && isVar[-i->k];
+} /* isPromoted */
+
+/* Procedure setCur makes r the value of variable v */
+static void setCur( int v, int r )
+{ logVar[logTop] = v;
+  logReg[logTop] = cur[v];
+  logTop++;
+  cur[v] = r;
+} /* setCur */
+
+/* Procedure renameBlock renames the variables in b
+ * and in the blocks it dominates
+ */
+static void renameBlock( BLOCK * b )
+{ IRINST * i, * next;
+  BLOCK * s;
+  int saved = logTop, j, m;
+  for (i = b->first; i != NULL; i = next)
+  { next = i->next;
+    if (i->op == irPHI)
+    { setCur(-i->k,i->dst);
+      continue;
+    }
+    for (j = 0; j < irNumUses(i); j++)
+      if (subst[*irUse(i,j)] != 0) *irUse(i,j) = subst[*irUse(i,j)];
+    if (! isPromoted(i)) continue;
+    if (i->op == irLOADL) subst[i->dst] = cur[-i->k];
+    else setCur(-i->k,i->a);
+    irRemove(i);
+    irFreeInst(i);
+  }
+  for (j = 0; j < b->nsucc; j++)
+  { s = b->succ[j];
+    for (i = s->first; (i != NULL) && (i->op == irPHI); i = i->next)
+      for (m = 0; m < i->nargs; m++)
+        if ((i->from[m] == b) && (i->args[m] == 0))
+          i->args[m] = cur[-i->k];
+  }
+  for (s = b->child; s != NULL; s = s->sibling) renameBlock(s);
+  while (logTop > saved)
+  { logTop--;
+    cur[logVar[logTop]] = logReg[logTop];
+  }
+} /* renameBlock */
+
+/* Procedure addFrontier adds block y to the
+ * dominance frontier list of x
+ */
+static void addFrontier( BLOCK *** df, int * ndf, BLOCK * x, BLOCK * y )
+{ int j;
+  for (j = 0; j < ndf[x->id]; j++)
+    if (df[x->id][j] == y) return;
+  df[x->id] = (BLOCK **) realloc(df[x->id],(ndf[x->id]+1)*sizeof(BLOCK *));
+  df[x->id][ndf[x->id]++] = y;
+} /* addFrontier */
+
+/* Procedure buildSSA puts f into SSA form */
+void buildSSA( IRFUNC * f )
+{ int n = f->nblocks, v, j, top, nInsts = 0;
+  BLOCK *** df = (BLOCK ***) calloc(n+1,sizeof(BLOCK **));
+  int * ndf = (int *) calloc(n+1,sizeof(int));
+  BLOCK ** work = (BLOCK **) malloc((n+1)*sizeof(BLOCK *));
+  int * hasPhi = (int *) calloc(n+1,sizeof(int));
+  int * inWork = (int *) calloc(n+1,sizeof(int));
+  char ** varName;
+  IRINST ** entryDef;
+  BLOCK * b, * r;
+  IRINST * i, * phi;
+  findDominators(f);
+  /* the variables */
+  nVarWords = f->frameSize;
+  isVar = (char *) calloc(nVarWords+1,1);
+  varName = (char **) calloc(nVarWords+1,sizeof(char *));
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+    { nInsts++;
+      if (((i->op == irLOADL) || (i->op == irSTOREL))
+          && (-i->k >= 0) && (-i->k < nVarWords))
+      { isVar[-i->k] = TRUE;
+        varName[-i->k] = i->name;
+      }
+    }
+  /* the dominance frontiers */
+  for (b = f->entry; b != NULL; b = b->next)
+    if (b->npred >= 2)
+      for (j = 0; j < b->npred; j++)
+        for (r = b->pred[j]; r != b->idom; r = r->idom)
+          addFrontier(df,ndf,r,b);
+  /* place the PHIs of each variable */
+  for (v = 0; v < nVarWords; v++)
+  { if (! isVar[v]) continue;
+    top = 0;
+    work[top++] = f->entry;
+    inWork[f->entry->id] = v+1;
+    for (b = f->entry; b != NULL; b = b->next)
+      for (i = b->first; i != NULL; i = i->next)
+        if ((i->op == irSTOREL) && (i->k == -v) && (inWork[b->id] != v+1))
+        { inWork[b->id] = v+1;
+          work[top++] = b;
+        }
+    while (top > 0)
+    { b = work[--top];
+      for (j = 0; j < ndf[b->id]; j++)
+      { r = df[b->id][j];
+        if (hasPhi[r->id] == v+1) continue;
+        hasPhi[r->id] = v+1;
+        phi = irNewInst(irPHI,irNewReg(f),0,0,-v);
+        phi->name = varName[v];
+        phi->lineno = r->first->lineno;
+        phi->nargs = r->npred;
+        phi->args = (int *) calloc(r->npred+1,sizeof(int));
+        phi->from = (BLOCK **) malloc((r->npred+1)*sizeof(BLOCK *));
+        memcpy(phi->from,r->pred,r->npred*sizeof(BLOCK *));
+        irInsertBefore(r->first,phi);
+        nInsts++;
+        if (inWork[r->id] != v+1)
+        { inWork[r->id] = v+1;
+          work[top++] = r;
+        }
+      }
+    }
+  }
+  /* the values on entry: parameters are loaded
+   * from the frame, other variables start at 0
+   */
+  cur = (int *) calloc(nVarWords+1,sizeof(int));
+  entryDef = (IRINST **) calloc(nVarWords+1,sizeof(IRINST *));
+  for (v = 0; v < nVarWords; v++)
+    if (isVar[v])
+    { if ((-v <= ofsParams) && (-v > ofsParams - f->nparams))
+        entryDef[v] = irNewInst(irLOADL,irNewReg(f),0,0,-v);
+      else
+        entryDef[v] = irNewInst(irCONST,irNewReg(f),0,0,0);
+      entryDef[v]->name = varName[v];
+      entryDef[v]->lineno = f->lineno;
+      cur[v] = entryDef[v]->dst;
+    }
+  /* rename */
+  subst = (int *) calloc(f->nregs+1,sizeof(int));
+  logVar = (int *) malloc((nInsts+1)*sizeof(int));
+  logReg = (int *) malloc((nInsts+1)*sizeof(int));
+  logTop = 0;
+  renameBlock(f->entry);
+  for (v = nVarWords-1; v >= 0; v--)
+    if (entryDef[v] != NULL)
+    { if (f->entry->first == NULL) irAppend(f->entry,entryDef[v]);
+      else irInsertBefore(f->entry->first,entryDef[v]);
+    }
+  for (j = 0; j < n; j++) free(df[j]);
+  free(df);
+  free(ndf);
+  free(work);
+  free(hasPhi);
+  free(inWork);
+  free(isVar);
+  free(varName);
+  free(entryDef);
+  free(cur);
+  free(subst);
+  free(logVar);
+  free(logReg);
+} /* buildSSA */
+
+/* Function copiesDirectly returns nonzero if the
+ * PHI i can become copies into its own register
+ * at the ends of its predecessors: none of them
+ * has another successor, and no later PHI of the
+ * block reads the register (the copies of the
+ * earlier ones come first)
+ */
+static int copiesDirectly( IRINST * i )
+{ IRINST * j;
+  int m;
+  for (m = 0; m < i->nargs; m++)
+    if (i->from[m]->nsucc != 1) return FALSE;
+  for (j = i->next; (j != NULL) && (j->op == irPHI); j = j->next)
+    for (m = 0; m < j->nargs; m++)
+      if (j->args[m] == i->dst) return FALSE;
+  return TRUE;
+} /* copiesDirectly */
+
+/* Function coalesce returns nonzero if it made
+ * the instruction p that defines register a at
+ * the end of block b define d instead, which it
+ * can when a has no other use and d is not used
+ * after p in b
+ */
+static int coalesce( BLOCK * b, IRINST * p, int a, int d, int * nuses )
+{ IRINST * i;
+  int j;
+  if ((p == NULL) || (p->block != b) || (p->op == irPHI) || (nuses[a] != 1))
+    return FALSE;
+  for (i = p->next; i != NULL; i = i->next)
+  { if (i->dst == d) return FALSE;
+    for (j = 0; j < irNumUses(i); j++)
+      if (*irUse(i,j) == d) return FALSE;
+  }
+  p->dst = d;
+  return TRUE;
+} /* coalesce */
+
+/* Procedure leaveSSA replaces the PHIs of f by
+ * copies. Where the copies cannot go straight
+ * into the register of a PHI, it gets a register
+ * of its own that every predecessor sets before
+ * its last instruction, and the PHI becomes a
+ * copy of it, so that the PHIs of a block still
+ * take their values together
+ */
+void leaveSSA( IRFUNC * f )
+{ IRINST ** def = (IRINST **) calloc(f->nregs+1,sizeof(IRINST *));
+  int * nuses = (int *) calloc(f->nregs+1,sizeof(int));
+  BLOCK * b, * p;
+  IRINST * i, * c, * next;
+  int t, m;
+#ifndef NDEBUG
+  /* the copies go into the blocks the PHIs name */
+  irCheckPhis(f);
+#endif
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+    { if (i->dst != 0) def[i->dst] = i;
+      for (m = 0; m < irNumUses(i); m++) nuses[*irUse(i,m)]++;
+    }
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; (i != NULL) && (i->op == irPHI); i = next)
+    { next = i->next;
+      if (copiesDirectly(i))
+      { for (m = 0; m < i->nargs; m++)
+        { p = i->from[m];
+          if ((i->args[m] == i->dst)
+              || coalesce(p,def[i->args[m]],i->args[m],i->dst,nuses))
+            continue;
+          c = irNewInst(irCOPY,i->dst,i->args[m],0,0);
+          c->lineno = p->last->lineno;
+          irInsertBefore(p->last,c);
+        }
+        def[i->dst] = NULL;
+        irRemove(i);
+        irFreeInst(i);
+        continue;
+      }
+      t = irNewReg(f);
+      for (m = 0; m < i->nargs; m++)
+      { c = irNewInst(irCOPY,t,i->args[m],0,0);
+        c->lineno = i->from[m]->last->lineno;
+        irInsertBefore(i->from[m]->last,c);
+      }
+      free(i->args);
+      free(i->from);
+      i->args = NULL;
+      i->from = NULL;
+      i->nargs = 0;
+      i->op = irCOPY;
+      i->a = t;
+    }
+  free(def);
+  free(nuses);
+} /* leaveSSA */
+
+/********************************************/
+/*  C O N S T A N T   P R O P A G A T I O N */
+/********************************************/
+
+/* the lattice of the value of a register */
+#define TOP       0   /* no value seen yet */
+#define CONSTANT  1   /* always val[r] */
+#define BOTTOM    2   /* varies */
+
+static char * lat;
+static int * val;
+
+/* the instructions using each register r are
+ * useList[useStart[r]..useStart[r+1]-1]
+ */
+static int * useStart;
+static IRINST ** useList;
+
+/* the executable blocks and edges, edge n of
+ * block b being number 2*b->id+n
+ */
+static char * blockExec;
+static char * edgeExec;
+
+/* the work lists */
+static int * edgeWork;
+static int edgeTop;
+static IRINST ** instWork;
+static int instTop, instSize;
+
+/* Procedure lower lowers the value of r to l, v
+ * and queues the uses of r if it changed
+ */
+static void lower( int r, int l, int v )
+{ int j;
+  if ((l == lat[r]) && ((l != CONSTANT) || (v == val[r]))) return;
+  if (l < lat[r]) return;
+  if ((l == CONSTANT) && (lat[r] == CONSTANT)) l = BOTTOM;
+  lat[r] = l;
+  val[r] = v;
+  for (j = useStart[r]; j < useStart[r+1]; j++)
+  { if (instTop == instSize)
+    { instSize *= 2;
+      instWork = (IRINST **) realloc(instWork,instSize*sizeof(IRINST *));
+    }
+    instWork[instTop++] = useList[j];
+  }
+} /* lower */
+
+/* Procedure markEdge queues edge n of b */
+static void markEdge( BLOCK * b, int n )
+{ if (! edgeExec[2*b->id+n]) edgeWork[edgeTop++] = 2*b->id+n;
+} /* markEdge */
+
+/* Function edgeExecutable returns nonzero if an
+ * edge from p to b is executable
+ */
+static int edgeExecutable( BLOCK * p, BLOCK * b )
+{ return ((p->nsucc > 0) && (p->succ[0] == b) && edgeExec[2*p->id])
+      || ((p->nsucc > 1) && (p->succ[1] == b) && edgeExec[2*p->id+1]);
+} /* edgeExecutable */
+
+/* Procedure visit evaluates i over the lattice */
+static void visit( IRINST * i, char * zeroGlobal )
+{ int j, l, v, la, lb;
+  switch (i->op)
+  { case irCONST :
+      lower(i->dst,CONSTANT,i->k);
+      break;
+    case irCOPY :
+      lower(i->dst,lat[i->a],val[i->a]);
+      break;
+    case irADD :
+    case irSUB :
+    case irMUL :
+    case irDIV :
+    case irLT :
+    case irLE :
+    case irGT :
+    case irGE :
+    case irEQ :
+    case irNE :
+      la = lat[i->a];
+      lb = lat[i->b];
+      if ((la == BOTTOM) || (lb == BOTTOM)) lower(i->dst,BOTTOM,0);
+      else if ((la == CONSTANT) && (lb == CONSTANT))
+      { if (irFold(i->op,val[i->a],val[i->b],&v))
+          lower(i->dst,CONSTANT,v);
+        else
+          lower(i->dst,BOTTOM,0); /* left to fault at run time */
+      }
+      break;
+    case irPHI :
+      l = TOP;
+      v = 0;
+      for (j = 0; j < i->nargs; j++)
+      { if (! edgeExecutable(i->from[j],i->block)) continue;
+        la = lat[i->args[j]];
+        if (la == TOP) continue;
+        if ((la == BOTTOM) || ((l == CONSTANT) && (val[i->args[j]] != v)))
+        { l = BOTTOM;
+          break;
+        }
+        l = CONSTANT;
+        v = val[i->args[j]];
+      }
+      lower(i->dst,l,v);
+      break;
+    case irLOADG :
+      if ((zeroGlobal != NULL) && zeroGlobal[i->k])
+        lower(i->dst,CONSTANT,0);
+      else
+        lower(i->dst,BOTTOM,0);
+      break;
+    case irJUMP :
+      markEdge(i->block,0);
+      break;
+    case irBRANCH :
+      if (lat[i->a] == CONSTANT) markEdge(i->block,val[i->a] ? 0 : 1);
+      else if (lat[i->a] == BOTTOM)
+      { markEdge(i->block,0);
+        markEdge(i->block,1);
+      }
+      break;
+    default :
+      if (i->dst != 0) lower(i->dst,BOTTOM,0);
+      break;
+  }
+} /* visit */
+
+/* Function propagateConstants performs sparse
+ * conditional constant propagation on f
+ * (Wegman and Zadeck)
+ */
+int propagateConstants( IRFUNC * f, char * zeroGlobal )
+{ int n = f->nblocks, nregs = f->nregs, j, e, folded = 0;
+  BLOCK ** byId = (BLOCK **) malloc((n+1)*sizeof(BLOCK *));
+  BLOCK * b;
+  IRINST * i, * next, * at, * phiConsts;
+  lat = (char *) calloc(nregs+1,1);
+  val = (int *) calloc(nregs+1,sizeof(int));
+  blockExec = (char *) calloc(n+1,1);
+  edgeExec = (char *) calloc(2*n+2,1);
+  edgeWork = (int *) malloc((2*n+2)*sizeof(int));
+  edgeTop = 0;
+  instSize = 64;
+  instWork = (IRINST **) malloc(instSize*sizeof(IRINST *));
+  instTop = 0;
+  /* the uses of each register */
+  useStart = (int *) calloc(nregs+2,sizeof(int));
+  for (b = f->entry; b != NULL; b = b->next)
+  { byId[b->id] = b;
+    for (i = b->first; i != NULL; i = i->next)
+      for (j = 0; j < irNumUses(i); j++) useStart[*irUse(i,j)+1]++;
+  }
+  for (j = 1; j <= nregs; j++) useStart[j] += useStart[j-1];
+  useList = (IRINST **) malloc((useStart[nregs]+1)*sizeof(IRINST *));
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+      for (j = 0; j < irNumUses(i); j++)
+        useList[useStart[*irUse(i,j)]++] = i;
+  for (j = nregs; j > 0; j--) useStart[j] = useStart[j-1];
+  useStart[0] = 0;
+  /* register 0 is no value */
+  lat[0] = BOTTOM;
+  /* propagate from the entry */
+  blockExec[f->entry->id] = TRUE;
+  for (i = f->entry->first; i != NULL; i = i->next) visit(i,zeroGlobal);
+  while ((edgeTop > 0) || (instTop > 0))
+  { while (edgeTop > 0)
+    { e = edgeWork[--edgeTop];
+      if (edgeExec[e]) continue;
+      edgeExec[e] = TRUE;
+      b = byId[e/2]->succ[e%2];
+      if (! blockExec[b->id])
+      { blockExec[b->id] = TRUE;
+        for (i = b->first; i != NULL; i = i->next) visit(i,zeroGlobal);
+      }
+      else
+        for (i = b->first; (i != NULL) && (i->op == irPHI); i = i->next)
+          visit(i,zeroGlobal);
+    }
+    while (instTop > 0)
+    { i = instWork[--instTop];
+      if (blockExec[i->block->id]) visit(i,zeroGlobal);
+    }
+  }
+  /* rewrite */
+  for (b = f->entry; b != NULL; b = b->next)
+  { if (! blockExec[b->id]) continue;
+    phiConsts = NULL;
+    for (i = b->first; i != NULL; i = next)
+    { next = i->next;
+      if ((i->dst != 0) && (lat[i->dst] == CONSTANT) && (i->op != irCONST))
+      { if (i->op == irPHI)
+        { /* moved after the PHIs that are left */
+          irRemove(i);
+          i->next = phiConsts;
+          phiConsts = i;
+        }
+        free(i->args);
+        free(i->from);
+        i->args = NULL;
+        i->from = NULL;
+        i->nargs = 0;
+        i->op = irCONST;
+        i->a = i->b = 0;
+        i->k = val[i->dst];
+        folded++;
+      }
+      else if ((i->op == irBRANCH) && (lat[i->a] == CONSTANT))
+      { b->succ[0] = b->succ[val[i->a] ? 0 : 1];
+        i->op = irJUMP;
+        i->a = 0;
+        folded++;
+      }
+    }
+    for (at = b->first; at->op == irPHI; at = at->next) ;
+    while (phiConsts != NULL)
+    { next = phiConsts->next;
+      irInsertBefore(at,phiConsts);
+      phiConsts = next;
+    }
+  }
+  irBuildCFG(f);
+  free(byId);
+  free(lat);
+  free(val);
+  free(blockExec);
+  free(edgeExec);
+  free(edgeWork);
+  free(instWork);
+  free(useStart);
+  free(useList);
+  return folded;
+} /* propagateConstants */
+
+/* Function findRepl returns the register that
+ * replaces r, following the chain in repl
+ */
+static int findRepl( int * repl, int r )
+{ while (repl[r] != 0) r = repl[r];
+  return r;
+} /* findRepl */
+
+/* Function propagateCopies replaces the uses of
+ * the value of a COPY, or of a PHI whose
+ * arguments are all one register (or the PHI
+ * itself), by that register
+ */
+int propagateCopies( IRFUNC * f )
+{ int * repl = (int *) calloc(f->nregs+1,sizeof(int));
+  int changed, same, x, j, replaced = 0;
+  BLOCK * b;
+  IRINST * i;
+  do
+  { changed = FALSE;
+    for (b = f->entry; b != NULL; b = b->next)
+      for (i = b->first; i != NULL; i = i->next)
+      { if ((i->dst == 0) || (repl[i->dst] != 0)) continue;
+        if (i->op == irCOPY) same = findRepl(repl,i->a);
+        else if (i->op == irPHI)
+        { same = 0;
+          for (j = 0; j < i->nargs; j++)
+          { x = findRepl(repl,i->args[j]);
+            if (x == i->dst) continue;
+            if (same == 0) same = x;
+            else if (x != same) break;
+          }
+          if (j < i->nargs) same = 0;
+        }
+        else same = 0;
+        if ((same != 0) && (same != i->dst))
+        { repl[i->dst] = same;
+          changed = TRUE;
+        }
+      }
+  } while (changed);
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+      for (j = 0; j < irNumUses(i); j++)
+        if (repl[*irUse(i,j)] != 0)
+        { *irUse(i,j) = findRepl(repl,*irUse(i,j));
+          replaced++;
+        }
+  free(repl);
+  return replaced;
+} /* propagateCopies */
+
+/********************************************/
+/*         D E A D   C O D E                */
+/********************************************/
+
+/* Function inArray returns nonzero if the word
+ * at offset k lies in one of arrays
+ */
+static int inArray( IRARRAY * arrays, long k )
+{ IRARRAY * a;
+  for (a = arrays; a != NULL; a = a->next)
+    if ((k >= a->offset) && (k < a->offset + a->size)) return TRUE;
+  return FALSE;
+} /* inArray */
+
+/* Function loadsInBounds returns nonzero if the
+ * LOAD i reads a constant element of an array
+ * of f, or of globals if it is global, which
+ * cannot fault
+ */
+static int loadsInBounds( IRINST * i, IRINST ** def, IRFUNC * f,
+                          IRARRAY * globals )
+{ IRINST * base = def[i->a], * index = NULL, * t;
+  long k;
+  if ((base != NULL) && (base->op == irADD))
+  { index = def[base->b];
+    base = def[base->a];
+    if ((base != NULL) && (base->op == irCONST))
+    { t = base;
+      base = index;
+      index = t;
+    }
+    if ((index == NULL) || (index->op != irCONST)) return FALSE;
+  }
+  if (base == NULL) return FALSE;
+  k = (long) base->k + ((index != NULL) ? index->k : 0);
+  if (base->op == irADDRG) return inArray(globals,k);
+  if (base->op == irADDRL) return inArray(f->arrays,k);
+  return FALSE;
+} /* loadsInBounds */
+
+/* Function isCritical returns nonzero if i must
+ * be kept whether its value is used or not, def
+ * giving the instruction defining each register
+ * of f, whose global arrays are globals
+ */
+static int isCritical( IRINST * i, IRINST ** def, IRFUNC * f,
+                       IRARRAY * globals )
+{ switch (i->op)
+  { case irSTOREL :
+    case irSTOREG :
+    case irSTORE :
+    case irIN :
+    case irOUT :
+    case irCALL :
+    case irRET :
+    case irJUMP :
+    case irBRANCH :
+      return TRUE;
+    case irDIV :
+      /* unless it cannot divide by zero */
+      return (def[i->b] == NULL) || (def[i->b]->op != irCONST)
+             || (def[i->b]->k == 0);
+    case irLOAD :
+      /* unless it cannot fault */
+      return ! loadsInBounds(i,def,f,globals);
+    default :
+      return FALSE;
+  }
+} /* isCritical */
+
+/* Function removeDeadCode deletes the instructions
+ * of f whose values are never used and that have
+ * no effect, globals being the global arrays
+ */
+int removeDeadCode( IRFUNC * f, IRARRAY * globals )
+{ int nregs = f->nregs, top = 0, j, r, removed = 0;
+  IRINST ** def = (IRINST **) calloc(nregs+1,sizeof(IRINST *));
+  char * live = (char *) calloc(nregs+1,1);
+  int * work;
+  BLOCK * b;
+  IRINST * i, * next, * dead = NULL;
+  int nuses = 0;
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+    { if (i->dst != 0) def[i->dst] = i;
+      nuses += irNumUses(i);
+    }
+  /* the uses of a critical instruction with a live
+   * value are pushed twice
+   */
+  work = (int *) malloc((2*nuses+1)*sizeof(int));
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = i->next)
+      if (isCritical(i,def,f,globals))
+        for (j = 0; j < irNumUses(i); j++) work[top++] = *irUse(i,j);
+  while (top > 0)
+  { r = work[--top];
+    if (live[r]) continue;
+    live[r] = TRUE;
+    if (def[r] == NULL) continue;
+    for (j = 0; j < irNumUses(def[r]); j++) work[top++] = *irUse(def[r],j);
+  }
+  /* the dead instructions are freed only after the
+   * sweep, as isCritical looks at their values
+   */
+  for (b = f->entry; b != NULL; b = b->next)
+    for (i = b->first; i != NULL; i = next)
+    { next = i->next;
+      if ((i->dst == 0) || live[i->dst]) continue;
+      if (i->op == irCALL)
+        i->dst = 0; /* the call stays, its value is not stored */
+      else if (! isCritical(i,def,f,globals))
+      { irRemove(i);
+        i->next = dead;
+        dead = i;
+        removed++;
+      }
+    }
+  while (dead != NULL)
+  { next = dead->next;
+    irFreeInst(dead);
+    dead = next;
+  }
+  free(def);
+  free(live);
+  free(work);
+  return removed;
+} /* removeDeadCode */
@@ -0,0 +1,64 @@
+/****************************************************/
+/* File: ssa.h                                      */
+/* Static single assignment form of the IR and the  */
+/* optimizations on it                              */
+/* (dominators, construction and leaving, constant  */
+/* and copy propagation, dead code)                 */
+/****************************************************/
+
+#ifndef _SSA_H_
+#define _SSA_H_
+
+/* In SSA form the scalar local variables and the
+ * parameters of a function no longer live in its
+ * frame: every value of them is a register that
+ * is defined once, and a PHI at the head of a
+ * block selects among the values reaching it
+ */
+
+/* Procedure findDominators builds the dominator
+ * tree of f: the idom, child, sibling and rpo
+ * fields of its blocks
+ */
+void findDominators( IRFUNC * f );
+
+/* Procedure buildSSA puts f into SSA form, placing
+ * the PHIs at the dominance frontiers of the
+ * stores of each variable
+ */
+void buildSSA( IRFUNC * f );
+
+/* Procedure leaveSSA replaces the PHIs of f by
+ * copies at the ends of the predecessors
+ */
+void leaveSSA( IRFUNC * f );
+
+/* Function propagateConstants performs sparse
+ * conditional constant propagation on f in SSA
+ * form: registers with a constant value become
+ * CONSTs, branches on a constant become jumps,
+ * and the blocks that cannot execute are deleted.
+ * zeroGlobal[k] is nonzero if the global variable
+ * at gp+k is zero everywhere. It returns the
+ * number of instructions and branches folded
+ */
+int propagateConstants( IRFUNC * f, char * zeroGlobal );
+
+/* Function propagateCopies replaces the uses of
+ * the value of a COPY, or of a PHI that selects
+ * one value only, by the register copied,
+ * returning the number of uses replaced; the
+ * copies are left to removeDeadCode
+ */
+int propagateCopies( IRFUNC * f );
+
+/* Function removeDeadCode deletes the instructions
+ * of f whose values are never used and that have
+ * no effect, returning their number. A LOAD that
+ * may fault has an effect: it is deleted only if
+ * it reads a constant element of a local array
+ * or of one of the global arrays globals
+ */
+int removeDeadCode( IRFUNC * f, IRARRAY * globals );
+
+#endif
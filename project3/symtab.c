@@ -83,7 +83,7 @@ static ScopePointer currentScope;
  * by setting the current scope as the global scope
  */
 void initSymtab() {
-  globalScope = (ScopePointer)malloc(sizeof(struct Scope));
+  globalScope = (ScopePointer)calloc(1, sizeof(struct Scope));
   globalScope->name="global";
   globalScope->level = 1;
   globalScope->next = NULL;
@@ -141,7 +141,7 @@ BucketPointer findInScope(char * name, char* kind)
  */
 int* checkPredefined(char* name, char* kind, int lineno) {
   BucketPointer b = findInScope(name, kind);
-  LineList l = b->lines;
+  LineList l = (b != NULL) ? b->lines : NULL;
 
   int capacity = 4;
   int* list = (int*)malloc(sizeof(int)*capacity);
@@ -230,16 +230,16 @@ void addNode( char * name, char* kind, char * type, int lineno)
  */
 void addParamType(char * functionName, int paramLocation, char* paramType) {
   BucketPointer func = findInSymbolTable(functionName, "Function");
-  ParamTypePointer p = func->params;
-  while(p != NULL) p = p->next;
+  ParamTypePointer last = func->params;
+  while(last != NULL && last->next != NULL) last = last->next;
 
-  p = (ParamTypePointer)malloc(sizeof(struct ParamType));
+  ParamTypePointer p = (ParamTypePointer)malloc(sizeof(struct ParamType));
   p->type = paramType;
   p->loc = paramLocation;
   p->next = NULL;
 
-  if(func->params == NULL) func->params = p;
-  else func->params->next = p; 
+  if(last == NULL) func->params = p;
+  else last->next = p;
 }
 
 /* Function checkParam
@@ -291,7 +291,7 @@ void insertScope(char* scopeName)
   }
 
   // initialize
-  ScopePointer newScope = (ScopePointer) malloc(sizeof(struct Scope));
+  ScopePointer newScope = (ScopePointer) calloc(1, sizeof(struct Scope));
   newScope->name = newScopeName;
   newScope->level = currentScope->level + 1;
   newScope->next = NULL;
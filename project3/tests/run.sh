@@ -0,0 +1,40 @@
+#!/bin/sh
+# File: run.sh
+# Test of the code paths of the compiler: each
+# test program NAME.cm is compiled and run by
+# cminus --run through the syntax-tree code
+# generator, the IR and its TM backend, the IR
+# interpreter and the IR optimizer, reading
+# NAME.in. Every run must print NAME.out, which
+# holds the output of the program compiled as C.
+#
+# usage: sh tests/run.sh [program.cm ...]
+# from the directory of cminus
+
+CMINUS=${CMINUS:-./cminus}
+TESTS=`dirname $0`
+WORK=${TMPDIR:-/tmp}/run$$
+mkdir -p $WORK || exit 1
+trap 'rm -rf $WORK' 0
+
+if [ $# -eq 0 ]; then set -- $TESTS/*.cm; fi
+
+failed=0
+for src in "$@"; do
+  name=`basename $src .cm`
+  input=/dev/null
+  [ -f $TESTS/$name.in ] && input=$TESTS/$name.in
+  for mode in "--run" "--ir --run" "--interp" "--opt --run" \
+              "--opt --interp" "--opt --unroll=1 --run" \
+              "--no-fold --opt --run"; do
+    $CMINUS $mode $src < $input > $WORK/out 2> $WORK/err
+    if ! cmp -s $TESTS/$name.out $WORK/out; then
+      echo "FAIL $name $mode"
+      diff $TESTS/$name.out $WORK/out | head -5
+      head -3 $WORK/err
+      failed=1
+    fi
+  done
+done
+[ $failed -eq 0 ] && echo "run: all passed"
+exit $failed
@@ -0,0 +1,187 @@
+/****************************************************/
+/* File: snaptest.c                                 */
+/* Test of the snapshots of libtm: branches runs    */
+/* of a TM program from snapshots of a machine      */
+/****************************************************/
+
+/* usage: snaptest prog.tm [input file]
+ *
+ * The program runs once to the end, and then again
+ * from snapshots taken at NSPLITS points spread
+ * over that run: each snapshot is restored twice,
+ * from memory and from a file, and the rest of
+ * the run must give the same output, step
+ * result and instruction count as the first run.
+ * The input is read into memory, so its position
+ * goes back with the snapshot
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../libtm.h"
+
+#define   ISIZE     65536
+#define   DSIZE     1024
+#define   MAXVALUES 4096
+#define   NSPLITS   7
+
+/* the host of the machine: its input and output */
+typedef struct
+   { int in[MAXVALUES];
+     int nin, pos;
+     int out[MAXVALUES];
+     int nout;
+   } HOST;
+
+static int hostInput( void * host, int * value )
+{ HOST * h = (HOST *) host;
+  if (h->pos >= h->nin) return 0;
+  *value = h->in[h->pos++];
+  return 1;
+} /* hostInput */
+
+static void hostOutput( void * host, int value )
+{ HOST * h = (HOST *) host;
+  if (h->nout < MAXVALUES) h->out[h->nout++] = value;
+} /* hostOutput */
+
+static long hostTell( void * host )
+{ return ((HOST *) host)->pos;
+} /* hostTell */
+
+static void hostSeek( void * host, long pos )
+{ ((HOST *) host)->pos = (int) pos;
+} /* hostSeek */
+
+/* Function readFile returns the text of the file
+ * name, exiting if it cannot be read
+ */
+static char * readFile( char * name )
+{ FILE * f = fopen(name,"rb");
+  char * text;
+  long n;
+  if (f == NULL)
+  { fprintf(stderr,"snaptest: cannot open %s\n",name);
+    exit(2);
+  }
+  fseek(f,0,SEEK_END);
+  n = ftell(f);
+  rewind(f);
+  text = (char *) malloc(n+1);
+  n = (long) fread(text,1,n,f);
+  text[n] = '\0';
+  fclose(f);
+  return text;
+} /* readFile */
+
+/* Function finish runs mc to the end and returns
+ * the step result; *steps counts on
+ */
+static STEPRESULT finish( MACHINE * mc, long * steps )
+{ return runMachine(mc,1L << 40,steps);
+} /* finish */
+
+/* Function check compares the rest of a run from
+ * a snapshot with the first run, returning 0 and
+ * printing what differs if it is not the same
+ */
+static int check( char * what, long at, HOST * h, HOST * ref,
+                  STEPRESULT r, STEPRESULT refResult,
+                  long steps, long refSteps )
+{ if ( (r == refResult) && (steps == refSteps) && (h->nout == ref->nout)
+       && (memcmp(h->out,ref->out,ref->nout * sizeof(int)) == 0) )
+    return 1;
+  printf("snaptest: %s at step %ld differs: %s after %ld steps, "
+         "%d values (expected %s after %ld, %d values)\n",
+         what,at,stepResultTab[r],steps,h->nout,
+         stepResultTab[refResult],refSteps,ref->nout);
+  return 0;
+} /* check */
+
+int main( int argc, char * argv[] )
+{ static HOST ref, h;
+  char msg[TM_MSGSIZE];
+  char snapFile[] = "snaptestXXXXXX";
+  PROGRAM * prog;
+  MACHINE * mc;
+  SNAPSHOT * snap, * fromFile, * base = NULL;
+  STEPRESULT refResult, r;
+  long refSteps = 0, at, steps;
+  int k, fd, outAt, ok = 1;
+  FILE * f;
+  if ((argc < 2) || (argc > 3))
+  { fprintf(stderr,"usage: %s prog.tm [input file]\n",argv[0]);
+    return 2;
+  }
+  prog = newProgram(ISIZE);
+  if (! loadProgram(prog,readFile(argv[1]),NULL,NULL,msg))
+  { fprintf(stderr,"snaptest: %s\n",msg);
+    return 2;
+  }
+  if ((argc == 3) && ((f = fopen(argv[2],"r")) != NULL))
+  { while ((ref.nin < MAXVALUES) && (fscanf(f,"%d",&ref.in[ref.nin]) == 1))
+      ref.nin++;
+    fclose(f);
+  }
+  memcpy(h.in,ref.in,sizeof(ref.in));
+  h.nin = ref.nin;
+  mc = newMachine(prog,DSIZE);
+  setMachineIO(mc,hostInput,hostOutput,&ref);
+  setMachineInputPos(mc,hostTell,hostSeek);
+  refResult = finish(mc,&refSteps);
+  fd = mkstemp(snapFile);
+  if (fd < 0)
+  { fprintf(stderr,"snaptest: no temporary file\n");
+    return 2;
+  }
+  close(fd);
+  setMachineIO(mc,hostInput,hostOutput,&h);
+  for (k = 1; ok && (k <= NSPLITS); k++)
+  { at = refSteps * k / (NSPLITS + 1);
+    h.nout = 0;
+    h.pos = 0;
+    clearMachine(mc);
+    steps = 0;
+    if (runMachine(mc,at,&steps) != srLIMIT) continue;
+    snap = saveSnapshot(mc,base);
+    if (! writeSnapshot(snap,snapFile))
+    { fprintf(stderr,"snaptest: cannot write %s\n",snapFile);
+      return 2;
+    }
+    fromFile = readSnapshot(snapFile);
+    /* run on, then twice again from the snapshot */
+    outAt = h.nout;
+    r = finish(mc,&steps);
+    ok = check("run",at,&h,&ref,r,refResult,steps,refSteps);
+    h.nout = outAt;
+    if (ok && restoreSnapshot(mc,snap))
+    { steps = at;
+      r = finish(mc,&steps);
+      ok = check("memory snapshot",at,&h,&ref,r,refResult,steps,refSteps);
+    }
+    else if (ok)
+    { printf("snaptest: snapshot at step %ld refused\n",at);
+      ok = 0;
+    }
+    h.nout = outAt;
+    if (ok && (fromFile != NULL) && restoreSnapshot(mc,fromFile))
+    { steps = at;
+      r = finish(mc,&steps);
+      ok = check("file snapshot",at,&h,&ref,r,refResult,steps,refSteps);
+    }
+    else if (ok)
+    { printf("snaptest: file snapshot at step %ld refused\n",at);
+      ok = 0;
+    }
+    freeSnapshot(base);
+    freeSnapshot(fromFile);
+    base = snap;
+  }
+  freeSnapshot(base);
+  remove(snapFile);
+  freeMachine(mc);
+  freeProgram(prog);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#!/bin/sh
+# File: tmdiff.sh
+# Differential test of the TM execution engines:
+# the code of each test program, as cminus
+# generates it with and without the IR optimizer,
+# runs on the interpreter with superinstructions,
+# without them and with the JIT. The output, the
+# instruction count and the registers at the end
+# must be the same for all three. If tm2c is built,
+# the C program it translates the code into must
+# print the same output and instruction count.
+# If tmtrace is built, the binary trace of a run
+# must hold a record for every instruction.
+# If tests/snaptest is built, it checks that runs
+# of the code continued from libtm snapshots end
+# as the whole run does.
+#
+# usage: sh tests/tmdiff.sh [program.cm ...]
+# from the directory of cminus and tm
+
+CMINUS=${CMINUS:-./cminus}
+TM=${TM:-./tm}
+TM2C=${TM2C:-./tm2c}
+TMTRACE=${TMTRACE:-./tmtrace}
+CC=${CC:-cc}
+TESTS=`dirname $0`
+# cminus names the code file by the source file
+# up to its first '.', so WORK has none
+WORK=${TMPDIR:-/tmp}/tmdiff$$
+mkdir -p $WORK || exit 1
+trap 'rm -rf $WORK' 0
+
+if [ $# -eq 0 ]; then set -- $TESTS/*.cm; fi
+
+failed=0
+for src in "$@"; do
+  name=`basename $src .cm`
+  for flags in "" "--ir" "--opt"; do
+    cp $src $WORK/$name.cm
+    rm -f $WORK/$name.tm
+    $CMINUS $flags $WORK/$name.cm > $WORK/$name.lst 2>&1
+    if [ ! -s $WORK/$name.tm ]; then
+      echo "FAIL $name $flags: cminus failed"
+      failed=1
+      continue
+    fi
+    input=`cat $TESTS/$name.in 2>/dev/null`
+    # the toggle of each engine is dropped from its
+    # transcript before comparing
+    for engine in "" f j; do
+      { echo p
+        [ -n "$engine" ] && echo $engine
+        echo g
+        [ -n "$input" ] && echo "$input"
+        echo r
+        echo q
+      } | $TM $WORK/$name.tm 2>&1 \
+        | grep -v "now o[nf]" > $WORK/$name.run$engine
+    done
+    for engine in f j; do
+      if ! cmp -s $WORK/$name.run $WORK/$name.run$engine; then
+        echo "FAIL $name $flags: tm with $engine differs"
+        diff $WORK/$name.run $WORK/$name.run$engine | head -5
+        failed=1
+      fi
+    done
+    if [ -x $TMTRACE ]; then
+      { echo g
+        [ -n "$input" ] && echo "$input"
+        echo q
+      } | $TM --btrace $WORK/$name.bt $WORK/$name.tm > /dev/null 2>&1
+      count=`grep -o "instructions executed = [0-9]*" $WORK/$name.run \
+             | sed 's/.* //'`
+      records=`$TMTRACE --count $WORK/$name.bt`
+      if [ "$records" != "$count" ]; then
+        echo "FAIL $name $flags: $records trace records for $count steps"
+        failed=1
+      fi
+      rm -f $WORK/$name.bt
+    fi
+    if [ -x $TESTS/snaptest ] \
+       && ! $TESTS/snaptest $WORK/$name.tm $TESTS/$name.in; then
+      echo "FAIL $name $flags: snapshots"
+      failed=1
+    fi
+    [ -x $TM2C ] || continue
+    if ! $TM2C $WORK/$name.tm $WORK/$name.c \
+         || ! $CC -O1 -w $WORK/$name.c -o $WORK/$name.exe; then
+      echo "FAIL $name $flags: tm2c translation failed"
+      failed=1
+      continue
+    fi
+    echo "$input" | $WORK/$name.exe -p > $WORK/$name.c.run 2>&1
+    # the two print the count in different places
+    for run in $WORK/$name.run $WORK/$name.c.run; do
+      { grep -o -e "OUT instruction prints: .*" -e "HALT: .*" $run
+        grep -o "instructions executed.*" $run
+      } > $run.out
+    done
+    if ! cmp -s $WORK/$name.run.out $WORK/$name.c.run.out; then
+      echo "FAIL $name $flags: the tm2c translation differs"
+      diff $WORK/$name.run.out $WORK/$name.c.run.out | head -5
+      failed=1
+    fi
+  done
+done
+[ $failed -eq 0 ] && echo "tmdiff: all passed"
+exit $failed
@@ -9,6 +9,33 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include "libtm.h"
+
+/* batch runs and the fork server need POSIX threads,
+ * processes, sockets and memory streams
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#define POSIX_AVAILABLE 1
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#else
+#define POSIX_AVAILABLE 0
+#endif
+
+/* the JIT translates to x86-64 and needs mmap */
+#if defined(__x86_64__) && defined(__unix__) && !defined(NO_JIT)
+#define JIT_AVAILABLE 1
+#include <sys/mman.h>
+#else
+#define JIT_AVAILABLE 0
+#endif
 
 #ifndef TRUE
 #define TRUE 1
@@ -18,90 +45,121 @@
 #endif
 
 /******* const *******/
-#define   IADDR_SIZE  1024 /* increase for large programs */
-#define   DADDR_SIZE  1024 /* increase for large programs */
-#define   NO_REGS 8
-#define   PC_REG  7
+#define   IADDR_SIZE  1024 /* default, --imem overrides */
+#define   DADDR_SIZE  1024 /* default, --dmem overrides */
+#define   MAXADDR_SIZE (1 << 28) /* largest --imem or --dmem */
+/* registers given roles by the C-Minus code generator */
+#define   FP_REG  4
+#define   GP_REG  5
+#define   MP_REG  6
 
 #define   LINESIZE  121
 #define   WORDSIZE  20
 
+#define   PROFILE_TOP  20 /* entries of each profile ranking */
+
+/* DMEM_FAULT is the data address check of stepTM
+ * for the machines of the simulator
+ */
+#define   DMEM_FAULT(m) (((m) < 0) || ((m) >= daddrSize))
+
 /******* type  *******/
 
-typedef enum {
-   opclRR,     /* reg operands r,s,t */
-   opclRM,     /* reg r, mem d+s */
-   opclRA      /* reg r, int d+s */
-   } OPCLASS;
-
-typedef enum {
-   /* RR instructions */
-   opHALT,    /* RR     halt, operands are ignored */
-   opIN,      /* RR     read into reg(r); s and t are ignored */
-   opOUT,     /* RR     write from reg(r), s and t are ignored */
-   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
-   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
-   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
-   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
-   opRRLim,   /* limit of RR opcodes */
-
-   /* RM instructions */
-   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
-   opST,      /* RM     mem(d+reg(s)) = reg(r) */
-   opRMLim,   /* Limit of RM opcodes */
-
-   /* RA instructions */
-   opLDA,     /* RA     reg(r) = d+reg(s) */
-   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
-   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
-   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
-   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
-   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
-   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
-   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
-   opRALim    /* Limit of RA opcodes */
-   } OPCODE;
-
-typedef enum {
-   srOKAY,
-   srHALT,
-   srIMEM_ERR,
-   srDMEM_ERR,
-   srZERODIVIDE
-   } STEPRESULT;
-
-typedef struct {
-      int iop  ;
-      int iarg1  ;
-      int iarg2  ;
-      int iarg3  ;
-   } INSTRUCTION;
+/* the files a machine of the batch runs or the
+ * fork server reads with IN and writes with OUT;
+ * the interactive machine uses the terminal
+ */
+typedef struct
+   { FILE * in;
+     FILE * out;
+   } FILEIO;
 
 /******** vars ********/
 int iloc = 0 ;
 int dloc = 0 ;
 int traceflag = FALSE;
 int icountflag = FALSE;
+int jitflag = FALSE;
+
+int iaddrSize = IADDR_SIZE;
+int daddrSize = DADDR_SIZE;
+
+PROGRAM * program;  /* the program of the code file */
+INSTRUCTION * iMem; /* its instructions */
+int iCount = 0;     /* one past the highest location loaded */
+
+/* the source program, from the "*@" comments the
+ * compiler writes into the code file: the line of
+ * each location that starts one (plus 1, 0 at the
+ * others) and the functions in order of location
+ */
+typedef struct
+   { int loc;
+     char * name;
+   } FUNCMARK;
+
+char * srcName = NULL;
+int * lineMark;
+FUNCMARK * funcTab = NULL;
+int funcCount = 0;
+
+/* the arrays marked by "*@array" */
+typedef struct
+   { char * name;
+     int func;     /* function of a local array, -1 if global */
+     int offset;   /* of element 0, from gp or fp */
+     int size;
+   } ARRAYMARK;
+
+ARRAYMARK * arrayTab = NULL;
+int arrayCount = 0;
 
-INSTRUCTION iMem [IADDR_SIZE];
-int dMem [DADDR_SIZE];
-int reg [NO_REGS];
+/* the instructions that call ("*@call") and
+ * return from ("*@ret") functions
+ */
+typedef enum { mkNONE, mkCALL, mkRET } CALLMARK;
 
-char * opCodeTab[]
-        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV","????",
-            /* RR opcodes */
-           "LD","ST","????", /* RM opcodes */
-           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
-           /* RA opcodes */
-          };
+unsigned char * callMark;
+int callCount = 0;
 
-char * stepResultTab[]
-        = {"OK","Halted","Instruction Memory Fault",
-           "Data Memory Fault","Division by 0"
-          };
+/* the profile: executions of each location and,
+ * for the conditional jumps, how many were taken
+ */
+int profileflag = FALSE;
+char * profileName = NULL;
+char * flameName = NULL;
+long * execCnt;
+long * takenCnt;
+
+/* the call stacks of the profile: a tree of
+ * frames, each a function called from the frame
+ * of its parent, with the instructions executed
+ * in it. The root is the prelude
+ */
+typedef struct FrameNode
+   { int func;                   /* in funcTab, -1 for the prelude */
+     long self;                  /* instructions executed */
+     struct FrameNode * parent;
+     struct FrameNode * child;   /* first callee */
+     struct FrameNode * sibling; /* next callee of parent */
+   } FRAMENODE;
+
+FRAMENODE frameRoot = { -1, 0, NULL, NULL, NULL };
+FRAMENODE * curFrame = &frameRoot;
+int callPending = FALSE; /* the last instruction was a call */
+
+MACHINE * machine;  /* the machine of the interactive simulator */
+
+/* the values typed for IN while time travel is on;
+ * replays read them again from inputNext on
+ */
+int * inputLog = NULL;
+int inputCount = 0;
+int inputSize = 0;
+int inputNext = 0;
+long checkInterval = 0; /* --checkpoint; 0: time travel off */
 
 char pgmName[20];
-FILE *pgm  ;
 
 char in_Line[LINESIZE] ;
 int lineLen ;
@@ -112,16 +170,144 @@ char ch  ;
 int done  ;
 
 /********************************************/
-int opClass( int c )
-{ if      ( c <= opRRLim) return ( opclRR );
-  else if ( c <= opRMLim) return ( opclRM );
-  else                    return ( opclRA );
-} /* opClass */
+/* Procedure logInput appends v to the input log
+ */
+void logInput( int v )
+{ if (inputCount == inputSize)
+  { inputSize = (inputSize > 0) ? 2 * inputSize : 64;
+    inputLog = (int *) realloc(inputLog, inputSize * sizeof(int));
+    if (inputLog == NULL)
+    { printf("Out of memory for the input log\n");
+      exit(1);
+    }
+  }
+  inputLog[inputCount++] = v;
+  inputNext = inputCount;
+} /* logInput */
+
+/********************************************/
+/*        B I N A R Y   T R A C E           */
+/********************************************/
+/* With --btrace file every instruction executed
+ * is recorded, before it executes, as a TRACEREC
+ * of 16 bytes. With --ring n the records go to a
+ * ring buffer of the last n instructions, which
+ * is written to the file when the simulation
+ * ends; without it the records are written to
+ * the file as the buffer fills. The file is the
+ * header (TRACE_MAGIC and the count of the first
+ * record) and the records, in the byte order of
+ * the host; tmtrace decodes it
+ */
+
+#define   TRACE_MAGIC   "TMTRACE"
+#define   TRACE_BUFFER  4096 /* records buffered when streaming */
+
+typedef struct
+   { int pc;
+     unsigned char op;
+     unsigned char r;  /* register operand r */
+     short unused;
+     int a;   /* RR: reg(s), IN and OUT: reg(r);
+                 RM, RA: d+reg(s), LDC: d */
+     int b;   /* RR: reg(t); LD: the word loaded;
+                 ST, jumps: reg(r) */
+   } TRACEREC;
+
+int btraceflag = FALSE;
+char * btraceName = NULL;
+long btraceRing = 0;         /* --ring; 0: stream */
+static FILE * btraceFile = NULL;
+static TRACEREC * btraceBuf = NULL;
+static long btraceSize;      /* records in btraceBuf */
+static long btraceCount = 0; /* records made */
+
+/********************************************/
+/* Procedure traceStep records the instruction at
+ * pc of mc before it executes
+ */
+static void traceStep( MACHINE * mc, int pc )
+{ INSTRUCTION * i = &mc->prog->iMem[pc];
+  TRACEREC * t = &btraceBuf[btraceCount % btraceSize];
+  t->pc = pc;
+  t->op = i->iop;
+  t->r = i->iarg1;
+  t->unused = 0;
+  switch (opClass(i->iop))
+  { case opclRR :
+      if ( (i->iop == opIN) || (i->iop == opOUT) )
+        t->a = t->b = mc->reg[i->iarg1];
+      else
+      { t->a = mc->reg[i->iarg2];
+        t->b = mc->reg[i->iarg3];
+      }
+      break;
+    default :
+      t->a = (i->iop == opLDC) ? i->iarg2 : i->iarg2 + mc->reg[i->iarg3];
+      if (i->iop != opLD) t->b = mc->reg[i->iarg1];
+      else if (DMEM_FAULT(t->a)) t->b = 0;
+      else t->b = mc->dMem[t->a];
+      break;
+  }
+  btraceCount++;
+  if ( (btraceRing == 0) && (btraceCount % btraceSize == 0) )
+    fwrite(btraceBuf, sizeof(TRACEREC), btraceSize, btraceFile);
+} /* traceStep */
+
+/********************************************/
+/* Procedure openTrace opens btraceName; with
+ * streaming the header goes out at once
+ */
+void openTrace (void)
+{ long first = 0;
+  btraceFile = fopen(btraceName,"wb");
+  btraceSize = (btraceRing > 0) ? btraceRing : TRACE_BUFFER;
+  btraceBuf = (TRACEREC *) malloc(btraceSize * sizeof(TRACEREC));
+  if ( (btraceFile == NULL) || (btraceBuf == NULL) )
+  { printf("Unable to trace to %s\n",btraceName);
+    exit(1);
+  }
+  if (btraceRing == 0)
+  { fwrite(TRACE_MAGIC,1,sizeof(TRACE_MAGIC),btraceFile);
+    fwrite(&first,sizeof(first),1,btraceFile);
+  }
+  btraceflag = TRUE;
+} /* openTrace */
+
+/********************************************/
+/* Procedure closeTrace writes the records still
+ * buffered, oldest first, and closes the file
+ */
+void closeTrace (void)
+{ long first, k;
+  if (btraceRing == 0)
+    fwrite(btraceBuf, sizeof(TRACEREC), btraceCount % btraceSize, btraceFile);
+  else
+  { first = (btraceCount > btraceSize) ? btraceCount - btraceSize : 0;
+    fwrite(TRACE_MAGIC,1,sizeof(TRACE_MAGIC),btraceFile);
+    fwrite(&first,sizeof(first),1,btraceFile);
+    for (k = first; k < btraceCount; k++)
+      fwrite(&btraceBuf[k % btraceSize], sizeof(TRACEREC), 1, btraceFile);
+  }
+  fclose(btraceFile);
+} /* closeTrace */
+
+/********************************************/
+/* Function memorySize converts a --imem or --dmem
+ * argument, returning 0 if it is not a size in
+ * 1..MAXADDR_SIZE
+ */
+int memorySize( char * arg )
+{ char * end;
+  long n = strtol(arg, &end, 10);
+  if ( (*end != '\0') || (n < 1) || (n > MAXADDR_SIZE) ) return 0;
+  return (int) n;
+} /* memorySize */
 
 /********************************************/
 void writeInstruction ( int loc )
 { printf( "%5d: ", loc) ;
-  if ( (loc >= 0) && (loc < IADDR_SIZE) )
+  if ( (loc >= 0) && (loc < iaddrSize) )
   { printf("%6s%3d,", opCodeTab[iMem[loc].iop], iMem[loc].iarg1);
     switch ( opClass(iMem[loc].iop) )
     { case opclRR: printf("%1d,%1d", iMem[loc].iarg2, iMem[loc].iarg3);
@@ -210,199 +396,1691 @@ int atEOL(void)
 } /* atEOL */
 
 /********************************************/
-int error( char * msg, int lineNo, int instNo)
-{ printf("Line %d",lineNo);
-  if (instNo >= 0) printf(" (Instruction %d)",instNo);
-  printf("   %s\n",msg);
-  return FALSE;
-} /* error */
-
-/********************************************/
-int readInstructions (void)
-{ OPCODE op;
-  int arg1, arg2, arg3;
-  int loc, regNo, lineNo;
-  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
-      reg[regNo] = 0 ;
-  dMem[0] = DADDR_SIZE - 1 ;
-  for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-      dMem[loc] = 0 ;
-  for (loc = 0 ; loc < IADDR_SIZE ; loc++)
-  { iMem[loc].iop = opHALT ;
-    iMem[loc].iarg1 = 0 ;
-    iMem[loc].iarg2 = 0 ;
-    iMem[loc].iarg3 = 0 ;
-  }
-  lineNo = 0 ;
-  while (! feof(pgm))
-  { fgets( in_Line, LINESIZE-2, pgm  ) ;
-    inCol = 0 ; 
-    lineNo++;
-    lineLen = strlen(in_Line)-1 ;
-    if (in_Line[lineLen]=='\n') in_Line[lineLen] = '\0' ;
-    else in_Line[++lineLen] = '\0';
-    if ( (nonBlank()) && (in_Line[inCol] != '*') )
-    { if (! getNum())
-        return error("Bad location", lineNo,-1);
-      loc = num;
-      if (loc > IADDR_SIZE)
-        return error("Location too large",lineNo,loc);
-      if (! skipCh(':'))
-        return error("Missing colon", lineNo,loc);
-      if (! getWord ())
-        return error("Missing opcode", lineNo,loc);
-      op = opHALT ;
-      while ((op < opRALim)
-             && (strncmp(opCodeTab[op], word, 4) != 0) )
-          op++ ;
-      if (strncmp(opCodeTab[op], word, 4) != 0)
-          return error("Illegal opcode", lineNo,loc);
-      switch ( opClass(op) )
-      { case opclRR :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo, loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad second register", lineNo, loc);
-        arg2 = num;
-        if ( ! skipCh(',')) 
-            return error("Missing comma", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad third register", lineNo,loc);
-        arg3 = num;
-        break;
+/* Procedure readMark records a "*@" comment of
+ * the code file; text follows the "*@". It is
+ * the mark function of loadProgram
+ */
+void readMark( void * host, char * text )
+{ int loc, line;
+  char kind;
+  char name[LINESIZE];
+  (void) host;
+  if ( (sscanf(text,"line %d %d",&loc,&line) == 2)
+       && (loc >= 0) && (loc < iaddrSize) && (line >= 0) )
+    lineMark[loc] = line + 1;
+  else if ( (sscanf(text,"func %d %120s",&loc,name) == 2)
+            && (loc >= 0) && (loc < iaddrSize) )
+  { funcTab = (FUNCMARK *) realloc(funcTab,
+                                   (funcCount+1) * sizeof(FUNCMARK));
+    if (funcTab == NULL)
+    { printf("Out of memory for function marks\n");
+      exit(1);
+    }
+    funcTab[funcCount].loc = loc;
+    funcTab[funcCount].name = strdup(name);
+    funcCount++;
+  }
+  else if ( (sscanf(text,"call %d",&loc) == 1)
+            && (loc >= 0) && (loc < iaddrSize) )
+  { callMark[loc] = mkCALL;
+    callCount++;
+  }
+  else if ( (sscanf(text,"ret %d",&loc) == 1)
+            && (loc >= 0) && (loc < iaddrSize) )
+    callMark[loc] = mkRET;
+  else if ( (sscanf(text,"array %c %d %d %120s",&kind,&loc,&line,name) == 4)
+            && (line > 0) )
+  { arrayTab = (ARRAYMARK *) realloc(arrayTab,
+                                     (arrayCount+1) * sizeof(ARRAYMARK));
+    if (arrayTab == NULL)
+    { printf("Out of memory for array marks\n");
+      exit(1);
+    }
+    arrayTab[arrayCount].name = strdup(name);
+    arrayTab[arrayCount].func = (kind == 'g') ? -1 : funcCount - 1;
+    arrayTab[arrayCount].offset = loc;
+    arrayTab[arrayCount].size = line;
+    arrayCount++;
+  }
+  else if (sscanf(text,"file %120s",name) == 1)
+    srcName = strdup(name);
+} /* readMark */
 
-        case opclRM :
-        case opclRA :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo,loc);
-        if (! getNum ())
-            return error("Bad displacement", lineNo,loc);
-        arg2 = num;
-        if ( ! skipCh('(') && ! skipCh(',') )
-            return error("Missing LParen", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS))
-            return error("Bad second register", lineNo,loc);
-        arg3 = num;
-        break;
-        }
-      iMem[loc].iop = op;
-      iMem[loc].iarg1 = arg1;
-      iMem[loc].iarg2 = arg2;
-      iMem[loc].iarg3 = arg3;
+/********************************************/
+/* Function readFile returns the contents of the
+ * file name as a string, or NULL if it cannot be
+ * read
+ */
+static char * readFile( char * name )
+{ FILE * f = fopen(name,"r");
+  char * text = NULL;
+  size_t size = 0, len = 0, n;
+  if (f == NULL) return NULL;
+  do
+  { if (len + 1 >= size)
+    { size = (size > 0) ? 2 * size : 4096;
+      text = (char *) realloc(text, size);
+      if (text == NULL)
+      { printf("Out of memory for file '%s'\n",name);
+        exit(1);
+      }
     }
+    n = fread(text + len, 1, size - len - 1, f);
+    len += n;
+  } while (n > 0);
+  fclose(f);
+  text[len] = '\0';
+  return text;
+} /* readFile */
+
+/********************************************/
+/* Function readInstructions returns the program
+ * in the code file name, or NULL after printing
+ * why it cannot be read. With marks the "*@"
+ * comments are recorded by readMark
+ */
+PROGRAM * readInstructions( char * name, int marks )
+{ char msg[TM_MSGSIZE];
+  char * text = readFile(name);
+  PROGRAM * p;
+  if (text == NULL)
+  { printf("file '%s' not found\n",name);
+    return NULL;
   }
-  return TRUE;
+  p = newProgram(iaddrSize);
+  if (marks)
+  { lineMark = (int *) newMemory(iaddrSize * sizeof(int));
+    callMark = (unsigned char *) newMemory(iaddrSize);
+    if (profileflag)
+    { execCnt = (long *) newMemory(iaddrSize * sizeof(long));
+      takenCnt = (long *) newMemory(iaddrSize * sizeof(long));
+    }
+  }
+  if ( ! loadProgram(p, text, marks ? readMark : NULL, NULL, msg) )
+  { printf("%s\n",msg);
+    freeProgram(p);
+    p = NULL;
+  }
+  free(text);
+  return p;
 } /* readInstructions */
 
 
 /********************************************/
-STEPRESULT stepTM (void)
-{ INSTRUCTION currentinstruction  ;
-  int pc  ;
-  int r,s,t,m  ;
-  int ok ;
+/* Function funcIndex returns the index in funcTab
+ * of the function the code at loc belongs to, or
+ * -1 for the prelude
+ */
+int funcIndex( int loc )
+{ int lo = 0, hi = funcCount - 1, mid, f = -1;
+  while (lo <= hi)
+  { mid = (lo + hi) / 2;
+    if (funcTab[mid].loc <= loc)
+    { f = mid;
+      lo = mid + 1;
+    }
+    else hi = mid - 1;
+  }
+  return f;
+} /* funcIndex */
 
-  pc = reg[PC_REG] ;
-  if ( (pc < 0) || (pc > IADDR_SIZE)  )
-      return srIMEM_ERR ;
-  reg[PC_REG] = pc + 1 ;
-  currentinstruction = iMem[ pc ] ;
-  switch (opClass(currentinstruction.iop) )
-  { case opclRR :
-    /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg2 ;
-      t = currentinstruction.iarg3 ;
-      break;
+/********************************************/
+/* Procedure profileStep counts the instruction
+ * at pc, which is about to be executed, and
+ * follows the calls and returns marked by the
+ * compiler through the frame tree
+ */
+void profileStep( int pc )
+{ FRAMENODE * callee;
+  int f;
+  execCnt[pc]++ ;
+  if ( jumpTaken(machine, &iMem[pc]) ) takenCnt[pc]++ ;
+  if ( callPending )
+  { /* pc is the entry of the function called */
+    f = funcIndex(pc);
+    for (callee = curFrame->child; callee != NULL; callee = callee->sibling)
+      if (callee->func == f) break;
+    if (callee == NULL)
+    { callee = (FRAMENODE *) calloc(1,sizeof(FRAMENODE));
+      if (callee == NULL)
+      { printf("Out of memory for call stacks\n");
+        exit(1);
+      }
+      callee->func = f;
+      callee->parent = curFrame;
+      callee->sibling = curFrame->child;
+      curFrame->child = callee;
+    }
+    curFrame = callee;
+    callPending = FALSE;
+  }
+  curFrame->self++ ;
+  if (callMark[pc] == mkCALL) callPending = TRUE;
+  else if ( (callMark[pc] == mkRET) && (curFrame->parent != NULL) )
+    curFrame = curFrame->parent;
+} /* profileStep */
 
-    case opclRM :
-    /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg3 ;
-      m = currentinstruction.iarg2 + reg[s] ;
-      if ( (m < 0) || (m > DADDR_SIZE))
-         return srDMEM_ERR ;
+/********************************************/
+/*             C O U N T E R S              */
+/********************************************/
+/* With --stats (a text summary) or --stats-json
+ * every instruction executed is counted by class
+ * and opcode, with loads, stores, conditional
+ * jumps taken and not taken, calls and returns
+ * (from the "*@call" and "*@ret" marks), IN and
+ * OUT. The stack depth is the distance from the
+ * top of dMem down to the lowest address loaded
+ * or stored through the stack registers of the
+ * code generator (fp and mp). The counters cover
+ * the run since the last c(lear) and end with
+ * its step result and, after a fault, the
+ * location of the faulting instruction
+ */
+
+#define   STACK_REG(r)  (((r) == FP_REG) || ((r) == MP_REG))
+
+typedef struct
+   { long steps;
+     long classCnt[3];       /* by OPCLASS */
+     long opCnt[opRALim];
+     long loads, stores;
+     long taken, notTaken;
+     long calls, returns;
+     long inputs, outputs;
+     int minStack;           /* lowest stack address, or daddrSize */
+     STEPRESULT result;
+     int faultLoc;           /* -1 unless result is a fault */
+   } COUNTERS;
+
+int statsflag = FALSE;
+char * statsName = NULL;     /* --stats; "-" for standard output */
+char * statsJsonName = NULL; /* --stats-json */
+COUNTERS stats;
+
+/********************************************/
+void clearCounters (void)
+{ memset(&stats,0,sizeof(stats));
+  stats.minStack = daddrSize;
+  stats.faultLoc = -1;
+} /* clearCounters */
+
+/********************************************/
+/* Procedure countStep counts the instruction at
+ * pc of mc, which is about to be executed
+ */
+static void countStep( MACHINE * mc, int pc )
+{ INSTRUCTION * i = &mc->prog->iMem[pc];
+  int m;
+  stats.steps++;
+  stats.classCnt[opClass(i->iop)]++;
+  stats.opCnt[i->iop]++;
+  switch (i->iop)
+  { case opIN :  stats.inputs++; break;
+    case opOUT : stats.outputs++; break;
+    case opLD :
+    case opST :
+      if (i->iop == opLD) stats.loads++; else stats.stores++;
+      m = i->iarg2 + mc->reg[i->iarg3];
+      if ( STACK_REG(i->iarg3) && (m >= 0) && (m < stats.minStack) )
+        stats.minStack = m;
       break;
+    case opJLT : case opJLE : case opJGT :
+    case opJGE : case opJEQ : case opJNE :
+      if (jumpTaken(mc, i)) stats.taken++; else stats.notTaken++;
+      break;
+  }
+  if (callMark[pc] == mkCALL) stats.calls++;
+  else if (callMark[pc] == mkRET) stats.returns++;
+} /* countStep */
 
-    case opclRA :
-    /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg3 ;
-      m = currentinstruction.iarg2 + reg[s] ;
+/********************************************/
+/* Procedure noteResult records the step result
+ * of a run, stopped at location loc
+ */
+void noteResult( STEPRESULT result, int loc )
+{ stats.result = result;
+  stats.faultLoc = ( (result == srOKAY) || (result == srHALT) ) ? -1 : loc;
+} /* noteResult */
+
+/********************************************/
+/* Procedure writeStats writes the counters as
+ * text to statsName and as JSON to statsJsonName
+ */
+void writeStats (void)
+{ static char * className[] = { "RR", "RM", "RA" };
+  FILE * out;
+  long branches = stats.taken + stats.notTaken;
+  int depth = (stats.minStack < daddrSize) ? daddrSize - stats.minStack : 0;
+  int k;
+  if (statsName != NULL)
+  { out = (strcmp(statsName,"-") == 0) ? stdout : fopen(statsName,"w");
+    if (out == NULL) printf("Unable to open %s\n",statsName);
+    else
+    { fprintf(out,"TM counters of %s\n",pgmName);
+      fprintf(out,"  %12ld  instructions\n",stats.steps);
+      for (k = 0; k < 3; k++)
+        fprintf(out,"  %12ld  %s instructions\n",stats.classCnt[k],
+                className[k]);
+      for (k = 0; k < opRALim; k++)
+        if (stats.opCnt[k] > 0)
+          fprintf(out,"  %12ld    %s\n",stats.opCnt[k],opCodeTab[k]);
+      fprintf(out,"  %12ld  loads\n",stats.loads);
+      fprintf(out,"  %12ld  stores\n",stats.stores);
+      fprintf(out,"  %12ld  conditional jumps, %ld taken (%.1f%%)\n",
+              branches,stats.taken,
+              (branches > 0) ? 100.0 * stats.taken / branches : 0.0);
+      if (callCount > 0)
+        fprintf(out,"  %12ld  calls, %ld returns\n",stats.calls,
+                stats.returns);
+      else fprintf(out,"             -  calls (no call marks)\n");
+      fprintf(out,"  %12ld  inputs\n",stats.inputs);
+      fprintf(out,"  %12ld  outputs\n",stats.outputs);
+      fprintf(out,"  %12d  words of stack at most\n",depth);
+      fprintf(out,"  result: %s",stepResultTab[stats.result]);
+      if (stats.faultLoc >= 0) fprintf(out," at location %d",stats.faultLoc);
+      fprintf(out,"\n");
+      if (out != stdout) fclose(out);
+    }
+  }
+  if (statsJsonName != NULL)
+  { out = fopen(statsJsonName,"w");
+    if (out == NULL) printf("Unable to open %s\n",statsJsonName);
+    else
+    { fprintf(out,"{\n  \"program\": \"%s\",\n",pgmName);
+      fprintf(out,"  \"instructions\": %ld,\n",stats.steps);
+      fprintf(out,"  \"classes\": { \"RR\": %ld, \"RM\": %ld, \"RA\": %ld },\n",
+              stats.classCnt[opclRR],stats.classCnt[opclRM],
+              stats.classCnt[opclRA]);
+      fprintf(out,"  \"opcodes\": {");
+      for (k = 0; k < opRALim; k++)
+        if (strcmp(opCodeTab[k],"????") != 0)
+          fprintf(out,"%s \"%s\": %ld",(k > 0) ? "," : "",opCodeTab[k],
+                  stats.opCnt[k]);
+      fprintf(out," },\n");
+      fprintf(out,"  \"loads\": %ld,\n  \"stores\": %ld,\n",
+              stats.loads,stats.stores);
+      fprintf(out,"  \"taken\": %ld,\n  \"not_taken\": %ld,\n",
+              stats.taken,stats.notTaken);
+      if (callCount > 0)
+        fprintf(out,"  \"calls\": %ld,\n  \"returns\": %ld,\n",
+                stats.calls,stats.returns);
+      else fprintf(out,"  \"calls\": null,\n  \"returns\": null,\n");
+      fprintf(out,"  \"inputs\": %ld,\n  \"outputs\": %ld,\n",
+              stats.inputs,stats.outputs);
+      fprintf(out,"  \"max_stack_depth\": %d,\n",depth);
+      fprintf(out,"  \"result\": \"%s\",\n",stepResultTab[stats.result]);
+      if (stats.faultLoc >= 0)
+        fprintf(out,"  \"fault_location\": %d\n}\n",stats.faultLoc);
+      else fprintf(out,"  \"fault_location\": null\n}\n");
+      fclose(out);
+    }
+  }
+} /* writeStats */
+
+/********************************************/
+/*        C A C H E   S I M U L A T I O N   */
+/********************************************/
+/* With --cache size,line,ways every LD and ST is
+ * run through a model of a data cache of size
+ * words in lines of line words, set associative
+ * with ways lines per set and LRU replacement.
+ * Hits and misses are charged to the function
+ * executing (from the "*@func" marks) and to the
+ * array accessed (from the "*@array" marks). An
+ * address belongs to a local array if it lies in
+ * the array in the frame of some function on the
+ * call stack, which is walked through the saved
+ * fp and return address of each frame, so
+ * elements reached through array parameters are
+ * charged to the array passed
+ */
+
+#define   CACHE_MAXDEPTH  64 /* frames searched for local arrays */
+
+typedef struct
+   { long hits, misses;
+   } CACHECOUNT;
+
+int cacheflag = FALSE;
+int cacheSize, cacheLine, cacheWays, cacheSets;
+static int * cacheTag;       /* line number held, -1 if none */
+static long * cacheUsed;     /* time of last use */
+static long cacheClock = 0;
+static CACHECOUNT * funcCache;   /* [funcCount+1], prelude first */
+static CACHECOUNT * arrayCache;  /* [arrayCount+1], other data last */
+
+/********************************************/
+/* Procedure cacheConfig reads the --cache option
+ * "size,line,ways"; cacheSets is left 0 unless
+ * it is a cache of whole sets of lines
+ */
+void cacheConfig( char * arg )
+{ cacheflag = TRUE;
+  cacheSets = 0;
+  if ( (sscanf(arg,"%d,%d,%d",&cacheSize,&cacheLine,&cacheWays) == 3)
+       && (cacheSize > 0) && (cacheLine > 0) && (cacheWays > 0)
+       && (cacheSize % (cacheLine * cacheWays) == 0) )
+    cacheSets = cacheSize / (cacheLine * cacheWays);
+} /* cacheConfig */
+
+/********************************************/
+/* Procedure clearCache empties the cache and
+ * its counts
+ */
+void clearCache (void)
+{ int k;
+  if ( ! cacheflag ) return;
+  if (cacheTag == NULL)
+  { cacheTag = (int *) malloc(cacheSets * cacheWays * sizeof(int));
+    cacheUsed = (long *) malloc(cacheSets * cacheWays * sizeof(long));
+    funcCache = (CACHECOUNT *) malloc((funcCount+1) * sizeof(CACHECOUNT));
+    arrayCache = (CACHECOUNT *) malloc((arrayCount+1) * sizeof(CACHECOUNT));
+    if ( (cacheTag == NULL) || (cacheUsed == NULL)
+         || (funcCache == NULL) || (arrayCache == NULL) )
+    { printf("Out of memory for the cache\n");
+      exit(1);
+    }
+  }
+  for (k = 0; k < cacheSets * cacheWays; k++)
+  { cacheTag[k] = -1;
+    cacheUsed[k] = 0;
+  }
+  memset(funcCache,0,(funcCount+1) * sizeof(CACHECOUNT));
+  memset(arrayCache,0,(arrayCount+1) * sizeof(CACHECOUNT));
+} /* clearCache */
+
+/********************************************/
+/* Function findArray returns the index in
+ * arrayTab of the array holding dMem[addr] when
+ * mc executes pc, or arrayCount if none does
+ */
+static int findArray( MACHINE * mc, int pc, int addr )
+{ int k, f, frame, depth, ret;
+  for (k = 0; k < arrayCount; k++)
+    if ( (arrayTab[k].func < 0)
+         && (addr >= mc->reg[GP_REG] + arrayTab[k].offset)
+         && (addr < mc->reg[GP_REG] + arrayTab[k].offset + arrayTab[k].size) )
+      return k;
+  f = funcIndex(pc);
+  frame = mc->reg[FP_REG];
+  for (depth = 0; (depth < CACHE_MAXDEPTH) && (f >= 0); depth++)
+  { for (k = 0; k < arrayCount; k++)
+      if ( (arrayTab[k].func == f)
+           && (addr >= frame + arrayTab[k].offset)
+           && (addr < frame + arrayTab[k].offset + arrayTab[k].size) )
+        return k;
+    if ( DMEM_FAULT(frame) || DMEM_FAULT(frame - 1) ) break;
+    ret = mc->dMem[frame - 1];
+    frame = mc->dMem[frame];
+    f = funcIndex(ret);
+  }
+  return arrayCount;
+} /* findArray */
+
+/********************************************/
+/* Procedure cacheStep runs the data access of
+ * the instruction at pc of mc, which is about to
+ * be executed, through the cache
+ */
+static void cacheStep( MACHINE * mc, int pc )
+{ INSTRUCTION * i = &mc->prog->iMem[pc];
+  int m, line, set, k, victim, hit = FALSE;
+  CACHECOUNT * fc, * ac;
+  if ( (i->iop != opLD) && (i->iop != opST) ) return;
+  m = i->iarg2 + mc->reg[i->iarg3];
+  if ( DMEM_FAULT(m) ) return;
+  line = m / cacheLine;
+  set = (line % cacheSets) * cacheWays;
+  victim = set;
+  cacheClock++;
+  for (k = set; k < set + cacheWays; k++)
+  { if (cacheTag[k] == line)
+    { hit = TRUE;
+      victim = k;
       break;
-  } /* case */
+    }
+    if (cacheUsed[k] < cacheUsed[victim]) victim = k;
+  }
+  cacheTag[victim] = line;
+  cacheUsed[victim] = cacheClock;
+  fc = &funcCache[funcIndex(pc) + 1];
+  ac = &arrayCache[(arrayCount > 0) ? findArray(mc, pc, m) : 0];
+  if (hit)
+  { fc->hits++;
+    ac->hits++;
+  }
+  else
+  { fc->misses++;
+    ac->misses++;
+  }
+} /* cacheStep */
 
-  switch ( currentinstruction.iop)
-  { /* RR instructions */
-    case opHALT :
-    /***********************************/
-      printf("HALT: %1d,%1d,%1d\n",r,s,t);
-      return srHALT ;
-      /* break; */
+/********************************************/
+static void writeCacheLine( CACHECOUNT * c, char * name, char * owner )
+{ long n = c->hits + c->misses;
+  if (n == 0) return;
+  printf("  %10ld  %10ld  %10ld  %6.2f  %s%s\n",n,c->hits,c->misses,
+         100.0 * c->misses / n,name,owner);
+} /* writeCacheLine */
 
-    case opIN :
-    /***********************************/
-      do
-      { printf("Enter value for IN instruction: ") ;
-        fflush (stdin);
-        fflush (stdout);
-        gets(in_Line);
-        lineLen = strlen(in_Line) ;
-        inCol = 0;
-        ok = getNum();
-        if ( ! ok ) printf ("Illegal value\n");
-        else reg[r] = num;
+/********************************************/
+/* Procedure writeCache prints the hits and
+ * misses by function and by array
+ */
+void writeCache (void)
+{ CACHECOUNT total = { 0, 0 };
+  char owner[LINESIZE];
+  int k;
+  for (k = 0; k <= funcCount; k++)
+  { total.hits += funcCache[k].hits;
+    total.misses += funcCache[k].misses;
+  }
+  printf("Data cache: %d words, %d-word lines, %d-way, %d sets, LRU\n",
+         cacheSize,cacheLine,cacheWays,cacheSets);
+  printf("    accesses        hits      misses   miss%%\n");
+  writeCacheLine(&total,"total","");
+  printf("By function\n");
+  writeCacheLine(&funcCache[0],"(prelude)","");
+  for (k = 0; k < funcCount; k++)
+    writeCacheLine(&funcCache[k+1],funcTab[k].name,"");
+  printf("By array\n");
+  for (k = 0; k < arrayCount; k++)
+  { if (arrayTab[k].func < 0) strcpy(owner," (global)");
+    else sprintf(owner," (in %.100s)",funcTab[arrayTab[k].func].name);
+    writeCacheLine(&arrayCache[k],arrayTab[k].name,owner);
+  }
+  writeCacheLine(&arrayCache[arrayCount],"(other data)","");
+} /* writeCache */
+
+/********************************************/
+/*            C A L L B A C K S             */
+/********************************************/
+/* The machines of the simulator do IN and OUT
+ * through these functions: the interactive
+ * machine prompts the terminal (or reads the
+ * input log while replaying), the machines of
+ * the batch runs and the fork server use the
+ * files of a FILEIO. The hook watchStep is set
+ * when the profile, the binary trace, the
+ * counters or the cache model must see every
+ * instruction
+ */
+
+/********************************************/
+/* Function termInput reads the value of an IN
+ * instruction of the interactive machine
+ */
+static int termInput( void * host, int * value )
+{ int ok;
+  (void) host;
+  if ( inputNext < inputCount )
+  { *value = inputLog[inputNext++] ;
+    return TRUE;
+  }
+  do
+  { printf("Enter value for IN instruction: ") ;
+    fflush (stdin);
+    fflush (stdout);
+    gets(in_Line);
+    lineLen = strlen(in_Line) ;
+    inCol = 0;
+    ok = getNum();
+    if ( ! ok ) printf ("Illegal value\n");
+    else *value = num;
+  }
+  while (! ok);
+  if ( checkInterval > 0 ) logInput(num) ;
+  return TRUE;
+} /* termInput */
+
+/********************************************/
+static void termOutput( void * host, int value )
+{ (void) host;
+  printf ("OUT instruction prints: %d\n", value ) ;
+} /* termOutput */
+
+/********************************************/
+static int fileInput( void * host, int * value )
+{ return (fscanf(((FILEIO *) host)->in, "%d", value) == 1);
+} /* fileInput */
+
+/********************************************/
+static void fileOutput( void * host, int value )
+{ fprintf(((FILEIO *) host)->out, "%d\n", value);
+} /* fileOutput */
+
+/********************************************/
+/* Functions fileTell and fileSeek give snapshots
+ * the position of the input file
+ */
+static long fileTell( void * host )
+{ return ftell(((FILEIO *) host)->in);
+} /* fileTell */
+
+/********************************************/
+static void fileSeek( void * host, long pos )
+{ fseek(((FILEIO *) host)->in, pos, SEEK_SET);
+} /* fileSeek */
+
+/********************************************/
+/* Procedure watchStep is the hook of the
+ * interactive machine, called with each
+ * instruction about to execute at pc
+ */
+static void watchStep( void * host, MACHINE * mc, int pc )
+{ (void) host;
+  if ( profileflag ) profileStep(pc) ;
+  if ( btraceflag ) traceStep(mc, pc) ;
+  if ( statsflag ) countStep(mc, pc) ;
+  if ( cacheflag ) cacheStep(mc, pc) ;
+} /* watchStep */
+
+/********************************************/
+/*           S N A P S H O T S              */
+/********************************************/
+/* the snapshots the k and l commands keep */
+#define   SNAP_SLOTS  10
+
+SNAPSHOT * snapSlot[SNAP_SLOTS];
+int lastSlot = -1; /* slot kept last, the base of the next */
+
+/********************************************/
+/*          T I M E   T R A V E L           */
+/********************************************/
+/* With --checkpoint n the interactive simulator
+ * keeps a snapshot of the machine every n
+ * instructions it executes, and the input log
+ * holds the values typed for IN. Going back to
+ * instruction k restores the last checkpoint at
+ * or before k and replays from it, reading IN
+ * from the log and discarding OUT; execution is
+ * deterministic, so the replay reaches exactly
+ * the state the machine had. When the table of
+ * checkpoints fills up every other one is
+ * dropped and the interval doubled, so long runs
+ * keep CHECKPOINT_MAX checkpoints spread over the
+ * whole run
+ */
+
+#define   CHECKPOINT_MAX  64
+
+typedef struct
+   { long count;          /* instructions executed when taken */
+     int inputNext;       /* input log entries read by then */
+     SNAPSHOT * snap;
+   } CHECKPOINT;
+
+CHECKPOINT checkTab[CHECKPOINT_MAX];
+int checkCount = 0;
+long checkStep;           /* the interval, doubled as needed */
+long nextCheck;           /* count of the next checkpoint */
+long execCount = 0;       /* instructions executed since c */
+
+/********************************************/
+/* Procedure takeCheckpoint adds a checkpoint of
+ * the machine at the current count
+ */
+static void takeCheckpoint (void)
+{ int k;
+  if (checkCount == CHECKPOINT_MAX)
+  { for (k = 1; k < CHECKPOINT_MAX; k += 2)
+      freeSnapshot(checkTab[k].snap);
+    for (k = 0; 2 * k < CHECKPOINT_MAX; k++)
+      checkTab[k] = checkTab[2 * k];
+    checkCount = k;
+    checkStep *= 2;
+  }
+  checkTab[checkCount].count = execCount;
+  checkTab[checkCount].inputNext = inputNext;
+  checkTab[checkCount].snap = saveSnapshot(machine,
+          (checkCount > 0) ? checkTab[checkCount-1].snap : NULL);
+  checkCount++;
+  nextCheck = execCount + checkStep;
+} /* takeCheckpoint */
+
+/********************************************/
+/* Procedure resetHistory forgets the past: the
+ * current state becomes instruction 0 and, with
+ * time travel on, the first checkpoint
+ */
+void resetHistory (void)
+{ while (checkCount > 0) freeSnapshot(checkTab[--checkCount].snap);
+  execCount = 0;
+  inputCount = 0;
+  inputNext = 0;
+  checkStep = checkInterval;
+  if (checkInterval > 0) takeCheckpoint();
+} /* resetHistory */
+
+/********************************************/
+/* Procedure countSteps adds n instructions just
+ * executed, taking a checkpoint when one is due
+ */
+void countSteps( long n )
+{ execCount += n;
+  if ( (checkInterval > 0) && (execCount >= nextCheck) )
+    takeCheckpoint();
+} /* countSteps */
+
+/********************************************/
+/* Procedure replay restores the last checkpoint
+ * at or before instruction from and executes up
+ * to instruction to. If addr is not negative the
+ * count after the last ST to dMem[addr] in
+ * [from,to) is returned in *written and its
+ * location in *loc, which are left alone if
+ * there is none
+ */
+static void replay( long from, long to, int addr,
+                    long * written, int * loc )
+{ TMHOOK hook = machine->hook;
+  CHECKPOINT * cp;
+  int k, pc;
+  INSTRUCTION * i;
+  for (k = checkCount - 1; (k > 0) && (checkTab[k].count > from); k--) ;
+  cp = &checkTab[k];
+  restoreSnapshot(machine, cp->snap);
+  execCount = cp->count;
+  inputNext = cp->inputNext;
+  machine->output = NULL;
+  machine->hook = NULL;
+  if (addr < 0)
+    runMachine(machine, to, &execCount);
+  else
+    while (execCount < to)
+    { pc = machine->reg[PC_REG];
+      if ( (pc >= 0) && (pc < iaddrSize) )
+      { i = &iMem[pc];
+        if ( (i->iop == opST) && (execCount >= from)
+             && (i->iarg2 + machine->reg[i->iarg3] == addr) )
+        { *written = execCount + 1;
+          *loc = pc;
+        }
       }
-      while (! ok);
-      break;
+      execCount++;
+      if (stepTM(machine) != srOKAY) break;
+    }
+  machine->output = termOutput;
+  machine->hook = hook;
+} /* replay */
 
-    case opOUT :  
-      printf ("OUT instruction prints: %d\n", reg[r] ) ;
-      break;
-    case opADD :  reg[r] = reg[s] + reg[t] ;  break;
-    case opSUB :  reg[r] = reg[s] - reg[t] ;  break;
-    case opMUL :  reg[r] = reg[s] * reg[t] ;  break;
+/********************************************/
+/* Procedure trimHistory drops the checkpoints
+ * beyond the present after going back; going on
+ * takes them again
+ */
+static void trimHistory (void)
+{ while ( (checkCount > 1) && (checkTab[checkCount-1].count > execCount) )
+    freeSnapshot(checkTab[--checkCount].snap);
+  nextCheck = checkTab[checkCount-1].count + checkStep;
+} /* trimHistory */
 
-    case opDIV :
-    /***********************************/
-      if ( reg[t] != 0 ) reg[r] = reg[s] / reg[t];
-      else return srZERODIVIDE ;
+/********************************************/
+/* Procedure stepBack goes back n instructions
+ */
+void stepBack( long n )
+{ long target = execCount - n;
+  if (target < 0) target = 0;
+  replay(target, target, -1, NULL, NULL);
+  trimHistory();
+} /* stepBack */
+
+/********************************************/
+/* Function writeBack goes back to just after the
+ * last instruction that wrote dMem[addr] and
+ * returns its location, or returns -1 (staying
+ * put) if no instruction since the start did
+ */
+int writeBack( int addr )
+{ long now = execCount, to, written = -1;
+  int k, loc, found;
+  /* search the intervals between checkpoints,
+   * latest first, for a write before the last
+   * instruction executed */
+  for (k = checkCount - 1; (k >= 0) && (written < 0); k--)
+  { to = (k + 1 < checkCount) ? checkTab[k+1].count : now;
+    if (to > now - 1) to = now - 1;
+    if (checkTab[k].count < to)
+      replay(checkTab[k].count, to, addr, &written, &loc);
+  }
+  found = (written >= 0);
+  if ( ! found ) written = now;
+  replay(written, written, -1, NULL, NULL);
+  trimHistory();
+  return found ? loc : -1;
+} /* writeBack */
+
+#if JIT_AVAILABLE
+/********************************************/
+/*    x 8 6 - 6 4   J I T   C O M P I L E R    */
+/********************************************/
+/* Basic blocks of iMem are translated lazily, the
+ * first time they are entered, into x86-64 code in
+ * an mmap'd region. While translated code runs the
+ * TM registers 0-6 live in r8d-r14d, the pc is a
+ * constant known at each instruction, r15 holds
+ * dMem, rbp the block table jitTab and rbx the
+ * count of executed instructions. A block ends at
+ * the first instruction that writes the pc, and
+ * before HALT, IN and OUT, which are left to
+ * stepTM; a block exit jumps to the next block
+ * through jitTab if it has already been translated
+ * and returns to jitRun otherwise. Data memory and
+ * division faults leave the block with the pc and
+ * count stepTM would have produced
+ */
+
+#define   JIT_CODE_SIZE  (1 << 22) /* bytes of executable memory */
+#define   JIT_MAXBLOCK   256       /* instructions per block */
+#define   JIT_MAXINST    64        /* bytes per translated instruction */
+
+typedef int (* JITENTRY) (int * reg, int * dMem, unsigned char ** tab,
+                          long * steps, unsigned char * code);
+
+static unsigned char * jitCode = NULL; /* the code region */
+static int jitUsed = 0;                /* bytes of it in use */
+static int jitStubs = 0;               /* bytes used by the stubs */
+static unsigned char ** jitTab;        /* block at each location */
+static unsigned char * jitDispatch;    /* jump to block at pc eax */
+static unsigned char * jitExit;        /* leave with result eax */
+
+/* host register holding TM register r (r < PC_REG) */
+#define   HREG(r)  (8 + (r))
+
+/********************************************/
+static void jb( int b )
+{ jitCode[jitUsed++] = (unsigned char) b;
+} /* jb */
+
+static void j32( int v )
+{ memcpy(jitCode + jitUsed, &v, 4);
+  jitUsed += 4;
+} /* j32 */
+
+/* rel32 displacement of target from the end of
+ * the 4 byte field emitted here
+ */
+static void jrel( unsigned char * target )
+{ j32((int) (target - (jitCode + jitUsed + 4)));
+} /* jrel */
+
+/********************************************/
+/* Procedure jitGet emits code loading TM register
+ * r, as seen by the instruction at loc, into eax
+ * (h = 0) or ecx (h = 1)
+ */
+static void jitGet( int h, int r, int loc )
+{ if (r == PC_REG)
+  { jb(0xB8 + h); j32(loc + 1); }         /* mov e?x,loc+1 */
+  else
+  { jb(0x44); jb(0x89); jb(0xC0 + ((HREG(r) & 7) << 3) + h); }
+} /* jitGet */
+
+/********************************************/
+/* Function jitPut emits code storing eax into TM
+ * register r. Writing the pc ends the block: the
+ * k instructions are counted and control goes to
+ * the block at the new pc. Returns TRUE if so
+ */
+static int jitPut( int r, int k )
+{ if (r == PC_REG)
+  { jb(0x48); jb(0x81); jb(0xC3); j32(k); /* add rbx,k */
+    jb(0xE9); jrel(jitDispatch);           /* jmp dispatch */
+    return TRUE;
+  }
+  jb(0x41); jb(0x89); jb(0xC0 + (HREG(r) & 7)); /* mov r?d,eax */
+  return FALSE;
+} /* jitPut */
+
+/********************************************/
+/* Procedure jitFault emits the exit taken when the
+ * k-th instruction of a block, at loc, faults with
+ * result sr
+ */
+static void jitFault( int loc, int k, int sr )
+{ jb(0xC7); jb(0x47); jb(4 * PC_REG); j32(loc + 1); /* mov [rdi+28],pc */
+  jb(0x48); jb(0x81); jb(0xC3); j32(k);            /* add rbx,k */
+  jb(0xB8); j32(sr);                               /* mov eax,sr */
+  jb(0xE9); jrel(jitExit);                         /* jmp exit */
+} /* jitFault */
+
+/********************************************/
+/* Procedure jitAddr emits code for the data
+ * address d+reg(s) of the RM instruction at loc
+ * into eax, with the bounds check of stepTM
+ */
+static void jitAddr( int d, int s, int loc, int k )
+{ int patch;
+  jitGet(0, s, loc);
+  jb(0x05); j32(d);                        /* add eax,d */
+  jb(0x3D); j32(daddrSize);                /* cmp eax,daddrSize */
+  jb(0x72); patch = jitUsed; jb(0);        /* jb ok */
+  jitFault(loc, k, srDMEM_ERR);
+  jitCode[patch] = (unsigned char) (jitUsed - patch - 1);
+} /* jitAddr */
+
+/********************************************/
+/* Procedure jitInit maps the code region and
+ * emits the entry, exit and dispatch stubs
+ */
+static void jitInit (void)
+{ int r, patch1, patch2;
+  jitCode = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (jitCode == MAP_FAILED)
+  { jitCode = NULL;
+    return;
+  }
+  jitTab = (unsigned char **) newMemory(iaddrSize * sizeof(unsigned char *));
+  jitUsed = 0;
+  /* entry (reg=rdi, dMem=rsi, tab=rdx, steps=rcx, code=r8) */
+  jb(0x53); jb(0x55);                              /* push rbx,rbp */
+  jb(0x41); jb(0x54); jb(0x41); jb(0x55);          /* push r12,r13 */
+  jb(0x41); jb(0x56); jb(0x41); jb(0x57);          /* push r14,r15 */
+  jb(0x51);                                        /* push rcx */
+  jb(0x49); jb(0x89); jb(0xF7);                    /* mov r15,rsi */
+  jb(0x48); jb(0x89); jb(0xD5);                    /* mov rbp,rdx */
+  jb(0x48); jb(0x8B); jb(0x19);                    /* mov rbx,[rcx] */
+  jb(0x4C); jb(0x89); jb(0xC0);                    /* mov rax,r8 */
+  for (r = 0; r < PC_REG; r++)                     /* mov r?d,[rdi+4r] */
+  { jb(0x44); jb(0x8B); jb(0x47 + ((HREG(r) & 7) << 3)); jb(4 * r); }
+  jb(0xFF); jb(0xE0);                              /* jmp rax */
+  /* exit: result in eax, pc already stored */
+  jitExit = jitCode + jitUsed;
+  for (r = 0; r < PC_REG; r++)                     /* mov [rdi+4r],r?d */
+  { jb(0x44); jb(0x89); jb(0x47 + ((HREG(r) & 7) << 3)); jb(4 * r); }
+  jb(0x59);                                        /* pop rcx */
+  jb(0x48); jb(0x89); jb(0x19);                    /* mov [rcx],rbx */
+  jb(0x41); jb(0x5F); jb(0x41); jb(0x5E);          /* pop r15,r14 */
+  jb(0x41); jb(0x5D); jb(0x41); jb(0x5C);          /* pop r13,r12 */
+  jb(0x5D); jb(0x5B);                              /* pop rbp,rbx */
+  jb(0xC3);                                        /* ret */
+  /* dispatch: continue at pc eax */
+  jitDispatch = jitCode + jitUsed;
+  jb(0x3D); j32(iaddrSize);                        /* cmp eax,iaddrSize */
+  jb(0x73); patch1 = jitUsed; jb(0);               /* jae out */
+  jb(0x48); jb(0x8B); jb(0x4C); jb(0xC5); jb(0x00);/* mov rcx,[rbp+rax*8] */
+  jb(0x48); jb(0x85); jb(0xC9);                    /* test rcx,rcx */
+  jb(0x74); patch2 = jitUsed; jb(0);               /* jz out */
+  jb(0xFF); jb(0xE1);                              /* jmp rcx */
+  jitCode[patch1] = (unsigned char) (jitUsed - patch1 - 1);
+  jitCode[patch2] = (unsigned char) (jitUsed - patch2 - 1);
+  jb(0x89); jb(0x47); jb(4 * PC_REG);              /* out: mov [rdi+28],eax */
+  jb(0x31); jb(0xC0);                              /* xor eax,eax */
+  jb(0xE9); jrel(jitExit);                         /* jmp exit */
+  jitStubs = jitUsed;
+  mprotect(jitCode, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+} /* jitInit */
+
+/********************************************/
+/* Function jitCompile translates the basic block
+ * starting at loc and returns its code, or NULL
+ * if the block would start with an instruction
+ * left to stepTM
+ */
+static unsigned char * jitCompile( int loc )
+{ unsigned char * start;
+  INSTRUCTION * i;
+  int k, op, r, s, t, patch;
+  static const unsigned char jcc[]
+        = {0x8C, 0x8E, 0x8F, 0x8D, 0x84, 0x85}; /* JLT..JNE */
+
+  op = iMem[loc].iop;
+  if ((op == opHALT) || (op == opIN) || (op == opOUT)) return NULL;
+  if (jitUsed + JIT_MAXINST * (JIT_MAXBLOCK + 1) > JIT_CODE_SIZE)
+  { /* region full: drop all translations */
+    freeMemory(jitTab, iaddrSize * sizeof(unsigned char *));
+    jitTab = (unsigned char **) newMemory(iaddrSize * sizeof(unsigned char *));
+    jitUsed = jitStubs;
+  }
+  mprotect(jitCode, JIT_CODE_SIZE, PROT_READ | PROT_WRITE);
+  start = jitCode + jitUsed;
+  for (k = 1 ; ; k++, loc++)
+  { if ( (loc >= iaddrSize) || (k > JIT_MAXBLOCK)
+         || (iMem[loc].iop == opHALT) || (iMem[loc].iop == opIN)
+         || (iMem[loc].iop == opOUT) )
+    { /* fall into the instruction at loc */
+      jb(0x48); jb(0x81); jb(0xC3); j32(k - 1);  /* add rbx,k-1 */
+      jb(0xB8); j32(loc);                         /* mov eax,loc */
+      jb(0xE9); jrel(jitDispatch);
       break;
+    }
+    i = &iMem[loc];
+    op = i->iop; r = i->iarg1; s = i->iarg2; t = i->iarg3;
+    if ((op == opADD) || (op == opSUB) || (op == opMUL) || (op == opDIV))
+    { jitGet(0, s, loc);
+      jitGet(1, t, loc);
+      switch (op)
+      { case opADD : jb(0x01); jb(0xC8); break;          /* add eax,ecx */
+        case opSUB : jb(0x29); jb(0xC8); break;          /* sub eax,ecx */
+        case opMUL : jb(0x0F); jb(0xAF); jb(0xC1); break; /* imul eax,ecx */
+        default :
+          jb(0x85); jb(0xC9);                           /* test ecx,ecx */
+          jb(0x75); patch = jitUsed; jb(0);             /* jnz ok */
+          jitFault(loc, k, srZERODIVIDE);
+          jitCode[patch] = (unsigned char) (jitUsed - patch - 1);
+          jb(0x99); jb(0xF7); jb(0xF9);                 /* cdq; idiv ecx */
+          break;
+      }
+      if (jitPut(r, k)) break;
+    }
+    else if (op == opLD)
+    { jitAddr(s, t, loc, k);
+      jb(0x41); jb(0x8B); jb(0x04); jb(0x87);   /* mov eax,[r15+rax*4] */
+      if (jitPut(r, k)) break;
+    }
+    else if (op == opST)
+    { jitAddr(s, t, loc, k);
+      jitGet(1, r, loc);
+      jb(0x41); jb(0x89); jb(0x0C); jb(0x87);   /* mov [r15+rax*4],ecx */
+    }
+    else if (op == opLDA)
+    { jitGet(0, t, loc);
+      jb(0x05); j32(s);                         /* add eax,d */
+      if (jitPut(r, k)) break;
+    }
+    else if (op == opLDC)
+    { jb(0xB8); j32(s);                         /* mov eax,d */
+      if (jitPut(r, k)) break;
+    }
+    else /* conditional jumps */
+    { jb(0x48); jb(0x81); jb(0xC3); j32(k);     /* add rbx,k */
+      jitGet(0, t, loc);
+      jb(0x05); j32(s);                         /* add eax,d */
+      jitGet(1, r, loc);
+      jb(0x85); jb(0xC9);                       /* test ecx,ecx */
+      jb(0x0F); jb(jcc[op - opJLT]); jrel(jitDispatch);
+      jb(0xB8); j32(loc + 1);                   /* mov eax,loc+1 */
+      jb(0xE9); jrel(jitDispatch);
+      break;
+    }
+  }
+  mprotect(jitCode, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+  return start;
+} /* jitCompile */
+
+/********************************************/
+/* Function jitRun executes TM instructions until
+ * a step result other than srOKAY, running
+ * translated blocks where possible and stepTM
+ * for the rest; steps is incremented by the
+ * number of instructions executed
+ */
+STEPRESULT jitRun( long * steps )
+{ int pc, result;
+  unsigned char * code;
+  if (jitCode == NULL) jitInit();
+  while (TRUE)
+  { pc = machine->reg[PC_REG];
+    code = NULL;
+    if ((jitCode != NULL) && (pc >= 0) && (pc < iaddrSize))
+    { code = jitTab[pc];
+      if (code == NULL) code = jitTab[pc] = jitCompile(pc);
+    }
+    if (code != NULL)
+      result = ((JITENTRY) jitCode) (machine->reg, machine->dMem,
+                                     jitTab, steps, code);
+    else
+    { result = stepTM(machine);
+      (*steps)++;
+    }
+    if (result != srOKAY) return result;
+  }
+} /* jitRun */
+
+#else
+
+STEPRESULT jitRun( long * steps )
+{ (*steps)++;
+  return stepTM(machine);
+} /* jitRun */
+
+#endif
+
+/********************************************/
+/*        P R O F I L E   R E P O R T        */
+/********************************************/
+/* With --profile every instruction executed is
+ * counted by stepTM. The report relates the
+ * counts to the source program through the
+ * "*@line" and "*@func" comments: executions per
+ * function and source line, per basic block and
+ * per conditional jump, and the source listing
+ * annotated with the instructions each line cost
+ */
+
+typedef struct
+   { int key;    /* line or location */
+     long count; /* instructions executed */
+     long execs; /* executions of its first instruction */
+   } PROFENTRY;
+
+static int cmpProfile( const void * a, const void * b )
+{ long ca = ((const PROFENTRY *) a)->count;
+  long cb = ((const PROFENTRY *) b)->count;
+  if (ca != cb) return (ca < cb) - (ca > cb);
+  return ((const PROFENTRY *) a)->key - ((const PROFENTRY *) b)->key;
+} /* cmpProfile */
+
+/********************************************/
+/* Function writesPc returns TRUE if the
+ * instruction at loc may change the flow of
+ * control, which ends a basic block
+ */
+static int writesPc( int loc )
+{ INSTRUCTION * i = &iMem[loc];
+  if ( (i->iop >= opJLT) && (i->iop <= opJNE) ) return TRUE;
+  if (i->iop == opHALT) return TRUE;
+  return (i->iarg1 == PC_REG) && (i->iop != opOUT) && (i->iop != opST);
+} /* writesPc */
+
+/********************************************/
+/* Function funcName returns the name of the
+ * function the code at loc belongs to
+ */
+static char * funcName( int loc )
+{ int f = funcIndex(loc);
+  return (f < 0) ? "(prelude)" : funcTab[f].name;
+} /* funcName */
+
+/********************************************/
+/* Function frameTotal returns the instructions
+ * executed in frame n and its callees, and adds
+ * them to the inclusive count incl[f+1] of its
+ * function f unless f is already active in an
+ * enclosing frame, which counted them already
+ */
+static long frameTotal( FRAMENODE * n, long * incl, int * active )
+{ FRAMENODE * c;
+  long total = n->self;
+  active[n->func+1]++;
+  for (c = n->child; c != NULL; c = c->sibling)
+    total += frameTotal(c, incl, active);
+  if (--active[n->func+1] == 0) incl[n->func+1] += total;
+  return total;
+} /* frameTotal */
+
+/********************************************/
+/* Function readSource returns the lines of the
+ * source file, or NULL; *n is set to their number
+ */
+static char ** readSource( int * n )
+{ FILE * src;
+  char line[LINESIZE];
+  char ** text = NULL;
+  int len;
+  *n = 0;
+  if (srcName == NULL) return NULL;
+  src = fopen(srcName,"r");
+  if (src == NULL) return NULL;
+  while (fgets(line,LINESIZE,src) != NULL)
+  { len = strlen(line);
+    if ((len > 0) && (line[len-1] == '\n')) line[--len] = '\0';
+    text = (char **) realloc(text,(*n+1) * sizeof(char *));
+    text[(*n)++] = strdup(line);
+  }
+  fclose(src);
+  return text;
+} /* readSource */
+
+/********************************************/
+/* Procedure writeProfile writes the profile
+ * report to the file profileName
+ */
+void writeProfile (void)
+{ FILE * out;
+  PROFENTRY * tab;
+  char ** text;
+  long total = 0, count;
+  int * lineOf;
+  char * leader;
+  long * incl;
+  int * active;
+  int nlines, maxLine = 0, loc, line, n, k, f, end, target;
+  out = fopen(profileName,"w");
+  if (out == NULL)
+  { printf("Unable to open %s\n",profileName);
+    return;
+  }
+  /* the source line of every location */
+  lineOf = (int *) newMemory((iCount+1) * sizeof(int));
+  line = 0;
+  for (loc = 0; loc < iCount; loc++)
+  { if (lineMark[loc] > 0) line = lineMark[loc] - 1;
+    lineOf[loc] = line;
+    if (line > maxLine) maxLine = line;
+    total += execCnt[loc];
+  }
+  text = readSource(&nlines);
+  if (nlines > maxLine) maxLine = nlines;
+  tab = (PROFENTRY *) newMemory((iCount+maxLine+funcCount+2)
+                                * sizeof(PROFENTRY));
+
+  fprintf(out,"TM profile of %s",pgmName);
+  if (srcName != NULL) fprintf(out," (source %s)",srcName);
+  fprintf(out,"\n%ld instructions executed\n",total);
+  if (total == 0) total = 1;
+
+  /* functions; inclusive counts need the calls marked */
+  incl = (long *) newMemory((funcCount+1) * sizeof(long));
+  active = (int *) newMemory((funcCount+1) * sizeof(int));
+  frameTotal(&frameRoot, incl, active);
+  fprintf(out,"\nFunctions\n");
+  fprintf(out,"     exclusive       %%     inclusive       %%"
+              "       calls  function\n");
+  for (f = -1, n = 0; f < funcCount; f++, n++)
+  { loc = (f < 0) ? 0 : funcTab[f].loc;
+    end = (f+1 < funcCount) ? funcTab[f+1].loc : iCount;
+    tab[n].key = f;
+    tab[n].count = 0;
+    tab[n].execs = (f < 0) ? 0 : execCnt[loc];
+    for ( ; loc < end; loc++) tab[n].count += execCnt[loc];
+  }
+  qsort(tab,n,sizeof(PROFENTRY),cmpProfile);
+  for (k = 0; k < n; k++)
+  { if (tab[k].count == 0) break;
+    f = tab[k].key;
+    fprintf(out,"  %12ld  %6.2f  ",tab[k].count,100.0 * tab[k].count / total);
+    if (callCount > 0)
+      fprintf(out,"%12ld  %6.2f",incl[f+1],100.0 * incl[f+1] / total);
+    else fprintf(out,"%12s  %6s","-","-");
+    fprintf(out,"  %10ld  %s\n",tab[k].execs,
+            (f < 0) ? "(prelude)" : funcTab[f].name);
+  }
+  freeMemory(incl,(funcCount+1) * sizeof(long));
+  freeMemory(active,(funcCount+1) * sizeof(int));
+
+  /* source lines */
+  for (line = 0; line <= maxLine; line++)
+  { tab[line].key = line;
+    tab[line].count = 0;
+  }
+  for (loc = 0; loc < iCount; loc++) tab[lineOf[loc]].count += execCnt[loc];
+  qsort(tab,maxLine+1,sizeof(PROFENTRY),cmpProfile);
+  fprintf(out,"\nHot spots\n");
+  fprintf(out,"  rank  instructions       %%   line  source\n");
+  for (k = 0; (k < PROFILE_TOP) && (k <= maxLine); k++)
+  { if (tab[k].count == 0) break;
+    line = tab[k].key;
+    fprintf(out,"  %4d  %12ld  %6.2f  %5d  %s\n",k+1,tab[k].count,
+            100.0 * tab[k].count / total,line,
+            (line == 0) ? "(prelude)"
+            : ((text != NULL) && (line <= nlines)) ? text[line-1] : "");
+  }
+
+  /* basic blocks */
+  leader = (char *) newMemory(iCount+1);
+  leader[0] = TRUE;
+  for (f = 0; f < funcCount; f++)
+    if (funcTab[f].loc < iCount) leader[funcTab[f].loc] = TRUE;
+  for (loc = 0; loc < iCount; loc++)
+    if (writesPc(loc))
+    { leader[loc+1] = TRUE;
+      if ( (iMem[loc].iarg3 == PC_REG)
+           && ((iMem[loc].iop == opLDA) || (iMem[loc].iop >= opJLT)) )
+      { target = loc + 1 + iMem[loc].iarg2;
+        if ((target >= 0) && (target < iCount)) leader[target] = TRUE;
+      }
+    }
+  n = 0;
+  for (loc = 0; loc < iCount; loc = end)
+  { count = 0;
+    for (end = loc; (end < iCount) && ((end == loc) || ! leader[end]); end++)
+      count += execCnt[end];
+    tab[n].key = loc;
+    tab[n].count = count;
+    tab[n].execs = execCnt[loc];
+    n++;
+  }
+  qsort(tab,n,sizeof(PROFENTRY),cmpProfile);
+  fprintf(out,"\nHot basic blocks\n");
+  fprintf(out,"  rank  instructions  executions   block        line  function\n");
+  for (k = 0; (k < PROFILE_TOP) && (k < n); k++)
+  { if (tab[k].count == 0) break;
+    loc = tab[k].key;
+    for (end = loc+1; (end < iCount) && ! leader[end]; end++) ;
+    fprintf(out,"  %4d  %12ld  %10ld  %5d-%-5d  %5d  %s\n",k+1,
+            tab[k].count,tab[k].execs,loc,end-1,lineOf[loc],funcName(loc));
+  }
+
+  /* conditional jumps */
+  n = 0;
+  for (loc = 0; loc < iCount; loc++)
+    if ( (iMem[loc].iop >= opJLT) && (iMem[loc].iop <= opJNE)
+         && (execCnt[loc] > 0) )
+    { tab[n].key = loc;
+      tab[n].count = execCnt[loc];
+      n++;
+    }
+  qsort(tab,n,sizeof(PROFENTRY),cmpProfile);
+  fprintf(out,"\nConditional jumps\n");
+  fprintf(out,"    loc  executions       taken   not taken   line  function\n");
+  for (k = 0; (k < PROFILE_TOP) && (k < n); k++)
+  { loc = tab[k].key;
+    fprintf(out,"  %5d  %10ld  %10ld  %10ld  %5d  %s\n",loc,execCnt[loc],
+            takenCnt[loc],execCnt[loc] - takenCnt[loc],lineOf[loc],
+            funcName(loc));
+  }
+
+  /* annotated source */
+  if (text != NULL)
+  { for (line = 0; line <= maxLine; line++) tab[line].count = 0;
+    for (loc = 0; loc < iCount; loc++) tab[lineOf[loc]].count += execCnt[loc];
+    fprintf(out,"\nAnnotated source\n");
+    for (line = 1; line <= nlines; line++)
+    { if (tab[line].count > 0)
+        fprintf(out,"  %12ld  %5d:  %s\n",tab[line].count,line,text[line-1]);
+      else
+        fprintf(out,"  %12s  %5d:  %s\n","",line,text[line-1]);
+    }
+  }
+  else if (srcName != NULL)
+    fprintf(out,"\nSource file %s not found\n",srcName);
+  fclose(out);
+  freeMemory(lineOf,(iCount+1) * sizeof(int));
+  freeMemory(leader,iCount+1);
+  freeMemory(tab,(iCount+maxLine+funcCount+2) * sizeof(PROFENTRY));
+} /* writeProfile */
+
+/********************************************/
+/* Procedure writeFolded writes the call stacks
+ * of frame n and its callees in the folded
+ * format of flame graph tools, one line
+ * "f1;f2;...;fn count" per stack; the stack of
+ * the parent of n is in flamePath[0..len-1]
+ */
+static char * flamePath = NULL;
+static int flameSize = 0;
+
+static void writeFolded( FILE * out, FRAMENODE * n, int len )
+{ FRAMENODE * c;
+  char * name = (n->func < 0) ? "(prelude)" : funcTab[n->func].name;
+  int need = len + strlen(name) + 2;
+  if (need > flameSize)
+  { flameSize = 2 * need;
+    flamePath = (char *) realloc(flamePath, flameSize);
+    if (flamePath == NULL)
+    { printf("Out of memory for call stacks\n");
+      exit(1);
+    }
+  }
+  if (len > 0) flamePath[len++] = ';';
+  strcpy(flamePath + len, name);
+  len += strlen(name);
+  if (n->self > 0) fprintf(out,"%s %ld\n",flamePath,n->self);
+  for (c = n->child; c != NULL; c = c->sibling)
+    writeFolded(out, c, len);
+} /* writeFolded */
+
+/********************************************/
+/* Procedure writeFlame writes the call stacks
+ * of the profile to the file flameName
+ */
+void writeFlame (void)
+{ FILE * out = fopen(flameName,"w");
+  if (out == NULL)
+  { printf("Unable to open %s\n",flameName);
+    return;
+  }
+  writeFolded(out, &frameRoot, 0);
+  fclose(out);
+} /* writeFlame */
+
+/********************************************/
+/*          B A T C H   R U N S             */
+/********************************************/
+/* With --batch the simulator runs the jobs of a
+ * manifest instead of reading commands. Each
+ * manifest line is
+ *      program [input [limit]]
+ * where input is a file of the integers IN reads
+ * ("-" for none) and limit the most instructions
+ * the job may execute (0 or absent: the --limit
+ * option, else no limit). Blank lines and lines
+ * starting with '#' are skipped. Each program is
+ * loaded once; its jobs share the PROGRAM,
+ * which is only read while jobs run, and run
+ * on a pool of threads, each thread with its own
+ * machine. Outputs are written in manifest order,
+ * followed by the failures and the throughput
+ */
+
+#define   BATCH_THREADS  64 /* most threads of --threads */
+
+typedef struct BatchProgram
+   { char * name;
+     PROGRAM * prog;
+     struct BatchProgram * next;
+   } BATCHPROGRAM;
+
+typedef struct
+   { int line;          /* of the manifest */
+     BATCHPROGRAM * prog;
+     char * input;      /* NULL if none */
+     long limit;
+     STEPRESULT result;
+     long steps;
+     char * output;     /* what OUT wrote */
+     size_t outSize;
+   } BATCHJOB;
+
+char * batchName = NULL;
+int batchThreads = 0;        /* 0: one per processor */
+long batchLimit = LONG_MAX;
+
+static BATCHPROGRAM * progList = NULL;
+static BATCHJOB * jobTab = NULL;
+static int jobCount = 0;
+
+#if POSIX_AVAILABLE
+
+static int nextJob = 0;
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
 
-    /*************** RM instructions ********************/
-    case opLD :    reg[r] = dMem[m] ;  break;
-    case opST :    dMem[m] = reg[r] ;  break;
+/********************************************/
+/* Function findProgram returns the program in
+ * file name, reading it the first time it is
+ * named, or NULL if it cannot be read
+ */
+static BATCHPROGRAM * findProgram( char * name )
+{ BATCHPROGRAM * p;
+  PROGRAM * prog;
+  for (p = progList; p != NULL; p = p->next)
+    if (strcmp(p->name,name) == 0) return p;
+  prog = readInstructions(name, FALSE);
+  if (prog == NULL) return NULL;
+  p = (BATCHPROGRAM *) malloc(sizeof(BATCHPROGRAM));
+  if (p == NULL)
+  { printf("Out of memory for programs\n");
+    exit(1);
+  }
+  p->name = strdup(name);
+  p->prog = prog;
+  p->next = progList;
+  progList = p;
+  return p;
+} /* findProgram */
+
+/********************************************/
+/* Function readManifest fills jobTab from the
+ * file batchName, returning FALSE on an error
+ */
+static int readManifest (void)
+{ FILE * f = fopen(batchName,"r");
+  char line[LINESIZE], prog[LINESIZE], input[LINESIZE];
+  BATCHJOB * job;
+  long limit;
+  int n, lineNo = 0;
+  if (f == NULL)
+  { printf("file '%s' not found\n",batchName);
+    return FALSE;
+  }
+  while (fgets(line,LINESIZE,f) != NULL)
+  { lineNo++;
+    limit = 0;
+    n = sscanf(line,"%120s %120s %ld",prog,input,&limit);
+    if ( (n < 1) || (prog[0] == '#') ) continue;
+    jobTab = (BATCHJOB *) realloc(jobTab,(jobCount+1) * sizeof(BATCHJOB));
+    if (jobTab == NULL)
+    { printf("Out of memory for jobs\n");
+      exit(1);
+    }
+    job = &jobTab[jobCount++];
+    memset(job,0,sizeof(BATCHJOB));
+    job->line = lineNo;
+    job->prog = findProgram(prog);
+    if (job->prog == NULL)
+    { fclose(f);
+      return FALSE;
+    }
+    if ( (n >= 2) && (strcmp(input,"-") != 0) ) job->input = strdup(input);
+    job->limit = (limit > 0) ? limit : batchLimit;
+  }
+  fclose(f);
+  return TRUE;
+} /* readManifest */
+
+/********************************************/
+/* Procedure runJob runs job on the machine mc
+ */
+static void runJob( MACHINE * mc, BATCHJOB * job )
+{ FILEIO io;
+  mc->prog = job->prog->prog;
+  clearMachine(mc);
+  io.in = (job->input != NULL) ? fopen(job->input,"r") : NULL;
+  io.out = open_memstream(&job->output,&job->outSize);
+  setMachineIO(mc, (io.in != NULL) ? fileInput : NULL, fileOutput, &io);
+  if (io.in != NULL) setMachineInputPos(mc, fileTell, fileSeek);
+  else setMachineInputPos(mc, NULL, NULL);
+  if ( ((job->input != NULL) && (io.in == NULL)) || (io.out == NULL) )
+    job->result = srINPUT_ERR;
+  else job->result = runMachine(mc,job->limit,&job->steps);
+  if (io.in != NULL) fclose(io.in);
+  if (io.out != NULL) fclose(io.out);
+} /* runJob */
 
-    /*************** RA instructions ********************/
-    case opLDA :    reg[r] = m ; break;
-    case opLDC :    reg[r] = currentinstruction.iarg2 ;   break;
-    case opJLT :    if ( reg[r] <  0 ) reg[PC_REG] = m ; break;
-    case opJLE :    if ( reg[r] <=  0 ) reg[PC_REG] = m ; break;
-    case opJGT :    if ( reg[r] >  0 ) reg[PC_REG] = m ; break;
-    case opJGE :    if ( reg[r] >=  0 ) reg[PC_REG] = m ; break;
-    case opJEQ :    if ( reg[r] == 0 ) reg[PC_REG] = m ; break;
-    case opJNE :    if ( reg[r] != 0 ) reg[PC_REG] = m ; break;
+/********************************************/
+/* Function batchWorker runs jobs until none is
+ * left; it is the body of each pool thread
+ */
+static void * batchWorker( void * arg )
+{ MACHINE * mc = newMachine(NULL, daddrSize);
+  int k;
+  while (TRUE)
+  { pthread_mutex_lock(&jobLock);
+    k = nextJob++;
+    pthread_mutex_unlock(&jobLock);
+    if (k >= jobCount) break;
+    runJob(mc,&jobTab[k]);
+  }
+  freeMachine(mc);
+  return arg;
+} /* batchWorker */
+
+/********************************************/
+/* Function runBatch runs the manifest batchName,
+ * returning the number of jobs that did not halt,
+ * or -1 if the manifest cannot be read
+ */
+int runBatch (void)
+{ pthread_t pool[BATCH_THREADS];
+  struct timespec start, stop;
+  double secs;
+  long total = 0;
+  int k, nthreads, failed = 0;
+  if ( ! readManifest ()) return -1;
+  nthreads = batchThreads;
+  if (nthreads <= 0) nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (nthreads > BATCH_THREADS) nthreads = BATCH_THREADS;
+  if (nthreads > jobCount) nthreads = jobCount;
+  if (nthreads < 1) nthreads = 1;
+  clock_gettime(CLOCK_MONOTONIC,&start);
+  for (k = 0; k < nthreads; k++)
+    if (pthread_create(&pool[k],NULL,batchWorker,NULL) != 0)
+    { printf("Unable to start thread %d\n",k);
+      exit(1);
+    }
+  for (k = 0; k < nthreads; k++) pthread_join(pool[k],NULL);
+  clock_gettime(CLOCK_MONOTONIC,&stop);
+  secs = (stop.tv_sec - start.tv_sec) + 1e-9 * (stop.tv_nsec - start.tv_nsec);
+
+  for (k = 0; k < jobCount; k++)
+  { BATCHJOB * job = &jobTab[k];
+    printf("==> %s %s\n",job->prog->name,
+           (job->input != NULL) ? job->input : "-");
+    if (job->output != NULL) fwrite(job->output,1,job->outSize,stdout);
+    printf("%s after %ld instructions\n",stepResultTab[job->result],
+           job->steps);
+    if (job->result != srHALT) failed++;
+    total += job->steps;
+    free(job->output);
+  }
+  printf("\n%d jobs, %d failed\n",jobCount,failed);
+  for (k = 0; k < jobCount; k++)
+    if (jobTab[k].result != srHALT)
+      printf("  line %d: %s: %s\n",jobTab[k].line,jobTab[k].prog->name,
+             stepResultTab[jobTab[k].result]);
+  printf("%ld instructions in %.3f s on %d threads",total,secs,nthreads);
+  if (secs > 0) printf(" (%.0f instructions/s)",total / secs);
+  printf("\n");
+  return failed;
+} /* runBatch */
+
+#else
+
+int runBatch (void)
+{ printf("--batch is not available on this host\n");
+  return -1;
+} /* runBatch */
 
-    /* end of legal instructions */
-  } /* case */
-  return srOKAY ;
-} /* stepTM */
+#endif
+
+/********************************************/
+/*          F O R K   S E R V E R           */
+/********************************************/
+/* With --fork-server the simulator reads the
+ * program once and then runs it once for each
+ * request, in a child process forked from the
+ * cleared machine; the child's memories are
+ * copy-on-write copies of the server's, so a run
+ * costs a fork and its execution. With the
+ * server name "-" each line of standard input is
+ * the input of one run. Otherwise the name is a
+ * Unix socket, and each connection is a run
+ * whose IN instructions read the integers the
+ * client sends until it shuts down writing. The
+ * reply to a run is the values written by OUT,
+ * one per line, followed by the line
+ *      <step result> after <n> instructions
+ * --limit bounds the instructions of each run
+ */
+
+char * serverName = NULL;
+
+#if POSIX_AVAILABLE
+
+/********************************************/
+/* Procedure serveRun runs the program on the
+ * machine, reading in and writing to out; it is
+ * called in the child process
+ */
+static void serveRun( FILE * in, FILE * out )
+{ FILEIO io;
+  STEPRESULT result;
+  long steps = 0;
+  io.in = in;
+  io.out = out;
+  setMachineIO(machine, fileInput, fileOutput, &io);
+  setMachineInputPos(machine, fileTell, fileSeek);
+  if ( (in == NULL) || (out == NULL) ) result = srINPUT_ERR;
+  else result = runMachine(machine,batchLimit,&steps);
+  if (out != NULL)
+  { fprintf(out,"%s after %ld instructions\n",stepResultTab[result],steps);
+    fflush(out);
+  }
+} /* serveRun */
+
+/********************************************/
+/* Function servePipe serves the lines of the
+ * standard input one run at a time
+ */
+static int servePipe (void)
+{ char * line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  pid_t child;
+  int status;
+  while ((len = getline(&line,&size,stdin)) > 0)
+  { fflush(stdout);
+    child = fork();
+    if (child < 0)
+    { printf("Unable to fork\n");
+      return 1;
+    }
+    if (child == 0)
+    { serveRun(fmemopen(line,len,"r"),stdout);
+      _exit(0);
+    }
+    if ( (waitpid(child,&status,0) != child)
+         || (! WIFEXITED(status)) )
+      printf("Run failed\n");
+  }
+  free(line);
+  return 0;
+} /* servePipe */
+
+/********************************************/
+/* Function serveSocket accepts connections on
+ * the socket serverName until it is killed,
+ * forking a child per connection; the children
+ * run concurrently
+ */
+static int serveSocket (void)
+{ struct sockaddr_un addr;
+  int listener, conn;
+  pid_t child;
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(serverName) >= sizeof(addr.sun_path))
+  { printf("Socket name too long: %s\n",serverName);
+    return 1;
+  }
+  strcpy(addr.sun_path,serverName);
+  unlink(serverName);
+  listener = socket(AF_UNIX,SOCK_STREAM,0);
+  if ( (listener < 0)
+       || (bind(listener,(struct sockaddr *) &addr,sizeof(addr)) < 0)
+       || (listen(listener,SOMAXCONN) < 0) )
+  { printf("Unable to listen on %s\n",serverName);
+    return 1;
+  }
+  /* the system reaps the children */
+  signal(SIGCHLD,SIG_IGN);
+  printf("TM fork server for %s listening on %s\n",pgmName,serverName);
+  fflush(stdout);
+  while (TRUE)
+  { conn = accept(listener,NULL,NULL);
+    if (conn < 0)
+    { if (errno == EINTR) continue;
+      printf("Unable to accept on %s\n",serverName);
+      return 1;
+    }
+    child = fork();
+    if (child == 0)
+    { close(listener);
+      serveRun(fdopen(conn,"r"),fdopen(dup(conn),"w"));
+      _exit(0);
+    }
+    if (child < 0) printf("Unable to fork\n");
+    close(conn);
+  }
+} /* serveSocket */
+
+/********************************************/
+/* Function runForkServer serves runs of the
+ * program read, returning the exit status
+ */
+int runForkServer (void)
+{ if (strcmp(serverName,"-") == 0) return servePipe();
+  else return serveSocket();
+} /* runForkServer */
+
+#else
+
+int runForkServer (void)
+{ printf("--fork-server is not available on this host\n");
+  return 1;
+} /* runForkServer */
+
+#endif
 
 /********************************************/
 int doCommand (void)
 { char cmd;
-  int stepcnt=0, i;
+  long stepcnt=0;
+  int i, n;
   int printcnt;
   int stepResult;
-  int regNo, loc;
   do
   { printf ("Enter command: ");
     fflush (stdin);
@@ -422,6 +2100,23 @@ int doCommand (void)
       if ( traceflag ) printf("on.\n"); else printf("off.\n");
       break;
 
+    case 'f' :
+    /***********************************/
+      machine->fuse = ! machine->fuse ;
+      printf("Superinstructions now ");
+      if ( machine->fuse ) printf("on.\n"); else printf("off.\n");
+      break;
+
+    case 'j' :
+    /***********************************/
+      jitflag = ! jitflag ;
+      if ( ! JIT_AVAILABLE ) jitflag = FALSE ;
+      printf("JIT compilation now ");
+      if ( jitflag ) printf("on.\n");
+      else if ( JIT_AVAILABLE ) printf("off.\n");
+      else printf("off (not available on this host).\n");
+      break;
+
     case 'h' :
     /***********************************/
       printf("Commands are:\n");
@@ -440,8 +2135,20 @@ int doCommand (void)
       printf("   p(rint         "\
              "Toggle print of total instructions executed"\
              " ('go' only)\n");
+      printf("   f(use          "\
+             "Toggle execution of fused superinstructions\n");
+      printf("   j(it           "\
+             "Toggle x86-64 translation of code ('go' only)\n");
       printf("   c(lear         "\
              "Reset simulator for new execution of program\n");
+      printf("   b(ack <n>      "\
+             "Go back n (default 1) TM instructions (--checkpoint)\n");
+      printf("   w(rite <b>     "\
+             "Go back to the last write of dMem[b] (--checkpoint)\n");
+      printf("   k(eep <n|f>    "\
+             "Keep a snapshot of the machine in slot n or file f\n");
+      printf("   l(oad <n|f>    "\
+             "Restore the snapshot in slot n or file f\n");
       printf("   h(elp          "\
              "Cause this list of commands to be printed\n");
       printf("   q(uit          "\
@@ -467,7 +2174,7 @@ int doCommand (void)
     case 'r' :
     /***********************************/
       for (i = 0; i < NO_REGS; i++)
-      { printf("%1d: %4d    ", i,reg[i]);
+      { printf("%1d: %4d    ", i,machine->reg[i]);
         if ( (i % 4) == 3 ) printf ("\n");
       }
       break;
@@ -482,7 +2189,7 @@ int doCommand (void)
       if ( ! atEOL ())
         printf ("Instruction locations?\n");
       else
-      { while ((iloc >= 0) && (iloc < IADDR_SIZE)
+      { while ((iloc >= 0) && (iloc < iaddrSize)
                 && (printcnt > 0) )
         { writeInstruction(iloc);
           iloc++ ;
@@ -501,9 +2208,9 @@ int doCommand (void)
       if ( ! atEOL ())
         printf("Data locations?\n");
       else
-      { while ((dloc >= 0) && (dloc < DADDR_SIZE)
+      { while ((dloc >= 0) && (dloc < daddrSize)
                   && (printcnt > 0))
-        { printf("%5d: %5d\n",dloc,dMem[dloc]);
+        { printf("%5d: %5d\n",dloc,machine->dMem[dloc]);
           dloc++;
           printcnt--;
         }
@@ -515,11 +2222,89 @@ int doCommand (void)
       iloc = 0;
       dloc = 0;
       stepcnt = 0;
-      for (regNo = 0;  regNo < NO_REGS ; regNo++)
-            reg[regNo] = 0 ;
-      dMem[0] = DADDR_SIZE - 1 ;
-      for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-            dMem[loc] = 0 ;
+      clearMachine(machine);
+      resetHistory();
+      clearCounters();
+      clearCache();
+      curFrame = &frameRoot;
+      callPending = FALSE;
+      break;
+
+    case 'k' :
+    /***********************************/
+      if ( getNum () && atEOL () && (num >= 0) && (num < SNAP_SLOTS) )
+      { SNAPSHOT * snap = saveSnapshot(machine,
+                            (lastSlot >= 0) ? snapSlot[lastSlot] : NULL);
+        freeSnapshot(snapSlot[num]);
+        snapSlot[num] = snap;
+        lastSlot = num;
+        printf("Snapshot %d kept.\n",num);
+      }
+      else if ( nonBlank () && ! isdigit(ch) )
+      { SNAPSHOT * snap = saveSnapshot(machine, NULL);
+        if ( writeSnapshot(snap, in_Line + inCol) )
+          printf("Snapshot written to %s.\n",in_Line + inCol);
+        else printf("Unable to write %s\n",in_Line + inCol);
+        freeSnapshot(snap);
+      }
+      else printf("Snapshot slot (0-%d) or file?\n",SNAP_SLOTS-1);
+      break;
+
+    case 'l' :
+    /***********************************/
+      { SNAPSHOT * snap = NULL;
+        int isFile = FALSE;
+        if ( getNum () && atEOL () && (num >= 0) && (num < SNAP_SLOTS) )
+        { snap = snapSlot[num];
+          if (snap == NULL) printf("No snapshot %d.\n",num);
+        }
+        else if ( nonBlank () && ! isdigit(ch) )
+        { isFile = TRUE;
+          snap = readSnapshot(in_Line + inCol);
+          if (snap == NULL) printf("Unable to read %s\n",in_Line + inCol);
+        }
+        else printf("Snapshot slot (0-%d) or file?\n",SNAP_SLOTS-1);
+        if (snap != NULL)
+        { if ( restoreSnapshot(machine, snap) )
+          { printf("Snapshot loaded.\n");
+            resetHistory();
+          }
+          else printf("Snapshot is of another program or memory size\n");
+          if (isFile) freeSnapshot(snap);
+        }
+      }
+      break;
+
+    case 'b' :
+    /***********************************/
+      stepcnt = 0;
+      if ( atEOL ())  n = 1;
+      else if ( getNum ())  n = abs(num);
+      else
+      { printf("Step count?\n");
+        break;
+      }
+      if ( checkInterval <= 0 )
+        printf("Time travel is off (use --checkpoint).\n");
+      else
+      { stepBack(n);
+        printf("Back at instruction %ld.\n",execCount);
+      }
+      break;
+
+    case 'w' :
+    /***********************************/
+      if ( (! getNum ()) || (num < 0) || (num >= daddrSize) )
+        printf("Data location?\n");
+      else if ( checkInterval <= 0 )
+        printf("Time travel is off (use --checkpoint).\n");
+      else if ( (i = writeBack(num)) >= 0 )
+      { printf("Back at instruction %ld, after dMem[%d] = %d by\n",
+               execCount,num,machine->dMem[num]);
+        writeInstruction(i);
+      }
+      else printf("No write of dMem[%d] before instruction %ld.\n",
+                  num,execCount);
       break;
 
     case 'q' : return FALSE;  /* break; */
@@ -528,26 +2313,47 @@ int doCommand (void)
   }  /* case */
   stepResult = srOKAY;
   if ( stepcnt > 0 )
-  { if ( cmd == 'g' )
+  { if ( (cmd == 'g') && jitflag && ! traceflag && (machine->hook == NULL)
+         && (checkInterval == 0) )
+    { long steps = 0;
+      stepResult = jitRun (&steps);
+      if ( icountflag )
+        printf("Number of instructions executed = %ld\n",steps);
+    }
+    else if ( cmd == 'g' )
     { stepcnt = 0;
       while (stepResult == srOKAY)
-      { iloc = reg[PC_REG] ;
-        if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
-        stepcnt++;
+      { iloc = machine->reg[PC_REG] ;
+        if ( traceflag )
+        { writeInstruction( iloc ) ;
+          stepResult = stepTM (machine);
+          stepcnt++;
+          countSteps(1);
+        }
+        else
+        { stepResult = stepFused (machine, INT_MAX, &n);
+          stepcnt += n;
+          countSteps(n);
+        }
       }
       if ( icountflag )
-        printf("Number of instructions executed = %d\n",stepcnt);
+        printf("Number of instructions executed = %ld\n",stepcnt);
     }
     else
     { while ((stepcnt > 0) && (stepResult == srOKAY))
-      { iloc = reg[PC_REG] ;
+      { iloc = machine->reg[PC_REG] ;
         if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
+        stepResult = stepTM (machine);
         stepcnt-- ;
+        countSteps(1);
       }
     }
+    if ( stepResult == srHALT )
+    { INSTRUCTION * h = &iMem[machine->reg[PC_REG] - 1];
+      printf("HALT: %1d,%1d,%1d\n",h->iarg1,h->iarg2,h->iarg3);
+    }
     printf( "%s\n",stepResultTab[stepResult] );
+    if ( statsflag ) noteResult(stepResult, iloc);
   }
   return TRUE;
 } /* doCommand */
@@ -558,22 +2364,89 @@ int doCommand (void)
 /********************************************/
 
 main( int argc, char * argv[] )
-{ if (argc != 2)
-  { printf("usage: %s <filename>\n",argv[0]);
+{ int arg = 1;
+  while ((arg < argc - 1) && (argv[arg][0] == '-'))
+  { if (strcmp(argv[arg],"--imem") == 0)
+      iaddrSize = memorySize(argv[arg+1]);
+    else if (strcmp(argv[arg],"--dmem") == 0)
+      daddrSize = memorySize(argv[arg+1]);
+    else if (strcmp(argv[arg],"--profile") == 0)
+    { profileflag = TRUE;
+      profileName = argv[arg+1];
+    }
+    else if (strcmp(argv[arg],"--flame") == 0)
+    { profileflag = TRUE;
+      flameName = argv[arg+1];
+    }
+    else if (strcmp(argv[arg],"--batch") == 0)
+      batchName = argv[arg+1];
+    else if (strcmp(argv[arg],"--threads") == 0)
+      batchThreads = atoi(argv[arg+1]);
+    else if (strcmp(argv[arg],"--limit") == 0)
+      batchLimit = atol(argv[arg+1]);
+    else if (strcmp(argv[arg],"--fork-server") == 0)
+      serverName = argv[arg+1];
+    else if (strcmp(argv[arg],"--checkpoint") == 0)
+      checkInterval = atol(argv[arg+1]);
+    else if (strcmp(argv[arg],"--btrace") == 0)
+      btraceName = argv[arg+1];
+    else if (strcmp(argv[arg],"--ring") == 0)
+      btraceRing = atol(argv[arg+1]);
+    else if (strcmp(argv[arg],"--stats") == 0)
+    { statsflag = TRUE;
+      statsName = argv[arg+1];
+    }
+    else if (strcmp(argv[arg],"--cache") == 0)
+      cacheConfig(argv[arg+1]);
+    else if (strcmp(argv[arg],"--stats-json") == 0)
+    { statsflag = TRUE;
+      statsJsonName = argv[arg+1];
+    }
+    else break;
+    arg += 2;
+  }
+  if ( (arg != ((batchName != NULL) ? argc : argc - 1))
+       || (iaddrSize <= 0) || (daddrSize <= 0) || (batchLimit <= 0)
+       || (checkInterval < 0)
+       || (btraceRing < 0) || (cacheflag && (cacheSets <= 0))
+       || ((batchName != NULL) + (serverName != NULL)
+           + (profileflag || statsflag || cacheflag || (btraceName != NULL))
+           > 1) )
+  { printf("usage: %s [--imem words] [--dmem words] [--profile file]"
+           " [--flame file]\n"
+           "          [--checkpoint steps] [--btrace file [--ring n]]\n"
+           "          [--stats file|-] [--stats-json file]"
+           " [--cache size,line,ways] <filename>\n",argv[0]);
+    printf("       %s [--imem words] [--dmem words] [--limit steps]"
+           " --fork-server <socket or -> <filename>\n",argv[0]);
+    printf("       %s [--imem words] [--dmem words] [--threads n]"
+           " [--limit steps] --batch manifest\n",argv[0]);
+    printf("  (memory sizes from 1 to %d words, default %d)\n",
+           MAXADDR_SIZE, IADDR_SIZE);
     exit(1);
   }
-  strcpy(pgmName,argv[1]) ;
+  if (batchName != NULL)
+    return (runBatch() == 0) ? 0 : 1;
+  strcpy(pgmName,argv[arg]) ;
   if (strchr (pgmName, '.') == NULL)
      strcat(pgmName,".tm");
-  pgm = fopen(pgmName,"r");
-  if (pgm == NULL)
-  { printf("file '%s' not found\n",pgmName);
-    exit(1);
-  }
 
   /* read the program */
-  if ( ! readInstructions ())
+  program = readInstructions(pgmName, TRUE);
+  if (program == NULL)
          exit(1) ;
+  iMem = program->iMem;
+  iCount = program->iCount;
+  machine = newMachine(program, daddrSize);
+  setMachineIO(machine, termInput, termOutput, NULL);
+  resetHistory();
+  clearCounters();
+  clearCache();
+  if (serverName != NULL)
+    return runForkServer();
+  if (btraceName != NULL) openTrace();
+  if ( profileflag || btraceflag || statsflag || cacheflag )
+    machine->hook = watchStep;
   /* switch input file to terminal */
   /* reset( input ); */
   /* read-eval-print */
@@ -582,5 +2455,10 @@ main( int argc, char * argv[] )
      done = ! doCommand ();
   while (! done );
   printf("Simulation done.\n");
+  if ( profileName != NULL ) writeProfile();
+  if ( flameName != NULL ) writeFlame();
+  if ( btraceflag ) closeTrace();
+  if ( statsflag ) writeStats();
+  if ( cacheflag ) writeCache();
   return 0;
 }
@@ -0,0 +1,705 @@
+/****************************************************/
+/* File: tm2c.c                                     */
+/* Translator of TM programs into standalone C      */
+/* programs that behave as under the g(o command    */
+/****************************************************/
+
+/* tm2c reads a TM program in the format read by the
+ * TM simulator and writes a C program that executes
+ * it like the simulator command g (go) would:
+ *
+ *      tm2c [--imem n] [--dmem n] prog.tm [prog.c]
+ *      gcc -O2 prog.c -o prog
+ *      ./prog [-p]
+ *
+ * The generated main is a switch on the pc. Every
+ * basic block of the TM program becomes a case
+ * whose instructions are straight-line C, and jumps
+ * to known locations are gotos. Any other location
+ * a computed jump may reach is executed by a one
+ * instruction interpreter in the default case, so
+ * every program behaves as in the simulator: IN,
+ * OUT, HALT, the step results and -p (the print
+ * toggle of the simulator) produce the same output.
+ * The memory sizes default to those given with
+ * --imem and --dmem, as for the simulator, and may
+ * be changed with -DIADDR_SIZE=n and -DDADDR_SIZE=n
+ * when compiling the generated program
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+/******* const *******/
+#define   IADDR_SIZE  1024 /* default, --imem overrides */
+#define   DADDR_SIZE  1024 /* default, --dmem overrides */
+#define   MAXADDR_SIZE (1 << 28) /* largest --imem or --dmem */
+#define   NO_REGS 8
+#define   PC_REG  7
+
+#define   LINESIZE  121
+#define   WORDSIZE  20
+
+/******* type  *******/
+
+typedef enum {
+   opclRR,     /* reg operands r,s,t */
+   opclRM,     /* reg r, mem d+s */
+   opclRA      /* reg r, int d+s */
+   } OPCLASS;
+
+typedef enum {
+   /* RR instructions */
+   opHALT,    /* RR     halt, operands are ignored */
+   opIN,      /* RR     read into reg(r); s and t are ignored */
+   opOUT,     /* RR     write from reg(r), s and t are ignored */
+   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
+   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
+   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
+   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
+   opRRLim,   /* limit of RR opcodes */
+
+   /* RM instructions */
+   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
+   opST,      /* RM     mem(d+reg(s)) = reg(r) */
+   opRMLim,   /* Limit of RM opcodes */
+
+   /* RA instructions */
+   opLDA,     /* RA     reg(r) = d+reg(s) */
+   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
+   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
+   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
+   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
+   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
+   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
+   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+   opRALim    /* Limit of RA opcodes */
+   } OPCODE;
+
+typedef struct {
+      int iop  ;
+      int iarg1  ;
+      int iarg2  ;
+      int iarg3  ;
+   } INSTRUCTION;
+
+/******** vars ********/
+int iaddrSize = IADDR_SIZE;
+int daddrSize = DADDR_SIZE;
+
+INSTRUCTION * iMem;
+int iCount = 0;         /* locations up to the last one loaded */
+char * leader;
+char * labelled;        /* leaders reached by goto */
+
+char * opCodeTab[]
+        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV","????",
+            /* RR opcodes */
+           "LD","ST","????", /* RM opcodes */
+           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
+           /* RA opcodes */
+          };
+
+/* C operators of the conditional jumps JLT..JNE */
+char * relOpTab[] = {"<","<=",">",">=","==","!="};
+
+char pgmName[120];
+FILE *pgm  ;
+FILE *out  ;
+
+char in_Line[LINESIZE] ;
+int lineLen ;
+int inCol  ;
+int num  ;
+char word[WORDSIZE] ;
+char ch  ;
+
+/********************************************/
+int opClass( int c )
+{ if      ( c <= opRRLim) return ( opclRR );
+  else if ( c <= opRMLim) return ( opclRM );
+  else                    return ( opclRA );
+} /* opClass */
+
+/********************************************/
+void getCh (void)
+{ if (++inCol < lineLen)
+  ch = in_Line[inCol] ;
+  else ch = ' ' ;
+} /* getCh */
+
+/********************************************/
+int nonBlank (void)
+{ while ((inCol < lineLen)
+         && (in_Line[inCol] == ' ') )
+    inCol++ ;
+  if (inCol < lineLen)
+  { ch = in_Line[inCol] ;
+    return TRUE ; }
+  else
+  { ch = ' ' ;
+    return FALSE ; }
+} /* nonBlank */
+
+/********************************************/
+int getNum (void)
+{ int sign;
+  int term;
+  int temp = FALSE;
+  num = 0 ;
+  do
+  { sign = 1;
+    while ( nonBlank() && ((ch == '+') || (ch == '-')) )
+    { temp = FALSE ;
+      if (ch == '-')  sign = - sign ;
+      getCh();
+    }
+    term = 0 ;
+    nonBlank();
+    while (isdigit(ch))
+    { temp = TRUE ;
+      term = term * 10 + ( ch - '0' ) ;
+      getCh();
+    }
+    num = num + (term * sign) ;
+  } while ( (nonBlank()) && ((ch == '+') || (ch == '-')) ) ;
+  return temp;
+} /* getNum */
+
+/********************************************/
+int getWord (void)
+{ int temp = FALSE;
+  int length = 0;
+  if (nonBlank ())
+  { while (isalnum(ch))
+    { if (length < WORDSIZE-1) word [length++] =  ch ;
+      getCh() ;
+    }
+    word[length] = '\0';
+    temp = (length != 0);
+  }
+  return temp;
+} /* getWord */
+
+/********************************************/
+int skipCh ( char c  )
+{ int temp = FALSE;
+  if ( nonBlank() && (ch == c) )
+  { getCh();
+    temp = TRUE;
+  }
+  return temp;
+} /* skipCh */
+
+/********************************************/
+int error( char * msg, int lineNo, int instNo)
+{ fprintf(stderr,"Line %d",lineNo);
+  if (instNo >= 0) fprintf(stderr," (Instruction %d)",instNo);
+  fprintf(stderr,"   %s\n",msg);
+  return FALSE;
+} /* error */
+
+/********************************************/
+/* Function readInstructions reads the program
+ * exactly as the TM simulator does
+ */
+int readInstructions (void)
+{ OPCODE op;
+  int arg1, arg2, arg3;
+  int loc, lineNo;
+  lineNo = 0 ;
+  while (fgets( in_Line, LINESIZE-2, pgm ) != NULL)
+  { inCol = 0 ;
+    lineNo++;
+    lineLen = strlen(in_Line)-1 ;
+    if (in_Line[lineLen]=='\n') in_Line[lineLen] = '\0' ;
+    else in_Line[++lineLen] = '\0';
+    if ( (nonBlank()) && (in_Line[inCol] != '*') )
+    { if (! getNum())
+        return error("Bad location", lineNo,-1);
+      loc = num;
+      if ((loc < 0) || (loc >= iaddrSize))
+        return error("Location too large",lineNo,loc);
+      if (! skipCh(':'))
+        return error("Missing colon", lineNo,loc);
+      if (! getWord ())
+        return error("Missing opcode", lineNo,loc);
+      op = opHALT ;
+      while ((op < opRALim)
+             && (strncmp(opCodeTab[op], word, 4) != 0) )
+          op++ ;
+      if (strncmp(opCodeTab[op], word, 4) != 0)
+          return error("Illegal opcode", lineNo,loc);
+      switch ( opClass(op) )
+      { case opclRR :
+        /***********************************/
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad first register", lineNo,loc);
+        arg1 = num;
+        if ( ! skipCh(','))
+            return error("Missing comma", lineNo, loc);
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad second register", lineNo, loc);
+        arg2 = num;
+        if ( ! skipCh(','))
+            return error("Missing comma", lineNo,loc);
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad third register", lineNo,loc);
+        arg3 = num;
+        break;
+
+        case opclRM :
+        case opclRA :
+        /***********************************/
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad first register", lineNo,loc);
+        arg1 = num;
+        if ( ! skipCh(','))
+            return error("Missing comma", lineNo,loc);
+        if (! getNum ())
+            return error("Bad displacement", lineNo,loc);
+        arg2 = num;
+        if ( ! skipCh('(') && ! skipCh(',') )
+            return error("Missing LParen", lineNo,loc);
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS))
+            return error("Bad second register", lineNo,loc);
+        arg3 = num;
+        break;
+        }
+      iMem[loc].iop = op;
+      iMem[loc].iarg1 = arg1;
+      iMem[loc].iarg2 = arg2;
+      iMem[loc].iarg3 = arg3;
+      if (loc >= iCount) iCount = loc + 1;
+    }
+  }
+  return TRUE;
+} /* readInstructions */
+
+/********************************************/
+/* Function writesPc returns TRUE if the
+ * instruction at loc may change the pc
+ */
+static int writesPc( int loc )
+{ int op = iMem[loc].iop;
+  if ((op == opHALT) || (op >= opJLT)) return TRUE;
+  return (op != opST) && (op != opIN) && (op != opOUT)
+         && (iMem[loc].iarg1 == PC_REG);
+} /* writesPc */
+
+/********************************************/
+/* Function constTarget returns the location the
+ * instruction at loc jumps to if it is a known
+ * constant, else -1
+ */
+static int constTarget( int loc )
+{ INSTRUCTION * i = &iMem[loc];
+  if ((i->iop >= opJLT) && (i->iarg3 == PC_REG))
+    return loc + 1 + i->iarg2;
+  if (i->iarg1 != PC_REG) return -1;
+  if ((i->iop == opLDA) && (i->iarg3 == PC_REG))
+    return loc + 1 + i->iarg2;
+  if (i->iop == opLDC) return i->iarg2;
+  return -1;
+} /* constTarget */
+
+/********************************************/
+/* Procedure findLeaders marks the first location
+ * of every basic block: location 0, the location
+ * after each instruction that may change the pc,
+ * and every location the program computes from
+ * the pc (jump targets and return addresses).
+ * Leaders that generated gotos refer to are also
+ * marked labelled
+ */
+static void findLeaders (void)
+{ int loc, target;
+  INSTRUCTION * i;
+  leader[0] = TRUE;
+  for (loc = 0 ; loc < iCount ; loc++)
+  { i = &iMem[loc];
+    if (writesPc(loc) && (loc+1 < iCount)) leader[loc+1] = TRUE;
+    if ((opClass(i->iop) == opclRA) && (i->iop != opLDC)
+        && (i->iarg3 == PC_REG))
+    { target = loc + 1 + i->iarg2;
+      if ((target >= 0) && (target < iCount)) leader[target] = TRUE;
+    }
+  }
+  for (loc = 0 ; loc < iCount ; loc++)
+  { target = constTarget(loc);
+    if ((target >= 0) && (target < iCount) && leader[target])
+      labelled[target] = TRUE;
+    if ((iMem[loc].iop >= opJLT) && (loc+1 < iCount))
+      labelled[loc+1] = TRUE;
+  }
+} /* findLeaders */
+
+/********************************************/
+/* Function regStr returns the C expression for
+ * register r read by the instruction at loc
+ */
+static char * regStr( int r, int loc )
+{ static char buf[2][24];
+  static int which = 0;
+  which = 1 - which;
+  if (r == PC_REG) sprintf(buf[which],"%d",loc + 1);
+  else sprintf(buf[which],"reg[%d]",r);
+  return buf[which];
+} /* regStr */
+
+/********************************************/
+/* Procedure genJump writes the transfer of
+ * control to the location in expression e, k
+ * instructions into the current block; c is the
+ * location if it is a known constant, else -1
+ */
+static void genJump( char * e, int c, int k, char * indent )
+{ fprintf(out,"%ssteps += %d;\n",indent,k);
+  if ((c >= 0) && (c < iCount) && leader[c])
+    fprintf(out,"%sgoto L%d;\n",indent,c);
+  else
+    fprintf(out,"%spc = %s; continue;\n",indent,e);
+} /* genJump */
+
+/********************************************/
+/* Procedure genFault writes the check for a
+ * data memory fault of the k-th instruction of
+ * a block, at loc
+ */
+static void genFault( int loc, int k )
+{ fprintf(out,"      if (DMEM_FAULT(m)) "
+              "{ pc = %d; steps += %d; result = srDMEM_ERR; break; }\n",
+          loc + 1, k);
+} /* genFault */
+
+/********************************************/
+/* Function genInstruction writes the C code of
+ * the k-th instruction of a basic block, at loc.
+ * It returns TRUE if control cannot fall through
+ * to the next location
+ */
+static int genInstruction( int loc, int k )
+{ INSTRUCTION * i = &iMem[loc];
+  int r = i->iarg1, s = i->iarg2, t = i->iarg3;
+  char e[64];
+  fprintf(out,"      /* %4d: %5s %d,",loc,opCodeTab[i->iop],r);
+  if (opClass(i->iop) == opclRR) fprintf(out,"%d,%d */\n",s,t);
+  else fprintf(out,"%d(%d) */\n",s,t);
+  switch (i->iop)
+  { case opHALT :
+      fprintf(out,"      printf(\"HALT: %d,%d,%d\\n\");\n",r,s,t);
+      fprintf(out,"      pc = %d; steps += %d; result = srHALT; break;\n",
+              loc + 1, k);
+      return TRUE;
+    case opIN :
+      fprintf(out,"      reg[%d] = readValue();\n",r);
+      return FALSE;
+    case opOUT :
+      fprintf(out,"      printf(\"OUT instruction prints: %%d\\n\", %s);\n",
+              regStr(r,loc));
+      return FALSE;
+    case opADD :
+    case opSUB :
+    case opMUL :
+      /* unsigned arithmetic wraps like the simulator's */
+      sprintf(e,"(int) ((unsigned) %s %c (unsigned) %s)",regStr(s,loc),
+              (i->iop == opADD) ? '+' : (i->iop == opSUB) ? '-' : '*',
+              regStr(t,loc));
+      break;
+    case opDIV :
+      fprintf(out,"      if (%s == 0) { pc = %d; steps += %d; "
+                  "result = srZERODIVIDE; break; }\n",
+              regStr(t,loc),loc + 1,k);
+      sprintf(e,"%s / %s",regStr(s,loc),regStr(t,loc));
+      break;
+    case opLD :
+      fprintf(out,"      m = %d + %s;\n",s,regStr(t,loc));
+      genFault(loc,k);
+      sprintf(e,"dMem[m]");
+      break;
+    case opST :
+      fprintf(out,"      m = %d + %s;\n",s,regStr(t,loc));
+      genFault(loc,k);
+      fprintf(out,"      dMem[m] = %s;\n",regStr(r,loc));
+      return FALSE;
+    case opLDA :
+      if (t == PC_REG) sprintf(e,"%d",loc + 1 + s);
+      else sprintf(e,"(int) ((unsigned) %d + (unsigned) reg[%d])",s,t);
+      break;
+    case opLDC :
+      sprintf(e,"%d",s);
+      break;
+    default : /* JLT .. JNE */
+      if (t == PC_REG) sprintf(e,"%d",loc + 1 + s);
+      else sprintf(e,"(int) ((unsigned) %d + (unsigned) reg[%d])",s,t);
+      fprintf(out,"      if (%s %s 0) {\n",regStr(r,loc),
+              relOpTab[i->iop - opJLT]);
+      genJump(e,constTarget(loc),k,"        ");
+      fprintf(out,"      }\n");
+      sprintf(e,"%d",loc + 1);
+      genJump(e,loc + 1,k,"      ");
+      return TRUE;
+  }
+  if (r == PC_REG)
+  { genJump(e,constTarget(loc),k,"      ");
+    return TRUE;
+  }
+  fprintf(out,"      reg[%d] = %s;\n",r,e);
+  return FALSE;
+} /* genInstruction */
+
+/********************************************/
+/* the part of the generated program that does
+ * not depend on the TM program
+ */
+static char * prologue[] = {
+  "#include <stdio.h>",
+  "#include <stdlib.h>",
+  "#include <string.h>",
+  "#include <ctype.h>",
+  "",
+  "#define   LINESIZE  121",
+  "#define   DMEM_FAULT(m) (((m) < 0) || ((m) >= DADDR_SIZE))",
+  "",
+  "typedef enum {",
+  "   srOKAY, srHALT, srIMEM_ERR, srDMEM_ERR, srZERODIVIDE",
+  "   } STEPRESULT;",
+  "",
+  "static char * stepResultTab[]",
+  "        = {\"OK\",\"Halted\",\"Instruction Memory Fault\",",
+  "           \"Data Memory Fault\",\"Division by 0\"",
+  "          };",
+  "",
+  "static int dMem [DADDR_SIZE];",
+  "",
+  "/* readValue reads the value of an IN instruction",
+  " * like the TM simulator: a sum of signed numbers",
+  " */",
+  "static int readValue (void)",
+  "{ char line[LINESIZE];",
+  "  char * p;",
+  "  int num, term, sign, ok;",
+  "  do",
+  "  { printf(\"Enter value for IN instruction: \");",
+  "    fflush(stdout);",
+  "    if (fgets(line,LINESIZE,stdin) == NULL)",
+  "    { printf(\"\\nEnd of input\\n\");",
+  "      exit(1);",
+  "    }",
+  "    p = line; num = 0; ok = 0;",
+  "    do",
+  "    { sign = 1;",
+  "      while (*p == ' ') p++;",
+  "      while ((*p == '+') || (*p == '-'))",
+  "      { ok = 0;",
+  "        if (*p == '-') sign = - sign;",
+  "        p++;",
+  "        while (*p == ' ') p++;",
+  "      }",
+  "      term = 0;",
+  "      while (isdigit((unsigned char) *p))",
+  "      { ok = 1;",
+  "        term = term * 10 + (*p++ - '0');",
+  "      }",
+  "      num += term * sign;",
+  "      while (*p == ' ') p++;",
+  "    } while ((*p == '+') || (*p == '-'));",
+  "    if (! ok) printf(\"Illegal value\\n\");",
+  "  } while (! ok);",
+  "  return num;",
+  "}",
+  "",
+  NULL
+};
+
+/********************************************/
+/* Procedure genInterpreter writes the default
+ * case of the dispatcher, which executes the
+ * single instruction at a location that does not
+ * start a basic block
+ */
+static void genInterpreter (void)
+{ int loc;
+  INSTRUCTION * i;
+  fprintf(out,"    default :\n");
+  fprintf(out,"      if ((pc < 0) || (pc >= IADDR_SIZE)) "
+              "{ steps++; result = srIMEM_ERR; break; }\n");
+  fprintf(out,"      if (pc >= %d) /* HALT 0,0,0 */\n",iCount);
+  fprintf(out,"      { printf(\"HALT: 0,0,0\\n\"); pc++; steps++; "
+              "result = srHALT; break; }\n");
+  fprintf(out,"      { static const int code[%d][4] = {\n",iCount);
+  for (loc = 0 ; loc < iCount ; loc++)
+  { i = &iMem[loc];
+    fprintf(out,"          {%d,%d,%d,%d}%s\n",i->iop,i->iarg1,i->iarg2,
+            i->iarg3,(loc+1 < iCount) ? "," : "");
+  }
+  fprintf(out,"        };\n");
+  fprintf(out,"        const int * c = code[pc];\n");
+  fprintf(out,"        int r = c[1], s = c[2], t = c[3];\n");
+  fprintf(out,"        reg[7] = ++pc; steps++;\n");
+  fprintf(out,"        if ((c[0] == %d) || (c[0] == %d))\n",opLD,opST);
+  fprintf(out,"        { m = s + reg[t];\n");
+  fprintf(out,"          if (DMEM_FAULT(m)) { result = srDMEM_ERR; break; }\n");
+  fprintf(out,"        }\n");
+  fprintf(out,"        switch (c[0])\n");
+  fprintf(out,"        { case %d : printf(\"HALT: %%1d,%%1d,%%1d\\n\",r,s,t);"
+              " result = srHALT; break;\n",opHALT);
+  fprintf(out,"          case %d : reg[r] = readValue(); break;\n",opIN);
+  fprintf(out,"          case %d : printf(\"OUT instruction prints: %%d\\n\","
+              "reg[r]); break;\n",opOUT);
+  fprintf(out,"          case %d : reg[r] = (int) ((unsigned) reg[s] + "
+              "(unsigned) reg[t]); break;\n",opADD);
+  fprintf(out,"          case %d : reg[r] = (int) ((unsigned) reg[s] - "
+              "(unsigned) reg[t]); break;\n",opSUB);
+  fprintf(out,"          case %d : reg[r] = (int) ((unsigned) reg[s] * "
+              "(unsigned) reg[t]); break;\n",opMUL);
+  fprintf(out,"          case %d : if (reg[t] == 0) result = srZERODIVIDE;\n"
+              "                   else reg[r] = reg[s] / reg[t];\n"
+              "                   break;\n",opDIV);
+  fprintf(out,"          case %d : reg[r] = dMem[m]; break;\n",opLD);
+  fprintf(out,"          case %d : dMem[m] = reg[r]; break;\n",opST);
+  fprintf(out,"          case %d : reg[r] = (int) ((unsigned) s + "
+              "(unsigned) reg[t]); break;\n",opLDA);
+  fprintf(out,"          case %d : reg[r] = s; break;\n",opLDC);
+  fprintf(out,"          case %d : if (reg[r] <  0) reg[7] = s + reg[t]; "
+              "break;\n",opJLT);
+  fprintf(out,"          case %d : if (reg[r] <= 0) reg[7] = s + reg[t]; "
+              "break;\n",opJLE);
+  fprintf(out,"          case %d : if (reg[r] >  0) reg[7] = s + reg[t]; "
+              "break;\n",opJGT);
+  fprintf(out,"          case %d : if (reg[r] >= 0) reg[7] = s + reg[t]; "
+              "break;\n",opJGE);
+  fprintf(out,"          case %d : if (reg[r] == 0) reg[7] = s + reg[t]; "
+              "break;\n",opJEQ);
+  fprintf(out,"          case %d : if (reg[r] != 0) reg[7] = s + reg[t]; "
+              "break;\n",opJNE);
+  fprintf(out,"        }\n");
+  fprintf(out,"        pc = reg[7];\n");
+  fprintf(out,"        continue;\n");
+  fprintf(out,"      }\n");
+} /* genInterpreter */
+
+/********************************************/
+/* Procedure genProgram writes the C program */
+static void genProgram (void)
+{ int loc, k, stop;
+  char ** line;
+  fprintf(out,"/* Generated by tm2c from %s */\n\n",pgmName);
+  fprintf(out,"#ifndef   IADDR_SIZE\n#define   IADDR_SIZE  %d\n#endif\n",
+          iaddrSize);
+  fprintf(out,"#ifndef   DADDR_SIZE\n#define   DADDR_SIZE  %d\n#endif\n",
+          daddrSize);
+  for (line = prologue; *line != NULL; line++)
+    fprintf(out,"%s\n",*line);
+  fprintf(out,"int main( int argc, char * argv[] )\n");
+  fprintf(out,"{ int reg[8] = {0};\n");
+  fprintf(out,"  int pc = 0, m = 0;\n");
+  fprintf(out,"  long steps = 0;\n");
+  fprintf(out,"  STEPRESULT result = srOKAY;\n");
+  fprintf(out,"  dMem[0] = DADDR_SIZE - 1;\n");
+  fprintf(out,"  while (result == srOKAY)\n");
+  fprintf(out,"  { switch (pc)\n");
+  fprintf(out,"    {\n");
+  loc = 0;
+  while (loc < iCount)
+  { /* one basic block */
+    if (labelled[loc]) fprintf(out,"    case %d : L%d :\n",loc,loc);
+    else fprintf(out,"    case %d :\n",loc);
+    k = 0;
+    stop = FALSE;
+    do
+    { k++;
+      stop = genInstruction(loc, k);
+      loc++;
+    } while (! stop && (loc < iCount) && ! leader[loc]);
+    if (! stop)
+    { /* fall into the next block */
+      fprintf(out,"      steps += %d;\n",k);
+      if (loc >= iCount)
+        fprintf(out,"      pc = %d; continue;\n",loc);
+      else fprintf(out,"      /* fall through */\n");
+    }
+    else fprintf(out,"      break;\n");
+    while ((loc < iCount) && ! leader[loc]) loc++;
+  }
+  genInterpreter();
+  fprintf(out,"    }\n");
+  fprintf(out,"  }\n");
+  fprintf(out,"  if ((argc > 1) && (strcmp(argv[1],\"-p\") == 0))\n");
+  fprintf(out,"    printf(\"Number of instructions executed = %%ld\\n\","
+              "steps);\n");
+  fprintf(out,"  printf(\"%%s\\n\",stepResultTab[result]);\n");
+  fprintf(out,"  return result == srHALT ? 0 : 1;\n");
+  fprintf(out,"}\n");
+} /* genProgram */
+
+/********************************************/
+/* Function memorySize converts a --imem or --dmem
+ * argument, returning 0 if it is not a size in
+ * 1..MAXADDR_SIZE
+ */
+static int memorySize( char * arg )
+{ char * end;
+  long n = strtol(arg, &end, 10);
+  if ( (*end != '\0') || (n < 1) || (n > MAXADDR_SIZE) ) return 0;
+  return (int) n;
+} /* memorySize */
+
+/********************************************/
+int main( int argc, char * argv[] )
+{ int arg = 1;
+  while ((arg < argc - 1) && (argv[arg][0] == '-'))
+  { if ( (strcmp(argv[arg],"--imem") == 0) && (arg + 2 < argc) )
+      iaddrSize = memorySize(argv[arg+1]);
+    else if ( (strcmp(argv[arg],"--dmem") == 0) && (arg + 2 < argc) )
+      daddrSize = memorySize(argv[arg+1]);
+    else break;
+    arg += 2;
+  }
+  if ( (argc - arg < 1) || (argc - arg > 2)
+       || (iaddrSize <= 0) || (daddrSize <= 0) )
+  { fprintf(stderr,"usage: %s [--imem words] [--dmem words] "
+                   "<filename> [<C file>]\n",argv[0]);
+    exit(1);
+  }
+  iMem = (INSTRUCTION *) calloc(iaddrSize, sizeof(INSTRUCTION));
+  leader = (char *) calloc(iaddrSize, 1);
+  labelled = (char *) calloc(iaddrSize, 1);
+  if ((iMem == NULL) || (leader == NULL) || (labelled == NULL))
+  { fprintf(stderr,"Out of memory\n");
+    exit(1);
+  }
+  strncpy(pgmName,argv[arg],sizeof(pgmName)-4);
+  if (strchr (pgmName, '.') == NULL)
+     strcat(pgmName,".tm");
+  pgm = fopen(pgmName,"r");
+  if (pgm == NULL)
+  { fprintf(stderr,"file '%s' not found\n",pgmName);
+    exit(1);
+  }
+  if ( ! readInstructions ())
+    exit(1);
+  fclose(pgm);
+  if (iCount == 0) iCount = 1; /* HALT 0,0,0 */
+  out = stdout;
+  if (argc - arg == 2)
+  { out = fopen(argv[arg+1],"w");
+    if (out == NULL)
+    { fprintf(stderr,"Unable to open %s\n",argv[arg+1]);
+      exit(1);
+    }
+  }
+  findLeaders();
+  genProgram();
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -0,0 +1,205 @@
+/****************************************************/
+/* File: tmfuse.c                                   */
+/* Lists superinstruction candidates for the TM     */
+/* from an execution trace                          */
+/* (printed by tm with t(race on, then g(o)         */
+/****************************************************/
+
+/* The input is the output of the TM simulator with
+ * tracing on (command t, then g), read from the file
+ * given on the command line or from standard input.
+ * Every trace line "  loc:  OP  r,s,t" is counted;
+ * the instruction text seen at each location gives
+ * the static code. Each window of n consecutive
+ * locations (n = 2..MAXLEN) is weighted with the
+ * number of times its first instruction executed,
+ * and windows with the same opcode sequence are
+ * summed. A window may contain jumps, as the compare
+ * idiom does; its weight counts entries only. The
+ * top candidates are printed together with the
+ * dispatches fusing them would save.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define   MAXADDR_SIZE (1 << 28) /* as in tm.c */
+#define   LINESIZE    121
+#define   MAXLEN      5    /* longest pattern examined */
+#define   NTOP        20   /* default number of candidates printed */
+#define   HASHSIZE    4099
+
+char * opCodeTab[]
+        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV",
+           "LD","ST",
+           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE"
+          };
+#define   NOPS  ((int) (sizeof(opCodeTab) / sizeof(opCodeTab[0])))
+
+/* prompts of the simulator that may precede a trace
+ * line, since the input typed after them is not echoed
+ */
+char * promptTab[]
+        = {"Enter command:","Enter value for IN instruction:"};
+#define   NPROMPTS  ((int) (sizeof(promptTab) / sizeof(promptTab[0])))
+
+/* opcode index executed at each location, -1 if unseen */
+int * codeOp = NULL;
+/* execution count of each location */
+long * count = NULL;
+/* locations in codeOp and count */
+int nlocs = 0;
+
+/* one candidate: an opcode sequence and its weight */
+typedef struct Pattern
+   { int len;
+     int ops[MAXLEN];
+     long weight; /* executions of the whole window */
+     int sites;   /* number of static locations */
+     struct Pattern * next;
+   } Pattern;
+
+static Pattern * hashTable[HASHSIZE];
+static int npatterns = 0;
+
+/********************************************/
+static int opIndex( char * word )
+{ int op;
+  for (op = 0; op < NOPS; op++)
+    if (strcmp(opCodeTab[op],word) == 0) return op;
+  return -1;
+} /* opIndex */
+
+/********************************************/
+/* Procedure growLocations makes codeOp and count
+ * hold location loc, doubling their size
+ */
+static void growLocations( int loc )
+{ int n = (nlocs > 0) ? nlocs : 1024;
+  int i;
+  while (n <= loc) n *= 2;
+  codeOp = (int *) realloc(codeOp, n * sizeof(int));
+  count = (long *) realloc(count, n * sizeof(long));
+  if ((codeOp == NULL) || (count == NULL))
+  { fprintf(stderr,"Out of memory\n");
+    exit(1);
+  }
+  for (i = nlocs; i < n; i++)
+  { codeOp[i] = -1;
+    count[i] = 0;
+  }
+  nlocs = n;
+} /* growLocations */
+
+/********************************************/
+/* Procedure addPattern adds weight w for the
+ * window of len opcodes ops
+ */
+static void addPattern( int * ops, int len, long w )
+{ unsigned h = len;
+  int i;
+  Pattern * p;
+  for (i = 0; i < len; i++) h = h * 31 + ops[i];
+  h %= HASHSIZE;
+  for (p = hashTable[h]; p != NULL; p = p->next)
+    if ((p->len == len) && (memcmp(p->ops,ops,len*sizeof(int)) == 0))
+      break;
+  if (p == NULL)
+  { p = (Pattern *) calloc(1,sizeof(Pattern));
+    if (p == NULL)
+    { fprintf(stderr,"Out of memory\n");
+      exit(1);
+    }
+    p->len = len;
+    memcpy(p->ops,ops,len*sizeof(int));
+    p->next = hashTable[h];
+    hashTable[h] = p;
+    npatterns++;
+  }
+  p->weight += w;
+  p->sites++;
+} /* addPattern */
+
+/********************************************/
+/* the saving of a candidate is the number of
+ * dispatches removed: len-1 per execution
+ */
+static long saving( Pattern * p )
+{ return p->weight * (p->len - 1);
+} /* saving */
+
+static int cmpPattern( const void * a, const void * b )
+{ long sa = saving(*(Pattern **) a);
+  long sb = saving(*(Pattern **) b);
+  return (sa < sb) - (sa > sb);
+} /* cmpPattern */
+
+/********************************************/
+int main( int argc, char * argv[] )
+{ FILE * trace = stdin;
+  char line[LINESIZE];
+  char word[LINESIZE];
+  int ntop = NTOP;
+  int loc, op, len, i, n;
+  int ops[MAXLEN];
+  long total = 0;
+  Pattern ** all;
+
+  if (argc > 3)
+  { fprintf(stderr,"usage: %s [trace file [count]]\n",argv[0]);
+    exit(1);
+  }
+  if ((argc > 1) && (strcmp(argv[1],"-") != 0))
+  { trace = fopen(argv[1],"r");
+    if (trace == NULL)
+    { fprintf(stderr,"file '%s' not found\n",argv[1]);
+      exit(1);
+    }
+  }
+  if (argc > 2) ntop = atoi(argv[2]);
+
+  while (fgets(line,LINESIZE,trace) != NULL)
+  { for (i = 0; i < NPROMPTS; i++)
+    { char * p;
+      while ((p = strstr(line,promptTab[i])) != NULL)
+        memmove(line,p+strlen(promptTab[i]),
+                strlen(p+strlen(promptTab[i]))+1);
+    }
+    if (sscanf(line,"%d: %s",&loc,word) != 2) continue;
+    if ((loc < 0) || (loc >= MAXADDR_SIZE)) continue;
+    if ((op = opIndex(word)) < 0) continue;
+    if (loc >= nlocs) growLocations(loc);
+    codeOp[loc] = op;
+    count[loc]++;
+    total++;
+  }
+
+  for (loc = 0; loc < nlocs; loc++)
+  { if (count[loc] == 0) continue;
+    for (len = 1; (len <= MAXLEN) && (loc+len <= nlocs); len++)
+    { if (codeOp[loc+len-1] < 0) break;
+      ops[len-1] = codeOp[loc+len-1];
+      if (len > 1) addPattern(ops,len,count[loc]);
+    }
+  }
+
+  all = (Pattern **) malloc((npatterns+1) * sizeof(Pattern *));
+  n = 0;
+  for (i = 0; i < HASHSIZE; i++)
+  { Pattern * p;
+    for (p = hashTable[i]; p != NULL; p = p->next) all[n++] = p;
+  }
+  qsort(all,n,sizeof(Pattern *),cmpPattern);
+
+  printf("%ld instructions traced\n",total);
+  printf("rank  saved dispatches  executions  sites  pattern\n");
+  for (i = 0; (i < n) && (i < ntop); i++)
+  { printf("%4d  %16ld  %10ld  %5d ",
+           i+1,saving(all[i]),all[i]->weight,all[i]->sites);
+    for (len = 0; len < all[i]->len; len++)
+      printf(" %s",opCodeTab[all[i]->ops[len]]);
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,191 @@
+/****************************************************/
+/* File: tmtrace.c                                  */
+/* Decodes the binary trace of the TM simulator     */
+/* (tm --btrace file)                               */
+/* into a line of text per instruction executed     */
+/****************************************************/
+
+/* Each record of the trace is printed on one line:
+ * the number of the instruction in the run, its
+ * location, opcode and what it did with the
+ * operand values recorded, e.g.
+ *       1234    85:  LD   r0 <- dMem[1010] = 5
+ * With --tm the code file the trace was made from
+ * is read as well, and the text of each
+ * instruction is appended. The options --pc lo[:hi],
+ * --op name and --addr a print only the records
+ * of those locations, opcodes or data addresses
+ * (LD and ST); --count prints only the number of
+ * records selected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define   LINESIZE    121
+#define   TRACE_MAGIC "TMTRACE"  /* as in tm.c */
+
+/* as in tm.c */
+char * opCodeTab[]
+        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV","????",
+           "LD","ST","????",
+           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
+          };
+#define   NOPS  ((int) (sizeof(opCodeTab) / sizeof(opCodeTab[0])))
+
+enum { opHALT, opIN, opOUT, opADD, opSUB, opMUL, opDIV, opRRLim,
+       opLD, opST, opRMLim,
+       opLDA, opLDC, opJLT, opJLE, opJGT, opJGE, opJEQ, opJNE, opRALim };
+
+/* a record of the trace, as in tm.c */
+typedef struct
+   { int pc;
+     unsigned char op;
+     unsigned char r;
+     short unused;
+     int a;
+     int b;
+   } TRACEREC;
+
+/* the code text of each location, from --tm */
+char ** codeText = NULL;
+int ncode = 0;
+
+/********************************************/
+/* Procedure readCode stores the text of the
+ * instructions of the code file name
+ */
+static void readCode( char * name )
+{ FILE * f = fopen(name,"r");
+  char line[LINESIZE];
+  int loc, n, k;
+  if (f == NULL)
+  { fprintf(stderr,"file '%s' not found\n",name);
+    exit(1);
+  }
+  while (fgets(line,LINESIZE,f) != NULL)
+  { if ( (sscanf(line," %d:%n",&loc,&n) != 1) || (loc < 0) ) continue;
+    if (loc >= ncode)
+    { k = ncode;
+      ncode = 2 * loc + 1;
+      codeText = (char **) realloc(codeText, ncode * sizeof(char *));
+      if (codeText == NULL)
+      { fprintf(stderr,"Out of memory\n");
+        exit(1);
+      }
+      while (k < ncode) codeText[k++] = NULL;
+    }
+    line[strcspn(line,"\n")] = '\0';
+    for (k = strlen(line); (k > n) && (line[k-1] == ' '); k--)
+      line[k-1] = '\0';
+    while (line[n] == ' ') n++;
+    codeText[loc] = strdup(line + n);
+  }
+  fclose(f);
+} /* readCode */
+
+/********************************************/
+/* Function jumps returns whether the jump t is
+ * taken
+ */
+static int jumps( TRACEREC * t )
+{ switch (t->op)
+  { case opJLT : return t->b <  0;
+    case opJLE : return t->b <= 0;
+    case opJGT : return t->b >  0;
+    case opJGE : return t->b >= 0;
+    case opJEQ : return t->b == 0;
+    default :    return t->b != 0;
+  }
+} /* jumps */
+
+/********************************************/
+/* Procedure printRecord prints record t, the
+ * n-th instruction of the run
+ */
+static void printRecord( long n, TRACEREC * t )
+{ printf("%10ld %5d:  %-4s ",n,t->pc,
+         (t->op < NOPS) ? opCodeTab[t->op] : "????");
+  switch (t->op)
+  { case opHALT : break;
+    case opIN :   printf("r%d <- input",t->r); break;
+    case opOUT :  printf("output r%d = %d",t->r,t->a); break;
+    case opADD :  printf("r%d <- %d + %d",t->r,t->a,t->b); break;
+    case opSUB :  printf("r%d <- %d - %d",t->r,t->a,t->b); break;
+    case opMUL :  printf("r%d <- %d * %d",t->r,t->a,t->b); break;
+    case opDIV :  printf("r%d <- %d / %d",t->r,t->a,t->b); break;
+    case opLD :   printf("r%d <- dMem[%d] = %d",t->r,t->a,t->b); break;
+    case opST :   printf("dMem[%d] <- r%d = %d",t->a,t->r,t->b); break;
+    case opLDA :
+    case opLDC :  printf("r%d <- %d",t->r,t->a); break;
+    default :
+      printf("r%d = %d, %s %d",t->r,t->b,
+             jumps(t) ? "jump to" : "no jump to",t->a);
+      break;
+  }
+  if ( (t->pc >= 0) && (t->pc < ncode) && (codeText[t->pc] != NULL) )
+    printf("    * %s",codeText[t->pc]);
+  printf("\n");
+} /* printRecord */
+
+/********************************************/
+int main( int argc, char * argv[] )
+{ FILE * trace;
+  char magic[sizeof(TRACE_MAGIC)];
+  TRACEREC t;
+  long first, n, selected = 0;
+  int lo = -1, hi = -1, op = -1, addr = -1, countOnly = 0;
+  int arg;
+
+  for (arg = 1; (arg < argc - 1) && (argv[arg][0] == '-'); arg++)
+  { if (strcmp(argv[arg],"--count") == 0)
+      countOnly = 1;
+    else if ( (strcmp(argv[arg],"--tm") == 0) && (arg + 2 < argc) )
+      readCode(argv[++arg]);
+    else if ( (strcmp(argv[arg],"--pc") == 0) && (arg + 2 < argc) )
+    { if (sscanf(argv[++arg],"%d:%d",&lo,&hi) == 1) hi = lo;
+    }
+    else if ( (strcmp(argv[arg],"--addr") == 0) && (arg + 2 < argc) )
+      addr = atoi(argv[++arg]);
+    else if ( (strcmp(argv[arg],"--op") == 0) && (arg + 2 < argc) )
+    { arg++;
+      for (op = 0; op < NOPS; op++)
+        if (strcmp(opCodeTab[op],argv[arg]) == 0) break;
+      if (op == NOPS)
+      { fprintf(stderr,"unknown opcode %s\n",argv[arg]);
+        exit(1);
+      }
+    }
+    else break;
+  }
+  if (arg != argc - 1)
+  { fprintf(stderr,"usage: %s [--tm code file] [--pc lo[:hi]] [--op name]"
+                   " [--addr a] [--count] trace file\n",argv[0]);
+    exit(1);
+  }
+  trace = fopen(argv[arg],"rb");
+  if (trace == NULL)
+  { fprintf(stderr,"file '%s' not found\n",argv[arg]);
+    exit(1);
+  }
+  if ( (fread(magic,1,sizeof(magic),trace) != sizeof(magic))
+       || (memcmp(magic,TRACE_MAGIC,sizeof(magic)) != 0)
+       || (fread(&first,sizeof(first),1,trace) != 1) )
+  { fprintf(stderr,"%s is not a TM trace\n",argv[arg]);
+    exit(1);
+  }
+
+  for (n = first; fread(&t,sizeof(t),1,trace) == 1; n++)
+  { if ( (lo >= 0) && ((t.pc < lo) || (t.pc > hi)) ) continue;
+    if ( (op >= 0) && (t.op != op) ) continue;
+    if ( (addr >= 0)
+         && (((t.op != opLD) && (t.op != opST)) || (t.a != addr)) )
+      continue;
+    selected++;
+    if ( ! countOnly ) printRecord(n,&t);
+  }
+  if (countOnly) printf("%ld\n",selected);
+  fclose(trace);
+  return 0;
+}